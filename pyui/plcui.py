@@ -5,6 +5,7 @@ from PyQt5.QtGui import *
 
 import yaml
 import zmq
+import struct
 import threading
 
 from mainwindow import *
@@ -45,11 +46,70 @@ def req_resp(command):
         except Exception as e:
             print(e)    
  
+#binary state updates, see src/ui/wire.h
+WIRE_MAGIC = b"PS"
+WIRE_VERSION = 1
+WIRE_KEY = 1
+WIRE_DELTA = 2
+WIRE_HEADER = struct.Struct(">2sBBIIiH")
+WIRE_SIZES = 8
+WIRE_RECORD = struct.Struct(">BHQ")
+wire_blocks = ['', 'I', 'Q', 'AI', 'AQ', 'M', 'MF', 'T', 'TQ', 'S']
+wire_reals = ('AI', 'AQ', 'MF')
+
+#process image as last received, by block and index
+image = {}
+wire_sync = {'synced': False, 'seq': 0}
+
+def wire_decode(message):
+    magic, version, kind, seq, cycle, status, n = WIRE_HEADER.unpack_from(message)
+    if(magic != WIRE_MAGIC or version != WIRE_VERSION):
+        raise ValueError("not a state update")
+    offset = WIRE_HEADER.size
+    if(kind == WIRE_KEY):
+        offset += WIRE_SIZES
+    records = []
+    for r in range(0, n):
+        block, index, value = WIRE_RECORD.unpack_from(message, offset)
+        offset += WIRE_RECORD.size
+        name = wire_blocks[block] if block < len(wire_blocks) else str(block)
+        if(name in wire_reals):
+            value = struct.unpack(">d", struct.pack(">Q", value))[0]
+        elif(name in ('M', 'T') and value >= 1 << 63):
+            value -= 1 << 64
+        records.append((name, index, value))
+    return kind, seq, cycle, status, records
+
+def on_state_update(message):
+    try:
+        kind, seq, cycle, status, records = wire_decode(message)
+    except Exception as e:
+        print(e)
+        return
+    if(kind == WIRE_DELTA and 
+       (not wire_sync['synced'] or seq != wire_sync['seq'] + 1)):
+        if(wire_sync['synced']):
+            #subscribing again makes the plc send a keyframe
+            print("lost updates, resynchronizing...")
+            subscriber.setsockopt(zmq.SUBSCRIBE, WIRE_MAGIC)
+        wire_sync['synced'] = False
+        return
+    if(kind == WIRE_KEY):
+        image.clear()
+    wire_sync['synced'] = True
+    wire_sync['seq'] = seq
+    for name, index, value in records:
+        image[(name, index)] = value
+    print("cycle %d status %d: %s" % (cycle, status, records))
+
 def pub_sub():
     while(True):
         print("waiting for updates from PLC EMU...")
         message = subscriber.recv()
-        print("Received update %s " % message)
+        if(message.startswith(WIRE_MAGIC)):
+            on_state_update(message)
+        else:
+            print("Received state %s " % message)
 
 sub_thread = threading.Thread(target=pub_sub, args=(), daemon=True)
 
@@ -673,6 +733,7 @@ def on_action_connect(state):
         requester.connect("tcp://localhost:5555")
         subscriber.connect("tcp://localhost:5556")
         subscriber.setsockopt(zmq.SUBSCRIBE, b"---")
+        subscriber.setsockopt(zmq.SUBSCRIBE, WIRE_MAGIC)
         sub_thread.start()
 
     else:
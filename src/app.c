@@ -6,6 +6,8 @@
 #include "instruction.h"
 #include "rung.h"
 #include "plclib.h"
+#include "snapshot.h"
+#include "wire.h"
 #include "ui.h"
 #include "plcemu.h"
 #include "app.h"
@@ -73,203 +75,139 @@ static plc_t configure_readonly(int operand,
     return plc;               
 }
 
-static plc_t configure_di(const config_t conf, plc_t plc){
- 
-    sequence_t seq = get_sequence_entry(CONFIG_DI, conf);
-   
-    if(seq) {
-        plc_t p = plc;
-        int i = 0;
-        for(; i < seq->size; i++){
-        //names
-            p = declare_names(OP_INPUT, &(seq->vars[i]), p);    
-        }
-        return p;
-    } 
-    return plc;
-}
-
-static plc_t configure_dq(const config_t conf, plc_t plc){
-
-    sequence_t seq = get_sequence_entry(CONFIG_DQ, conf); 
-    
-    if(seq) {
-        plc_t p = plc;
-        int i = 0;
-        for(; i < seq->size; i++){
-        //names
-            p = declare_names(OP_OUTPUT, &(seq->vars[i]), p);    
-        }
-        return p;
-    } 
-    return plc;
-}
-
-static plc_t configure_ai(const config_t conf, plc_t plc){
-
-    sequence_t seq = get_sequence_entry(CONFIG_AI, conf);
-    
-    if(seq) {
+/**
+ * @brief apply the configuration of one variable
+ * @param the block sequence, CONFIG_DI etc.
+ * @param the index in the sequence
+ * @param the variable
+ * @param the plc
+ * @return the configured plc
+ */
+static plc_t configure_variable(int s, 
+                                int i, 
+                                const variable_t var, 
+                                plc_t plc){
+    plc_t p = plc;
+    char * val = NULL;
+    switch(s){
+        case CONFIG_DI:
+            p = declare_names(OP_INPUT, var, p);
+            break;
         
-        plc_t p = plc;
-        int i = 0;
-        for(; i < seq->size; i++){
-            //names
-            p = declare_names(OP_REAL_INPUT, &(seq->vars[i]), p);
-            //limits    
-            p = configure_limits(OP_REAL_INPUT, &(seq->vars[i]), p);
-        }
-        return p;
-    } 
-    return plc;
-}
-
-static plc_t configure_aq(const config_t conf, plc_t plc){
-
-    sequence_t seq = get_sequence_entry(CONFIG_AQ, conf);
-    
-    if(seq) {
-        plc_t p = plc;
-        int i = 0;
-        for(; i < seq->size; i++){
-            //names
-            p = declare_names(OP_REAL_OUTPUT, &(seq->vars[i]), p);
-            //limits    
-            p = configure_limits(OP_REAL_OUTPUT, &(seq->vars[i]), p);
-        }
-        return p;
-    } 
-    return plc;
-}
-
-static plc_t configure_counters(const config_t conf, plc_t plc){
-
-    sequence_t seq = get_sequence_entry(CONFIG_MREG, conf);
-    
-    if(seq) {
-        plc_t p = plc;
-        int i = 0;
-        char * val = NULL;
-        for(; i < seq->size; i++){
-            //names
-            p = declare_names(OP_MEMORY, &(seq->vars[i]), p);
+        case CONFIG_DQ:
+            p = declare_names(OP_OUTPUT, var, p);
+            break;
+        
+        case CONFIG_AI:
+            p = declare_names(OP_REAL_INPUT, var, p);
+            p = configure_limits(OP_REAL_INPUT, var, p);
+            break;
+        
+        case CONFIG_AQ:
+            p = declare_names(OP_REAL_OUTPUT, var, p);
+            p = configure_limits(OP_REAL_OUTPUT, var, p);
+            break;
+        
+        case CONFIG_MREG:
+            p = declare_names(OP_MEMORY, var, p);
             //defaults
-            p = init_values(OP_MEMORY, &(seq->vars[i]), p);
+            p = init_values(OP_MEMORY, var, p);
             //readonlies
-            p = configure_readonly(OP_MEMORY, &(seq->vars[i]), p);
+            p = configure_readonly(OP_MEMORY, var, p);
             //directions    
-            if((val = get_param_val("COUNT", seq->vars[i].params))){
+            if((val = get_param_val("COUNT", var->params))){
                 p = configure_counter_direction(p, i, val);
-                val = NULL;
             }
-        }
-        return p;   
-    } 
-    return plc;
-}
-
-static plc_t configure_reals(const config_t conf, plc_t plc){
-
-    sequence_t seq = get_sequence_entry(CONFIG_MVAR, conf);
-    
-    if(seq) {
-        plc_t p = plc;
-        int i = 0;
-        for(; i < seq->size; i++){
-            //names
-            p = declare_names(OP_REAL_MEMORY, &(seq->vars[i]), plc);
-            //defaults
-            p = init_values(OP_REAL_MEMORY, &(seq->vars[i]), p);
-            //readonlies
-            p = configure_readonly(OP_REAL_MEMORY, &(seq->vars[i]), p); 
-        }
-        return p; 
-    } 
-    return plc;
-}
-
-static plc_t configure_timers(const config_t conf, plc_t plc){
-
-    sequence_t seq = get_sequence_entry(CONFIG_TIMER, conf);
-    
-    if(seq) {
-        int i = 0;
-        char * scale = NULL;
-        char * preset = NULL;
-        char * ondelay = NULL;
-        plc_t p = plc;
-        for(; i < seq->size; i++){
-            //names
-            p = declare_names(OP_TIMEOUT, &(seq->vars[i]), plc);
+            break;
+        
+        case CONFIG_MVAR:
+            p = declare_names(OP_REAL_MEMORY, var, p);
+            p = init_values(OP_REAL_MEMORY, var, p);
+            p = configure_readonly(OP_REAL_MEMORY, var, p); 
+            break;
+        
+        case CONFIG_TIMER:
+            p = declare_names(OP_TIMEOUT, var, p);
             //scales
-            if((scale = get_param_val("RESOLUTION", 
-                                        seq->vars[i].params))){
-                p = configure_timer_scale(p, i, scale);
-                scale = NULL;
+            if((val = get_param_val("RESOLUTION", var->params))){
+                p = configure_timer_scale(p, i, val);
             }
             //presets            
-            if((preset = get_param_val("PRESET", 
-                                        seq->vars[i].params))){
-                p = configure_timer_preset(p, i, preset);
-                preset = NULL;
+            if((val = get_param_val("PRESET", var->params))){
+                p = configure_timer_preset(p, i, val);
             }
             //modes
-            if((ondelay = get_param_val("ONDELAY", 
-                                        seq->vars[i].params))){
-                p = configure_timer_delay_mode(p, i, ondelay);
-                ondelay = NULL;
+            if((val = get_param_val("ONDELAY", var->params))){
+                p = configure_timer_delay_mode(p, i, val);
             }
-        }   
-        return p; 
-    } 
-    return plc;    
+            break;
+        
+        case CONFIG_PULSE:
+            p = declare_names(OP_BLINKOUT, var, p);
+            if((val = get_param_val("RESOLUTION", var->params))){
+                p = configure_pulse_scale(p, i, val);
+            }
+            break;
+        
+        default: break;
+    }
+    return p;
 }
 
-static plc_t configure_pulses(const config_t conf, plc_t plc){
+/**
+ * @brief the variables of a block that the plc addresses, 
+ * a configuration may hold more than a byte can index
+ */
+static int block_size(const sequence_t seq){
 
-    sequence_t seq = get_sequence_entry(CONFIG_PULSE, conf);
+    if(seq == NULL){
     
-    if(seq) {
+        return 0;
+    }
+    return seq->size < MAXBUF ? seq->size : MAXBUF - 1;
+}
+
+/**
+ * @brief apply the configuration of all the variables of all blocks
+ */
+static plc_t configure_sequences(const config_t conf, plc_t plc){
+    
+    plc_t p = plc;
+    int s = CONFIG_PROGRAM;
+    for(; s < N_CONFIG_VARIABLES; s++){
+        sequence_t seq = get_sequence_entry(s, conf);
         int i = 0;
-        char * scale = NULL;
-        plc_t p = plc;
-        for(; i < seq->size; i++){
-            //names
-            p = declare_names(OP_BLINKOUT, &(seq->vars[i]), plc);
-            //scales
-            if((scale = get_param_val("RESOLUTION",
-                                     seq->vars[i].params))){
-                p = configure_pulse_scale(p, i, scale);
-                scale = NULL;
-            }
-        }   
-        return p; 
-    } 
-    return plc;    
+        if(seq && seq->size > block_size(seq)){
+            plc_log("Only the first %d variables of %s are used", 
+                    block_size(seq), get_entry(s, conf)->name);
+        }
+        for(; i < block_size(seq); i++){
+            p = configure_variable(s, i, &(seq->vars[i]), p);
+        }
+    }
+    return p;
 }
 
-static config_t get_dio_values(const plc_t plc, 
+static config_t get_dio_values(const snapshot_t snap, 
                         const config_t state, 
                         BYTE type){
     config_t ret = state;
-    sequence_t dios = get_sequence_entry(type, ret);
+    sequence_t dios = edit_sequence_entry(type, ret);
     if(dios == NULL || (
         type != CONFIG_DI &&
         type != CONFIG_DQ)) {
         
         return state;
     } 
+    BYTE * bits = type == CONFIG_DI ? snap->inputs : snap->outputs;
+    BYTE nbytes = type == CONFIG_DI ? snap->ni : snap->nq;
     variable_t viter = dios->vars;
     int i = 0;
     BYTE val = 0;
-    while(i < dios->size){
+    while(i < dios->size && i < BYTESIZE * nbytes){
         if(viter != NULL) {
            
-            if(type == CONFIG_DI){
-                val = plc->di[i].I;
-            } else if(type == CONFIG_DQ){
-                val = plc->dq[i].Q;    
-            }
+            val = (bits[i / BYTESIZE] >> i % BYTESIZE) & 1;
             viter->params = update_param(
                                 viter->params,
                                 "STATE",
@@ -281,11 +219,11 @@ static config_t get_dio_values(const plc_t plc,
     return ret;
 }
 
-static config_t get_aio_values(const plc_t plc, 
+static config_t get_aio_values(const snapshot_t snap, 
                         const config_t state, 
                         BYTE type){
     config_t ret = state;
-    sequence_t aios = get_sequence_entry(type, ret);
+    sequence_t aios = edit_sequence_entry(type, ret);
     if(aios == NULL || (
         type != CONFIG_AI &&
         type != CONFIG_AQ &&
@@ -293,22 +231,23 @@ static config_t get_aio_values(const plc_t plc,
         
         return state;
     } 
+    double * vals = snap->ai;
+    BYTE n = snap->nai;
+    if(type == CONFIG_AQ){
+        vals = snap->aq;
+        n = snap->naq;
+    } else if(type == CONFIG_MVAR){
+        vals = snap->mr;
+        n = snap->nmr;
+    }
     variable_t viter = aios->vars;
     int i = 0;
-    double val = 0;
     char valbuf[TINYBUF] = "";
     memset(valbuf, 0, TINYBUF);
-    while(i < aios->size){
+    while(i < aios->size && i < n){
         if(viter != NULL) {
            
-            if(type == CONFIG_AI){
-                val = plc->ai[i].V;
-            } else if(type == CONFIG_AQ){
-                val = plc->aq[i].V;    
-            } else if(type == CONFIG_MVAR){
-                val = plc->mr[i].V;    
-            }
-            sprintf(valbuf, "%f", val);
+            sprintf(valbuf, "%f", vals[i]);
             viter->params = update_param(
                                 viter->params,
                                 "VALUE",
@@ -320,10 +259,10 @@ static config_t get_aio_values(const plc_t plc,
     return ret;
 }
 
-static config_t get_reg_values(const plc_t plc, 
+static config_t get_reg_values(const snapshot_t snap, 
                         const config_t state){
     config_t ret = state;
-    sequence_t regs = get_sequence_entry(CONFIG_MREG, ret);
+    sequence_t regs = edit_sequence_entry(CONFIG_MREG, ret);
     if(regs == NULL){
        
         return state;
@@ -331,10 +270,10 @@ static config_t get_reg_values(const plc_t plc,
     variable_t viter = regs->vars;
     int i = 0;
     uint64_t val = 0;
-    while(i < regs->size){
+    while(i < regs->size && i < snap->nm){
         if(viter != NULL) {
            
-            val = plc->m[i].V;    
+            val = snap->m[i];    
             char vs[TINYBUF];
             memset(vs,0, TINYBUF);
             sprintf(vs,"%ld", val); 
@@ -348,10 +287,10 @@ static config_t get_reg_values(const plc_t plc,
     return ret;
 }
 
-static config_t get_timer_values(const plc_t plc, 
+static config_t get_timer_values(const snapshot_t snap, 
                           const config_t state){
     config_t ret = state;
-    sequence_t timers = get_sequence_entry(CONFIG_TIMER, ret);
+    sequence_t timers = edit_sequence_entry(CONFIG_TIMER, ret);
     if(timers == NULL){
        
         return state;
@@ -360,11 +299,11 @@ static config_t get_timer_values(const plc_t plc,
     int i = 0;
     long val = 0;
     BYTE out = 0;
-    while(i < timers->size){
+    while(i < timers->size && i < snap->nt){
         if(viter != NULL) {
            
-            val = plc->t[i].V;
-            out = plc->t[i].Q;    
+            val = snap->t[i];
+            out = snap->t_out[i];    
             char vs[TINYBUF];
             memset(vs,0, TINYBUF);
             sprintf(vs,"%ld",val); 
@@ -383,10 +322,10 @@ static config_t get_timer_values(const plc_t plc,
     return ret;
 }
 
-static config_t get_pulse_values(const plc_t plc, 
+static config_t get_pulse_values(const snapshot_t snap, 
                           const config_t state){
     config_t ret = state;
-    sequence_t pulses = get_sequence_entry(CONFIG_PULSE, ret);
+    sequence_t pulses = edit_sequence_entry(CONFIG_PULSE, ret);
     if(pulses == NULL){
        
         return state;
@@ -394,10 +333,10 @@ static config_t get_pulse_values(const plc_t plc,
     variable_t viter = pulses->vars;
     int i = 0;
     BYTE out = 0;
-    while(i < pulses->size){
+    while(i < pulses->size && i < snap->ns){
         if(viter != NULL) {
         
-            out = plc->s[i].Q;    
+            out = snap->s_out[i];    
             viter->params = update_param(
                                 viter->params,
                                 "OUT",
@@ -411,27 +350,35 @@ static config_t get_pulse_values(const plc_t plc,
 
 
 
-//FIXME: support for multiple interfaces
+//default when HW/TYPE is not configured
+#ifdef SHM
+#define HW_DEFAULT HW_SHM
+#else //SHM
+
 #ifdef SIM
-#define HW_TYPE HW_SIM
+#define HW_DEFAULT HW_SIM
 #else //SIM
 
 #ifdef COMEDI
-#define HW_TYPE HW_COMEDI
+#define HW_DEFAULT HW_COMEDI
 #else //COMEDI
 
 #ifdef USPACE
-#define HW_TYPE HW_USPACE
+#define HW_DEFAULT HW_USPACE
 #else //USPACE
 
-#define HW_TYPE HW_DRY
+#define HW_DEFAULT HW_DRY
 
 #endif //USPACE
 #endif //COMEDI
 #endif //SIM
+#endif //SHM
 int Lookup[N_CONFIG_VARIABLES] = {
     PLC_ERR, //CONFIG_STEP,
+    PLC_ERR, //CONFIG_VIRTUAL,
     PLC_ERR, //CONFIG_HW,
+    PLC_ERR, //CONFIG_MODBUS,
+    PLC_ERR, //CONFIG_PEER,
     PLC_ERR, //CONFIG_PROGRAM,
         OP_REAL_INPUT,  //CONFIG_AI
         OP_REAL_OUTPUT, //CONFIG_AQ
@@ -447,41 +394,38 @@ app_t configure(const config_t conf, app_t app){
 
     app_t a = app;
     a->conf = conf;
-    hardware_t hw = get_hardware(HW_TYPE);
+    int type = HW_DEFAULT;
+    char * name = get_string_entry(HW_TYPE, 
+                    get_recursive_entry(CONFIG_HW, conf));
+    if(name && name[0]){
+        type = get_hardware_type(name);
+    }
+    hardware_t hw = get_hardware(type);
+    if(hw == NULL){
+        plc_log("Hardware %s not available, running dry", name ? name : "");
+        hw = get_hardware(HW_DRY);
+    }
     hw->status = hw->configure(conf);
-  //TODO: handle NULL errors here 
     sequence_t s = get_sequence_entry(CONFIG_DI, conf);
-    int di = s ? (s->size / BYTESIZE + 1) : 0;
+    int di = s ? (block_size(s) / BYTESIZE + 1) : 0;
     s = get_sequence_entry(CONFIG_DQ, conf);
-    int dq = s ? (s->size / BYTESIZE + 1) : 0;
-    s = get_sequence_entry(CONFIG_AI, conf);
-    int ai = s ? s->size : 0;
-    s = get_sequence_entry(CONFIG_AQ, conf);
-    int aq = s ? s->size : 0;
-    s = get_sequence_entry(CONFIG_TIMER, conf);
-    int nt = s ? s->size : 0;
-    s = get_sequence_entry(CONFIG_PULSE, conf);
-    int ns = s ? s->size : 0;
-    s = get_sequence_entry(CONFIG_MREG, conf);
-    int nm = s ? s->size : 0;
-    s = get_sequence_entry(CONFIG_MVAR, conf);
-    int nr = s ? s->size : 0;
+    int dq = s ? (block_size(s) / BYTESIZE + 1) : 0;
+    int ai = block_size(get_sequence_entry(CONFIG_AI, conf));
+    int aq = block_size(get_sequence_entry(CONFIG_AQ, conf));
+    int nt = block_size(get_sequence_entry(CONFIG_TIMER, conf));
+    int ns = block_size(get_sequence_entry(CONFIG_PULSE, conf));
+    int nm = block_size(get_sequence_entry(CONFIG_MREG, conf));
+    int nr = block_size(get_sequence_entry(CONFIG_MVAR, conf));
     
     int step = get_numeric_entry(CONFIG_STEP, conf);
+    set_virtual_clock(get_numeric_entry(CONFIG_VIRTUAL, conf) > 0);
     
     plc_t p = new_plc(di, dq, ai, aq, nt, ns, nm, nr, step, hw);
 
     p->status = 0;
     p->update = TRUE;
   //these errors should be already handled
-    p = configure_di(conf, p);
-    p = configure_dq(conf, p);
-    p = configure_ai(conf, p);
-    p = configure_aq(conf, p);
-    p = configure_counters(conf, p);
-    p = configure_reals(conf, p);
-    p = configure_timers(conf, p);
-    p = configure_pulses(conf, p);
+    p = configure_sequences(conf, p);
     
     if(a->plc != NULL){
         clear_plc(a->plc);
@@ -491,62 +435,191 @@ app_t configure(const config_t conf, app_t app){
     return a;
 }
 
-config_t get_state(const plc_t plc, 
+config_t get_state(const snapshot_t snap, 
                    const config_t state){
     config_t r = state;
-    int i = 0;
+    if(snap == NULL){
+    
+        return state;
+    }
     //set status
-    r = set_numeric_entry(0, plc->status, r);
+    r = set_numeric_entry(0, snap->status, r);
     //assign values    
-    if(plc->update & CHANGED_I){
-        r = get_dio_values(plc, r, CONFIG_DI);
-        //analog
-        r = get_aio_values(plc, r, CONFIG_AI);
-    }
-    if(plc->update & CHANGED_O){
-        r = get_dio_values(plc, r, CONFIG_DQ);
-        //analog
-        r = get_aio_values(plc, r, CONFIG_AQ);
-    }
-    if(plc->update & CHANGED_M){
+    r = get_dio_values(snap, r, CONFIG_DI);
+    r = get_aio_values(snap, r, CONFIG_AI);
+    r = get_dio_values(snap, r, CONFIG_DQ);
+    r = get_aio_values(snap, r, CONFIG_AQ);
     //registers
-        r = get_reg_values(plc, r);
+    r = get_reg_values(snap, r);
     //reals
-        r = get_aio_values(plc, r, CONFIG_MVAR);
-    }
-    if(plc->update & CHANGED_T){
+    r = get_aio_values(snap, r, CONFIG_MVAR);
     //timers
-        r = get_timer_values(plc, r);
-    }
-    if(plc->update & CHANGED_S){
+    r = get_timer_values(snap, r);
     //pulses
-        r = get_pulse_values(plc, r);
+    r = get_pulse_values(snap, r);
+    //show forced
+    return r;
+}
+
+config_t get_program(const plc_t plc, 
+                     const config_t state){
+    config_t r = state;
+    int i = 0;
+    sequence_t programs = edit_sequence_entry(CONFIG_PROGRAM, r);
+    
+    for(i = 0; programs && i < plc->rungno && i < programs->size; i++){
+        codeline_t liter = plc->rungs[i]->code;
+        int lineno = 0;
+        char label[SMALLBUF] = "";
+        while(liter){
+            sprintf(label, "LINE %d", ++lineno);
+        
+            param_t code = get_param(label,programs->vars[i].params);
+            if(code == NULL){ 
+                programs->vars[i].params = append_param(
+                                    programs->vars[i].params,
+                                    label,
+                                    liter->line);
+            }
+            liter = liter->next;    
+        }      
+    }
+    return r;
+}
+
+/**
+ * @brief check one edit against the configuration, before anything is applied
+ * @return OK or ERROR
+ */
+static int check_edit(const char * block,
+                      const char * index,
+                      const char * value,
+                      const config_t conf){
+    int s = get_key(block, conf);
+    char * end = NULL;
+    long i = 0;
+    if(value == NULL){ //so are key and maybe index
+
+        return PLC_ERR;
+    }
+    i = strtol(index, &end, 10);
+    //programs change with COM_LOAD, not here
+    if(end == index
+    || *end != 0
+    || s <= CONFIG_PROGRAM
+    || s >= N_CONFIG_VARIABLES
+    || i < 0 
+    || i >= block_size(get_sequence_entry(s, conf))){
+        
+        return PLC_ERR;
     }
+    return PLC_OK;
+}
+
+/**
+ * @brief apply one checked edit in place, and reconfigure its variable
+ * @return OK or ERROR
+ */
+static int apply_edit(const char * block,
+                      int index,
+                      const char * key,
+                      const char * value,
+                      app_t a){
+    int s = get_key(block, a->conf);
+    sequence_t seq = edit_sequence_entry(s, a->conf);
+    if(seq == NULL){
+        
+        return PLC_ERR;
+    }
+    a->conf = store_seq_value(seq, index, key, value, a->conf);
+    a->plc = configure_variable(s, index, &(seq->vars[index]), a->plc);
     
-    //show forced
-    //add program
-    if( plc->update & CHANGED_STATUS) {
-        sequence_t programs = get_sequence_entry(CONFIG_PROGRAM, r);
+    return PLC_OK;
+}
+
+/**
+ * @brief apply "block index key value [block index key value]...",
+ * all of them or none
+ */
+static app_t apply_edits(const char * edits, app_t a){
     
-        for(i = 0;i < plc->rungno; i++){
-            codeline_t liter = plc->rungs[i]->code;
-            int lineno = 0;
-            char label[SMALLBUF] = "";
-            while(liter){
-                sprintf(label, "LINE %d", ++lineno);
+    char buf[MAXSTR];
+    char * save = NULL;
+    char * block = NULL;
+    char * index = NULL;
+    char * key = NULL;
+    char * value = NULL;
+    int pass = 0;
+    if(strlen(edits) >= MAXSTR){
+        plc_log("Invalid edit command\n");
+        
+        return a;
+    }
+    for(; pass < 2; pass++){//check every edit, then apply them
+        strcpy(buf, edits);
+        block = strtok_r(buf, " \n", &save);
+        while(block){
+            index = strtok_r(NULL, " \n", &save);
+            key = strtok_r(NULL, " \n", &save);
+            value = strtok_r(NULL, " \n", &save);
+            if(pass == 0
+            && check_edit(block, index, value, a->conf) < PLC_OK){
+                plc_log("Invalid edit command\n");
             
-                param_t code = get_param(label,programs->vars[i].params);
-                if(code == NULL){ 
-                    programs->vars[i].params = append_param(
-                                        programs->vars[i].params,
-                                        label,
-                                        liter->line);
+                return a;
+            }
+            if(pass == 1){
+                apply_edit(block, atoi(index), key, value, a);
+            }
+            block = strtok_r(NULL, " \n", &save);
+        }
+    }
+    return a;
+}
+
+/**
+ * @brief apply the names and parameters of a configuration that differ 
+ * from the current one, variable by variable. 
+ * Programs are not touched, they change with COM_LOAD.
+ */
+static app_t apply_diff(const config_t arg, app_t a){
+    
+    int s = CONFIG_PROGRAM + 1;
+    for(; s < N_CONFIG_VARIABLES; s++){
+        sequence_t from = get_sequence_entry(s, arg);
+        sequence_t to = get_sequence_entry(s, a->conf);
+        int i = 0;
+        if(from == to){//still shared, nothing changed
+            continue;
+        }
+        for(; from && to && i < from->size && i < block_size(to); i++){
+            variable_t v = &(from->vars[i]);
+            variable_t c = &(to->vars[i]);
+            BYTE changed = FALSE;
+            param_t it = v->params;
+            if(v->name 
+            && (c->name == NULL || strcmp(v->name, c->name))){
+                to = edit_sequence_entry(s, a->conf);//copied if shared
+                c = &(to->vars[i]);
+                a->conf = store_seq_value(to, i, "ID", v->name, a->conf);
+                changed = TRUE;
+            }
+            for(; it; it = it->next){
+                char * cur = get_param_val(it->key, c->params);
+                if(it->value 
+                && (cur == NULL || strcmp(cur, it->value))){
+                    to = edit_sequence_entry(s, a->conf);
+                    c = &(to->vars[i]);
+                    c->params = update_param(c->params, it->key, it->value);
+                    changed = TRUE;
                 }
-                liter = liter->next;    
-            }      
+            }
+            if(changed){
+                a->plc = configure_variable(s, i, c, a->plc);
+            }
         }
     }
-    return r;
+    return a;
 }
 
 app_t apply_command(const config_t com, 
@@ -578,6 +651,7 @@ app_t apply_command(const config_t com,
             //copied over here 
             
                 a->plc = plc_stop(a->plc);
+                clear_config(a->conf);
                 a->conf = copy_config(arg);
                     
                 break;
@@ -633,16 +707,12 @@ app_t apply_command(const config_t com,
                 }
                 break;
              case COM_EDIT:
-                //TODO: filter sequences who have an updated variable                    
-                a->plc = configure_di(arg, a->plc);
-                a->plc = configure_dq(arg, a->plc);
-                a->plc = configure_ai(arg, a->plc);
-                a->plc = configure_aq(arg, a->plc);
-                a->plc = configure_counters(arg, a->plc);
-                a->plc = configure_reals(arg, a->plc);
-                a->plc = configure_timers(arg, a->plc);
-                a->plc = configure_pulses(arg, a->plc);
-                a->conf = copy_sequences(arg, a->conf);
+                cvalue = get_string_entry(CLI_EDIT, com);
+                if(cvalue && cvalue[0]){
+                    a = apply_edits(cvalue, a);
+                } else {//a whole configuration, only what differs applies
+                    a = apply_diff(arg, a);
+                }
                 break;
             //TODO: new command: CONFIGURE to set up the hardware and register sizes
             default: break;
@@ -651,3 +721,97 @@ app_t apply_command(const config_t com,
     return a;
 }
  
+
+/**
+ * @return the operand of a batch record block
+ */
+static int batch_operand(BYTE block)
+{
+    switch(block){
+        case WIRE_I: return OP_INPUT;
+        case WIRE_Q: return OP_OUTPUT;
+        case WIRE_AI: return OP_REAL_INPUT;
+        case WIRE_AQ: return OP_REAL_OUTPUT;
+        case WIRE_M: return OP_MEMORY;
+        case WIRE_MR: return OP_REAL_MEMORY;
+        default: return N_OPERANDS;
+    }
+}
+
+/**
+ * @brief check a batch record against the plc, before anything is applied
+ * @return OK or ERROR
+ */
+static int check_record(const plc_t p, BYTE op, BYTE block, 
+                        unsigned int i, uint64_t v)
+{
+    BYTE ok = FALSE;
+    double d = wire_real(v);
+    switch(block){
+        case WIRE_I: 
+            ok = op != WIRE_WRITE && i < p->ni * BYTESIZE && v <= 1;
+            break;
+        case WIRE_Q: 
+            ok = op != WIRE_WRITE && i < p->nq * BYTESIZE && v <= 1;
+            break;
+        case WIRE_AI: 
+            ok = op != WIRE_WRITE && i < p->nai 
+              && (op == WIRE_UNFORCE 
+               || (d > p->ai[i].min && d < p->ai[i].max));
+            break;
+        case WIRE_AQ: 
+            ok = op != WIRE_WRITE && i < p->naq 
+              && (op == WIRE_UNFORCE 
+               || (d > p->aq[i].min && d < p->aq[i].max));
+            break;
+        case WIRE_M: 
+            ok = op == WIRE_WRITE && i < p->nm && !p->m[i].RO;
+            break;
+        case WIRE_MR: 
+            ok = op == WIRE_WRITE && i < p->nmr && !p->mr[i].RO;
+            break;
+        default: break;
+    }
+    return ok ? PLC_OK : PLC_ERR;
+}
+
+app_t apply_batch(const wire_batch_t b, 
+                  app_t a){
+    plc_t p = a ? a->plc : NULL;
+    unsigned int i = 0;
+    if(p == NULL
+    || b == NULL){
+        return a;
+    }
+    for(; i < b->n; i++){//all or nothing
+        if(check_record(p, b->op, b->block[i], 
+                        b->index[i], b->value[i]) < PLC_OK){
+            plc_log("Invalid batch command, record %d\n", i);
+            return a;
+        }
+    }
+    for(i = 0; i < b->n; i++){
+        int op = batch_operand(b->block[i]);
+        unsigned int k = b->index[i];
+        BYTE real = op == OP_REAL_INPUT || op == OP_REAL_OUTPUT;
+        switch(b->op){
+            case WIRE_FORCE:
+                force_value(p, op, k, 
+                            real ? wire_real(b->value[i]) : b->value[i]);
+                break;
+            case WIRE_UNFORCE:
+                unforce(p, op, k);
+                break;
+            case WIRE_WRITE:
+                if(op == OP_MEMORY){
+                    p->m[k].V = b->value[i];
+                } else {
+                    p->mr[k].V = wire_real(b->value[i]);
+                }
+                p->update |= CHANGED_M;
+                break;
+            default: break;
+        }
+    }
+    return a;
+}
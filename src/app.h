@@ -20,13 +20,22 @@ app_t configure(const config_t conf, app_t app);
 
 /**
  *@brief get plc state in serializable form
- *@param plc
+ *@param a consistent copy of the plc state
  *@param current state
  *@return updated state 
  */
-config_t get_state(const plc_t plc, 
+config_t get_state(const snapshot_t snap, 
                    const config_t state);
 
+/**
+ *@brief add the loaded program listing to the state
+ *@param plc
+ *@param current state
+ *@return updated state 
+ */
+config_t get_program(const plc_t plc, 
+                     const config_t state);
+
 /**
  *@brief apply a command
  *@param ui command in serializable form
@@ -36,4 +45,14 @@ config_t get_state(const plc_t plc,
  */                   
 app_t apply_command(const config_t com, 
                     app_t a);
+
+/**
+ *@brief apply a batch command as a whole, or nothing of it if any
+ * record is out of range
+ *@param the batch
+ *@param the emulator app
+ *@return updated app
+ */
+app_t apply_batch(const wire_batch_t b, 
+                  app_t a);
 #endif //_APP_H_
@@ -0,0 +1,373 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "config.h"
+
+/*binary image of a loaded configuration.
+It is a cache local to the host, so numbers are in its byte order*/
+#define IMAGE_MAGIC 0x49434c50 //"PLCI"
+#define IMAGE_VERSION 2
+
+struct image_header {
+    unsigned int magic;
+    unsigned int version;
+    uint64_t key; //of the source text and the defaults
+    unsigned int length; //of the payload
+    unsigned int sum; //of the payload
+};
+
+typedef struct image {
+    char * buf;
+    size_t len;
+    size_t cap;
+} * image_t;
+
+typedef struct cursor {
+    const char * at;
+    size_t left;
+} * cursor_t;
+
+static unsigned int hash_bytes(unsigned int h, const char * buf, size_t len){
+//FNV-1a
+    size_t i = 0;
+    for(; i < len; i++){
+        h = (h ^ (unsigned char)buf[i]) * 16777619u;
+    }
+    return h;
+}
+
+static uint64_t hash_key(uint64_t h, const char * buf, size_t len){
+//64 bit FNV-1a, wide enough not to mistake an edited file for a cached one
+    size_t i = 0;
+    for(; i < len; i++){
+        h = (h ^ (unsigned char)buf[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+static void put(image_t img, const void * data, size_t len){
+
+    if(len == 0){
+        //nothing to copy, and data may be NULL
+        return;
+    }
+    if(img->len + len > img->cap){
+        size_t cap = img->cap ? img->cap : CONF_STR;
+        while(cap < img->len + len){
+            cap *= 2;
+        }
+        img->buf = (char *)realloc(img->buf, cap);
+        img->cap = cap;
+    }
+    memcpy(img->buf + img->len, data, len);
+    img->len += len;
+}
+
+static void put_int(image_t img, unsigned int i){
+
+    put(img, &i, sizeof(i));
+}
+
+static void put_str(image_t img, const char * str){
+//the terminator is kept, so that strings are read in place
+    unsigned int len = str ? strlen(str) + 1 : 0;
+    put_int(img, len);
+    put(img, str, len);
+}
+
+static void put_config(image_t img, const config_t conf){
+
+    unsigned int i = 0;
+    unsigned int j = 0;
+    put_int(img, conf->size);
+    for(; i < conf->size; i++){
+        entry_t e = conf->map[i];
+        int tag = e ? e->type_tag : ENTRY_NONE;
+        put_int(img, tag);
+        if(tag == ENTRY_NONE){
+            continue;
+        }
+        put_str(img, e->name);
+        switch(tag){
+            case ENTRY_INT:
+                put_int(img, e->e.scalar_int);
+                break;
+            case ENTRY_STR:
+                put_str(img, e->e.scalar_str);
+                break;
+            case ENTRY_MAP:
+                put_config(img, e->e.conf);
+                break;
+            case ENTRY_SEQ:
+                put_int(img, e->e.seq ? e->e.seq->size : 0);
+                for(j = 0; e->e.seq && j < e->e.seq->size; j++){
+                    variable_t var = &(e->e.seq->vars[j]);
+                    param_t par = var->params;
+                    unsigned int n = 0;
+                    for(; par; par = par->next, n++);
+                    put_int(img, var->index);
+                    put_str(img, var->name);
+                    put_int(img, n);
+                    for(par = var->params; par; par = par->next){
+                        put_str(img, par->key);
+                        put_str(img, par->value);
+                    }
+                }
+                break;
+            default: break;
+        }
+    }
+}
+
+static int get_int(cursor_t cur, unsigned int * i){
+
+    if(cur->left < sizeof(*i)){
+
+        return CONF_ERR;
+    }
+    memcpy(i, cur->at, sizeof(*i));
+    cur->at += sizeof(*i);
+    cur->left -= sizeof(*i);
+
+    return CONF_OK;
+}
+
+static int get_str(cursor_t cur, const char ** str){
+
+    unsigned int len = 0;
+    if(get_int(cur, &len) < CONF_OK
+    || len > cur->left
+    || (len > 0 && cur->at[len - 1] != 0)){
+
+        return CONF_ERR;
+    }
+    *str = len ? cur->at : NULL;
+    cur->at += len;
+    cur->left -= len;
+
+    return CONF_OK;
+}
+
+static int get_sequence(cursor_t cur, sequence_t * seq){
+
+    unsigned int size = 0;
+    unsigned int i = 0;
+    unsigned int n = 0;
+    const char * key = NULL;
+    const char * val = NULL;
+    //every variable takes at least 3 numbers
+    if(get_int(cur, &size) < CONF_OK
+    || size > cur->left / (3 * sizeof(unsigned int))){
+
+        return CONF_ERR;
+    }
+    if((*seq = new_sequence(size)) == NULL){
+    
+        return CONF_ERR;
+    }
+    for(; i < size; i++){
+        variable_t var = &((*seq)->vars[i]);
+        if(get_int(cur, &var->index) < CONF_OK
+        || get_str(cur, &val) < CONF_OK
+        || get_int(cur, &n) < CONF_OK){
+
+            return CONF_ERR;
+        }
+        var->name = (char *)intern_str(val);
+        for(; n > 0; n--){
+            if(get_str(cur, &key) < CONF_OK
+            || get_str(cur, &val) < CONF_OK
+            || key == NULL){
+
+                return CONF_ERR;
+            }
+            var->params = append_param(var->params, key, val);
+        }
+    }
+    return CONF_OK;
+}
+
+/**
+ * @brief read a configuration image into a configuration 
+ * of the same shape, that is not shared
+ * @param the image
+ * @param the configuration
+ * @return OK or ERR, what was read so far is kept
+ */
+static int get_config(cursor_t cur, config_t conf){
+
+    unsigned int size = 0;
+    unsigned int i = 0;
+    unsigned int tag = 0;
+    unsigned int num = 0;
+    const char * name = NULL;
+    const char * str = NULL;
+    sequence_t seq = NULL;
+    if(get_int(cur, &size) < CONF_OK
+    || size != conf->size){
+
+        return CONF_ERR;
+    }
+    for(; i < size; i++){
+        entry_t e = conf->map[i];
+        if(get_int(cur, &tag) < CONF_OK
+        || tag != (e ? e->type_tag : ENTRY_NONE)){
+
+            return CONF_ERR;
+        }
+        if(tag == ENTRY_NONE){
+            continue;
+        }
+        if(get_str(cur, &name) < CONF_OK
+        || name == NULL
+        || strcmp(name, e->name)){
+
+            return CONF_ERR;
+        }
+        switch(tag){
+            case ENTRY_INT:
+                if(get_int(cur, &num) < CONF_OK){
+
+                    return CONF_ERR;
+                }
+                e->e.scalar_int = (int)num;
+                break;
+            case ENTRY_STR:
+                if(get_str(cur, &str) < CONF_OK
+                || str == NULL){
+
+                    return CONF_ERR;
+                }
+                e->e.scalar_str = strdup_r(e->e.scalar_str, str);
+                break;
+            case ENTRY_MAP:
+                if(get_config(cur, edit_recursive_entry(i, conf)) < CONF_OK){
+
+                    return CONF_ERR;
+                }
+                break;
+            case ENTRY_SEQ:
+                seq = NULL;
+                num = get_sequence(cur, &seq);
+                //kept even when incomplete, to be released with the rest
+                conf = update_entry(i, new_entry_seq(seq, e->name), conf);
+                if((int)num < CONF_OK){
+
+                    return CONF_ERR;
+                }
+                break;
+            default: 
+            
+                return CONF_ERR;
+        }
+    }
+    return CONF_OK;
+}
+
+uint64_t image_key(const char * source, size_t len, const config_t base){
+
+    struct image img = {NULL, 0, 0};
+    uint64_t h = hash_key(14695981039346656037ull, source, len);
+    if(base){
+        put_config(&img, base);
+        h = hash_key(h, img.buf, img.len);
+        free(img.buf);
+    }
+    return h;
+}
+
+int save_config_image(const char * filename, 
+                      uint64_t key, 
+                      const config_t conf){
+
+    struct image img = {NULL, 0, 0};
+    struct image_header head;
+    char path[CONF_STR];
+    FILE * f = NULL;
+    int r = CONF_ERR;
+    if(conf == NULL
+    || snprintf(path, CONF_STR, "%s.tmp", filename) >= CONF_STR){
+
+        return CONF_ERR;
+    }
+    put_config(&img, conf);
+    head.magic = IMAGE_MAGIC;
+    head.version = IMAGE_VERSION;
+    head.key = key;
+    head.length = img.len;
+    head.sum = hash_bytes(2166136261u, img.buf, img.len);
+    //written aside and renamed, so that a reader never sees half of it
+    if((f = fopen(path, "wb"))){
+        if(fwrite(&head, sizeof(head), 1, f) == 1
+        && fwrite(img.buf, 1, img.len, f) == img.len){
+            r = CONF_OK;
+        }
+        if(fclose(f) != 0){
+            r = CONF_ERR;
+        }
+        if(r == CONF_OK && rename(path, filename) != 0){
+            r = CONF_ERR;
+        }
+        if(r < CONF_OK){
+            unlink(path);
+        }
+    }
+    free(img.buf);
+
+    return r;
+}
+
+int load_config_image(const char * filename, 
+                      uint64_t key, 
+                      config_t conf){
+    
+    struct image_header head;
+    struct stat st;
+    struct cursor cur;
+    int r = CONF_ERR;
+    int fd = open(filename, O_RDONLY);
+    if(conf == NULL || fd < 0){
+        if(fd >= 0){
+            close(fd);
+        }
+        return CONF_ERR;
+    }
+    if(fstat(fd, &st) < 0 
+    || st.st_size < (off_t)sizeof(head)){
+        close(fd);
+
+        return CONF_ERR;
+    }
+    const char * map = (const char *)mmap(
+        NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+
+        return CONF_ERR;
+    }
+    memcpy(&head, map, sizeof(head));
+    cur.at = map + sizeof(head);
+    cur.left = st.st_size - sizeof(head);
+    if(head.magic == IMAGE_MAGIC
+    && head.version == IMAGE_VERSION
+    && head.key == key
+    && head.length == cur.left
+    && head.sum == hash_bytes(2166136261u, cur.at, cur.left)){
+        //read into a copy, so that a bad image leaves conf as it was
+        config_t c = copy_config(conf);
+        r = get_config(&cur, c);
+        if(r == CONF_OK && cur.left == 0){
+            unsigned int i = 0;
+            for(; i < c->size; i++){
+                conf = update_entry(i, copy_entry(c->map[i]), conf);
+            }
+        } else {
+            r = CONF_ERR;
+        }
+        clear_config(c);
+    }
+    munmap((void *)map, st.st_size);
+
+    return r;
+}
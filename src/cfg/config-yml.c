@@ -1,3 +1,8 @@
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <yaml.h>
 #include "config.h"
 
@@ -135,16 +140,26 @@ static config_t process_seq_element(
         size = strtol(val, NULL, 10);
     }
     if(size > 0 &&
-        size < CONF_MAX_SEQ){
+        size <= INT_MAX){
         conf = resize_sequence(conf, sequence, (int)size);
     } else if(!strcmp(key, "INDEX")){
-                             
-            *idx = atoi(val);
-    } else {  
-        sequence_t s = get_sequence_entry(sequence, conf); 
+        long index = strtol(val, NULL, 10);
+        if(index >= 0 && index < CONF_SEQ_MAX){
+        
+            *idx = (int)index;
+        } else {
+            *idx = CONF_ERR;
+            conf->err = CONF_ERR;
+        }
+    } else if(*idx >= 0){
+    //variables past the declared size grow the sequence
+        conf = grow_sequence(conf, sequence, *idx + 1);
+        sequence_t s = edit_sequence_entry(sequence, conf); 
         if( s != NULL){                
             conf = store_seq_value(s,*idx,key,val,conf);       
         }    
+    } else {
+        conf->err = CONF_ERR;
     }                            
     return conf;                       
 }
@@ -190,7 +205,7 @@ static config_t process_mapping(
     if( c != NULL &&
         c->type_tag == ENTRY_MAP) {
                     
-        c->e.conf = process(seq,parser,c->e.conf);        
+        c->e.conf = process(seq,parser,edit_recursive_entry(k, conf));
         conf->map[k] = c;
     } else {
                     
@@ -229,6 +244,7 @@ config_t process(int sequence,
         if (!yaml_parser_parse(parser, &event)){   
                 yaml_parser_error(*parser);
                 config->err = CONF_ERR;
+                done = CONF_T;
         } else {
    
             switch(event.type){
@@ -236,8 +252,7 @@ config_t process(int sequence,
 //swap storage to process val after key and vice versa 
                     if(storage == STORE_KEY) {
  
-                            memset(key, 0, CONF_STR);
-                            sprintf(key, "%s", 
+                            snprintf(key, CONF_STR, "%s", 
                                 (char *)event.data.scalar.value);
                         
                             storage = STORE_VAL;
@@ -264,7 +279,7 @@ config_t process(int sequence,
                 case YAML_SEQUENCE_START_EVENT:
 
                     sequence = get_key(key, config);
-                    memset(key, 0, CONF_STR);
+                    key[0] = 0;
                     break;
                 
                 case YAML_SEQUENCE_END_EVENT:
@@ -294,11 +309,13 @@ config_t process(int sequence,
                     
                 default: break;    
             }
-         }
-         if(config->err < CONF_OK) {
-             done = CONF_T;
-             LOGGER("Could not parse event:");
-             log_yml_event(event);
+            if(config->err < CONF_OK) {
+                done = CONF_T;
+                LOGGER("Invalid configuration %s at line %lu, column %lu", 
+                       key,
+                       (unsigned long)event.start_mark.line + 1,
+                       (unsigned long)event.start_mark.column + 1);
+            }
          }            
          //log_yml_event(event);                                  
          yaml_event_delete(&event);   
@@ -312,8 +329,8 @@ static void emit_variable(const variable_t var, yaml_emitter_t *emitter) {
     if(var->name != NULL &&
         var->name[0]) {
        
-        char idx[4];
-        memset(idx, 0, 4);
+        char idx[CONF_NUM];
+        memset(idx, 0, CONF_NUM);
     
         yaml_mapping_start_event_initialize(
     			        &evt,
@@ -336,7 +353,7 @@ static void emit_variable(const variable_t var, yaml_emitter_t *emitter) {
                     		YAML_PLAIN_SCALAR_STYLE); 
         yaml_emitter_emit(emitter, &evt);
                     		
-        sprintf(idx, "%d", var->index);		
+        sprintf(idx, "%u", var->index);		
         yaml_scalar_event_initialize(
                         	&evt,
                     	    NULL,
@@ -477,12 +494,11 @@ static void emit_entry(const entry_t entry, yaml_emitter_t *emitter) {
     		r = yaml_emitter_emit(emitter, &evt);
     		if(r == 0) { log_yml_event(evt); }
     		if(entry->e.conf){
-    		        iter = *(entry->e.conf->map);
-			while(i < entry->e.conf->size){
+			for(; i < entry->e.conf->size; i++){
+			    iter = (entry->e.conf->map)[i];
 			    if(iter != NULL) {
 				    emit_entry(iter, emitter);  
 				}
-				iter = (entry->e.conf->map)[++i];
 			}	
 			yaml_mapping_end_event_initialize(&evt); 	
             		yaml_emitter_emit(emitter, &evt); 
@@ -558,13 +574,13 @@ int emit(yaml_emitter_t *emitter, const config_t conf) {
     yaml_emitter_emit(emitter, &evt);
     //log_yml_event(evt);
 
-    entry_t iter = conf->map[0];
+    entry_t iter = NULL;
     int i = 0;
-    while(i < conf->size) {
+    for(; i < conf->size; i++) {
+        iter = conf->map[i];
         if(iter){
     	    emit_entry(iter, emitter);
     	}
-    	iter = conf->map[++i];
     }
    
     //mapping end
@@ -643,55 +659,117 @@ int save_config(const char * filename, const config_t conf) {
 
 config_t load_config(const char * filename, config_t conf) {
     yaml_parser_t parser;
-    
-    FILE * fcfg;
+    struct stat st;
     char path[CONF_STR];
-
-    memset(path, 0, CONF_STR);
-    sprintf(path, "%s", filename);
-    
-    memset(&parser, 0, sizeof(parser));
-    
+    const char * src = "";
     config_t r = conf;
     
-    if (!yaml_parser_initialize(&parser)) {
-    
-        yaml_parser_error(parser);    
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        r->err = CONF_ERR;
+        LOGGER("Could not open file %s", filename);
+        
+        return r;
+    }
+    if (st.st_size > 0) {
+        src = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (src == MAP_FAILED) {
+        r->err = CONF_ERR;
+        LOGGER("Could not read file %s", filename);
+        
+        return r;
     }
-    if ((fcfg = fopen(path, "r"))) {
-        LOGGER("Looking for configuration from %s ...", path);
-        yaml_parser_set_input_file(&parser, fcfg);
+    LOGGER("Looking for configuration from %s ...", filename);
+    //an unchanged file is not parsed again, its image is mapped instead
+    uint64_t key = image_key(src, st.st_size, conf);
+    //a name too long for its image is parsed every time
+    int cached = snprintf(path, CONF_STR, "%s%s", filename, CONF_IMAGE) 
+                    < CONF_STR;
+    if (cached && load_config_image(path, key, conf) == CONF_OK) {
+        LOGGER("Loaded configuration image %s", path);
+    } else {
+        memset(&parser, 0, sizeof(parser));
+        if (!yaml_parser_initialize(&parser)) {
+            yaml_parser_error(parser);    
+        }
+        yaml_parser_set_input_string(&parser, 
+            (const yaml_char_t *)src, 
+            st.st_size);
         r = process(CONF_ERR, &parser, conf);
-        if(r->err < CONF_OK)
+        if (r->err < CONF_OK) {
             LOGGER( "Configuration error ");
-        fclose(fcfg);
-    } else {
-        r->err = CONF_ERR;
-        LOGGER("Could not open file %s", filename);
+        } else if (cached && save_config_image(path, key, r) < CONF_OK) {
+            LOGGER("Could not save configuration image %s", path);
+        }
+        yaml_parser_delete(&parser);
+    }
+    if (st.st_size > 0) {
+        munmap((void *)src, st.st_size);
     }
-    yaml_parser_delete(&parser);
     return r;
 }
 
+/**
+ * @brief text the emitter writes to, grown as needed and kept terminated
+ */
+struct yaml_output {
+    char * buf;
+    size_t len;
+    size_t cap;
+};
+
+static int write_output(void * data, unsigned char * buffer, size_t size) {
+
+    struct yaml_output * out = (struct yaml_output *)data;
+    if(out->buf == NULL){
+    
+        return 0;
+    }
+    if(out->len + size + 1 > out->cap){
+        size_t cap = out->cap;
+        while(cap < out->len + size + 1){
+            cap *= 2;
+        }
+        char * buf = (char *)realloc(out->buf, cap);
+        if(buf == NULL){//nothing half written is returned
+            free(out->buf);
+            out->buf = NULL;
+        
+            return 0;
+        }
+        out->buf = buf;
+        out->cap = cap;
+    }
+    memcpy(out->buf + out->len, buffer, size);
+    out->len += size;
+    out->buf[out->len] = 0;
+    
+    return 1;
+}
+
 char * serialize_config(const config_t conf) {
     
     yaml_emitter_t emitter;
-    size_t written;
+    struct yaml_output out = {NULL, 0, CONF_STR};
     
     if(!yaml_emitter_initialize(&emitter)){
         
         return NULL;    
     }
-    char * buf = (char *)malloc(CONF_STR);       
-    yaml_emitter_set_output_string(
-        &emitter,
-  	    ( yaml_char_t *) buf,
-        CONF_STR,
-        &written);
-    print_config_to_emitter(emitter, conf); 
+    out.buf = (char *)malloc(out.cap);
+    if(out.buf){
+        out.buf[0] = 0;
+        yaml_emitter_set_output(&emitter, write_output, &out);
+        print_config_to_emitter(emitter, conf);
+    }
     yaml_emitter_delete(&emitter);    
     
-    return buf;
+    return out.buf;
 }
 
 config_t deserialize_config(const char * buf, const config_t conf) {
@@ -1,17 +1,233 @@
+#include <pthread.h>
 #include "config.h"
 
+static unsigned int hash(const char * key){
+//FNV-1a
+    unsigned int h = 2166136261u;
+    while(*key){
+        h = (h ^ (unsigned char)*key++) * 16777619u;
+    }
+    return h;
+}
+
 char * strdup_r(char * dest, const char * src) {
 //strdup with realloc
 
-    char * r = (!dest)?(char *)malloc(strlen(src)):realloc(
-                                            (void*)dest, strlen(src));
+    char * r = (!dest)?(char *)malloc(strlen(src) + 1):realloc(
+                                            (void*)dest, strlen(src) + 1);
         
-    memset(r, 0, strlen(src));
+    memset(r, 0, strlen(src) + 1);
     sprintf(r, "%s", src);
     
     return r;
 }
 
+/*string pool shared by all the configurations, 
+the strings live in an arena that grows by CONF_ARENA sized chunks*/
+static struct pool {
+    pthread_mutex_t lock;
+    unsigned int size; //power of 2
+    unsigned int count;
+    const char ** slots;
+    char * chunk; //the arena chunk being filled
+    unsigned int used;
+} Pool = {PTHREAD_MUTEX_INITIALIZER, 0, 0, NULL, NULL, CONF_ARENA};
+
+static char * arena_copy(const char * str){
+
+    unsigned int len = strlen(str) + 1;
+    char * r = NULL;
+    if(len > CONF_ARENA / 4){//long strings get a block of their own
+        r = (char *)malloc(len);
+    } else {
+        if(Pool.used + len > CONF_ARENA){
+            Pool.chunk = (char *)malloc(CONF_ARENA);
+            Pool.used = 0;
+        }
+        r = Pool.chunk + Pool.used;
+        Pool.used += len;
+    }
+    memcpy(r, str, len);
+    
+    return r;
+}
+
+static void grow_pool(){
+
+    unsigned int size = Pool.size ? 2 * Pool.size : CONF_ARENA / 4;
+    const char ** slots = (const char **)calloc(size, sizeof(char *));
+    unsigned int i = 0;
+    for(; i < Pool.size; i++){
+        if(Pool.slots[i]){
+            unsigned int h = hash(Pool.slots[i]) & (size - 1);
+            while(slots[h]){
+                h = (h + 1) & (size - 1);
+            }
+            slots[h] = Pool.slots[i];
+        }
+    }
+    free(Pool.slots);
+    Pool.slots = slots;
+    Pool.size = size;
+}
+
+const char * intern_str(const char * str){
+
+    if(str == NULL){
+    
+        return NULL;
+    }
+    pthread_mutex_lock(&Pool.lock);
+    if(2 * (Pool.count + 1) > Pool.size){
+        grow_pool();
+    }
+    unsigned int h = hash(str) & (Pool.size - 1);
+    while(Pool.slots[h] && strcmp(Pool.slots[h], str)){
+        h = (h + 1) & (Pool.size - 1);
+    }
+    if(Pool.slots[h] == NULL){
+        Pool.slots[h] = arena_copy(str);
+        Pool.count++;
+    }
+    const char * r = Pool.slots[h];
+    pthread_mutex_unlock(&Pool.lock);
+    
+    return r;
+}
+
+static unsigned int table_size(unsigned int n){
+
+    unsigned int size = 2 * CONF_INDEX;
+    while(size < 2 * n){
+        size <<= 1;
+    }
+    return size;
+}
+
+typedef const char * (*name_at_t)(const void * of, int i);
+
+static const char * var_name(const void * seq, int i){
+
+    return ((const struct sequence *)seq)->vars[i].name;
+}
+
+static const char * entry_name(const void * conf, int i){
+
+    entry_t e = ((const struct config *)conf)->map[i];
+    return e ? e->name : NULL;
+}
+
+static name_table_t index_names(const void * of, int n, name_at_t name_at){
+
+    name_table_t t = (name_table_t)malloc(sizeof(struct name_table));
+    t->size = table_size(n);
+    t->slots = (unsigned int *)calloc(t->size, sizeof(unsigned int));
+    int i = 0;
+    for(; i < n; i++){
+        const char * name = name_at(of, i);
+        if(name == NULL){
+            continue;
+        }
+        unsigned int h = hash(name) & (t->size - 1);
+        while(t->slots[h] 
+        && strcmp(name_at(of, t->slots[h] - 1), name)){
+            h = (h + 1) & (t->size - 1);
+        }
+        if(!t->slots[h]){//the first of equal names is found
+            t->slots[h] = i + 1;
+        }
+    }
+    return t;
+}
+
+static int find_name(const name_table_t t, 
+                     const void * of, 
+                     const char * name, 
+                     name_at_t name_at){
+    unsigned int h = hash(name) & (t->size - 1);
+    while(t->slots[h]){
+        if(!strcmp(name_at(of, t->slots[h] - 1), name)){
+        
+            return t->slots[h] - 1;
+        }
+        h = (h + 1) & (t->size - 1);
+    }
+    return CONF_ERR;
+}
+
+static name_table_t drop_names(name_table_t t){
+
+    if(t){
+        free(t->slots);
+        free(t);
+    }
+    return NULL;
+}
+
+static config_t share_config(config_t c){
+
+    if(c){
+        __atomic_add_fetch(&c->refs, 1, __ATOMIC_RELAXED);
+    }
+    return c;
+}
+
+static sequence_t share_sequence(sequence_t s){
+
+    if(s){
+        __atomic_add_fetch(&s->refs, 1, __ATOMIC_RELAXED);
+    }
+    return s;
+}
+
+static void clear_params(param_t params){
+
+    if(params && params->table){
+        free(params->table->slots);
+        free(params->table);
+    }
+    while(params){//keys are pooled, values are not
+        param_t next = params->next;
+        free(params->value);
+        free(params);
+        params = next;
+    }
+}
+
+static sequence_t clear_sequence(sequence_t s){
+
+    if(s == NULL
+    || __atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) >= 0){
+    
+        return NULL;
+    }
+    int i = 0;
+    for(; i < s->size; i++){
+        clear_params(s->vars[i].params);
+    }
+    drop_names(s->table);
+    free(s->vars);
+    free(s);
+    
+    return NULL;
+}
+
+static void clear_entry(entry_t e){
+
+    if(e == NULL){
+    
+        return;
+    }
+    if(e->type_tag == ENTRY_MAP){
+        clear_config(e->e.conf);
+    } else if(e->type_tag == ENTRY_SEQ){
+        clear_sequence(e->e.seq);
+    } else if(e->type_tag == ENTRY_STR){
+        free(e->e.scalar_str);
+    }
+    free(e);
+}
+
 entry_t new_entry_int(int i, char * name) {
 	entry_t r = (entry_t)malloc(sizeof(struct entry));
 	r->type_tag = ENTRY_INT;
@@ -26,8 +242,7 @@ entry_t new_entry_str(char * str, char * name) {
 	entry_t r = (entry_t)malloc(sizeof(struct entry));
 	r->type_tag = ENTRY_STR;
 	r->name = name;
-	r->e.scalar_str = (char *)malloc(sizeof(str));
-    sprintf(r->e.scalar_str, "%s", str);
+	r->e.scalar_str = strdup_r(NULL, str);
 	return r;
 }
 
@@ -72,7 +287,11 @@ config_t update_entry(
     } else {
     
         config_t r = conf;
+        if(r->map[key] != item){
+            clear_entry(r->map[key]);
+        }
         r->map[key] = item;
+        r->table = drop_names(r->table);
         
         return r;
     }
@@ -82,7 +301,7 @@ entry_t get_entry(int key, const config_t conf){
 
     if(conf == NULL || 
         key < 0 || 
-        key > conf->size) {
+        key >= conf->size) {
         
         return NULL;    
     }
@@ -109,11 +328,11 @@ entry_t copy_entry(entry_t other){
                     other->name);
 	        break;
 	    case ENTRY_MAP:
-	        r = new_entry_map(copy_config(other->e.conf), other->name);
+	        r = new_entry_map(share_config(other->e.conf), other->name);
 	        
 	        break;
 	    case ENTRY_SEQ:
-	        r = new_entry_seq(copy_sequence(other->e.seq), other->name);
+	        r = new_entry_seq(share_sequence(other->e.seq), other->name);
 	        break;
         default: //NULL
             r = new_entry_null();
@@ -168,8 +387,31 @@ sequence_t get_sequence_entry(int key, const config_t conf){
     }    
 }
 
+sequence_t edit_sequence_entry(int key, config_t conf){
+    entry_t e = get_entry(key, conf);
+    if(e == NULL || e->type_tag != ENTRY_SEQ){
+    
+        return NULL;
+    }
+    sequence_t s = e->e.seq;
+    if(s && __atomic_load_n(&s->refs, __ATOMIC_ACQUIRE) > 0){
+        sequence_t copy = copy_sequence(s);
+        if(copy == NULL){
+        
+            return NULL;
+        }
+        e->e.seq = copy;
+        clear_sequence(s);
+    }
+    return e->e.seq;
+}
+
 variable_t get_variable(const char * name, const sequence_t seq){
-    if(seq != NULL){
+    if(seq == NULL || name == NULL){
+    
+        return NULL;
+    }
+    if(seq->size < CONF_INDEX){
         int i = 0;
         for(; i < seq->size; i++){
             if(seq->vars[i].name != NULL &&
@@ -178,8 +420,14 @@ variable_t get_variable(const char * name, const sequence_t seq){
                 return &(seq->vars[i]);            
             }
         }
+        return NULL;
     }
-    return NULL;
+    if(seq->table == NULL){
+        seq->table = index_names(seq, seq->size, var_name);
+    }
+    int i = find_name(seq->table, seq, name, var_name);
+    
+    return i == CONF_ERR ? NULL : &(seq->vars[i]);
 }
 
 config_t get_recursive_entry(int key, const config_t conf){
@@ -193,6 +441,20 @@ config_t get_recursive_entry(int key, const config_t conf){
     }    
 }
 
+config_t edit_recursive_entry(int key, config_t conf){
+    entry_t e = get_entry(key, conf);
+    if(e == NULL || e->type_tag != ENTRY_MAP){
+    
+        return NULL;
+    }
+    config_t c = e->e.conf;
+    if(c && __atomic_load_n(&c->refs, __ATOMIC_ACQUIRE) > 0){
+        e->e.conf = copy_config(c);
+        clear_config(c);
+    }
+    return e->e.conf;
+}
+
 config_t set_recursive_entry(int key, const config_t val, config_t conf){
     config_t c = conf;
    
@@ -200,25 +462,68 @@ config_t set_recursive_entry(int key, const config_t val, config_t conf){
     if(!e){
         return NULL;
     }
-    e->e.conf = val;
+    config_t old = e->e.conf;
+    e->e.conf = share_config(val);
+    clear_config(old);
     conf->map[key] = e;
     
     return c;
 }
 
 
-//TODO: in a c++ impl. this would be a hashmap
 param_t new_param(const char * key, 
                      const char * val){
     
         param_t n = (param_t)malloc(sizeof(struct param));
-        n->key = strdup(key);
-        n->value = strdup(val);
+        n->key = (char *)intern_str(key);
+        n->value = strdup_r(NULL, val);
         n->next = NULL;
+        n->table = NULL;
         
         return n;        
 }
 
+static void insert_param(param_table_t t, param_t par){
+
+    unsigned int h = hash(par->key) & (t->size - 1);
+    while(t->slots[h]){
+        if(!strcmp(t->slots[h]->key, par->key)){
+        //the first of equal keys is found
+            return;
+        }
+        h = (h + 1) & (t->size - 1);
+    }
+    t->slots[h] = par;
+    t->count++;
+}
+
+static param_table_t index_params(const param_t params, unsigned int n){
+
+    param_table_t t = (param_table_t)malloc(sizeof(struct param_table));
+    t->size = table_size(n);
+    t->count = 0;
+    t->slots = (param_t *)calloc(t->size, sizeof(param_t));
+    param_t it = params;
+    for(; it; it = it->next){
+        insert_param(t, it);
+        t->last = it;
+    }
+    return t;
+}
+
+static param_t find_param(const param_table_t t, const char * key){
+
+    unsigned int h = hash(key) & (t->size - 1);
+    while(t->slots[h]){
+        if(!strcmp(t->slots[h]->key, key)){
+        
+            return t->slots[h];
+        }
+        h = (h + 1) & (t->size - 1);
+    }
+    return NULL;
+}
+
 param_t copy_params(param_t other){
     param_t iter = other;
     param_t r = NULL;
@@ -230,16 +535,27 @@ param_t copy_params(param_t other){
 }
 
 param_t get_param(const char * key, const param_t params){
+    if(params == NULL || key == NULL){
+    
+        return NULL;
+    }
+    if(params->table){
+    
+        return find_param(params->table, key);
+    }
     param_t it = params;
-    while(it && key){
+    param_t found = NULL;
+    unsigned int n = 0;
+    for(; it && found == NULL; it = it->next, n++){
         if(!strcmp(it->key, key)){
-        
-            return it;
+            found = it;
         }
-        it = it->next;            
     }
-    
-    return NULL;
+    if(n >= CONF_INDEX){//long enough to be looked up again
+        for(; it; it = it->next, n++);
+        params->table = index_params(params, n);
+    }
+    return found;
 }
 
 char * get_param_val(const char * key, const param_t params){
@@ -250,11 +566,11 @@ char * get_param_val(const char * key, const param_t params){
 
 config_t edit_seq_param(config_t conf,                     
                                 const char * seq_name, 
-                                unsigned char idx,
+                                unsigned int idx,
                                 const char * key, 
                                 const char * val){
     int k = get_key(seq_name, conf);
-    sequence_t seq = get_sequence_entry(k, conf);
+    sequence_t seq = edit_sequence_entry(k, conf);
     if(seq == NULL || k == CONF_ERR){
     
         return NULL;
@@ -271,12 +587,24 @@ param_t append_param(const param_t params,
         return new_param(key, val);
     } else {
         param_t ret = params;
-        param_t it = params;
-        while(it->next){
-            it = it->next;
-        }
+        param_table_t t = params->table;
+        param_t it = t ? t->last : params;
+        unsigned int n = 1;
+        for(; it->next; it = it->next, n++);
         it->next = new_param(key, val);
-                
+        if(t){
+            if(2 * (t->count + 1) > t->size){
+                n = 2 * t->count;
+                free(t->slots);
+                free(t);
+                ret->table = index_params(ret, n);
+            } else {
+                insert_param(t, it->next);
+                t->last = it->next;
+            }
+        } else if(n >= CONF_INDEX){
+            ret->table = index_params(ret, n + 1);
+        }
         return ret;    
     }
 }
@@ -294,7 +622,6 @@ param_t update_param(const param_t params,
         if(par){
             par->value = strdup_r(par->value, val);
         } else {
-        //FIXME: ..and this is why we need a hashmap.
             ret = append_param(ret, key, val);  
         } 
         return ret;    
@@ -302,7 +629,13 @@ param_t update_param(const param_t params,
 }
 
 int get_key(const char * name, const config_t where) {
-     if(where != NULL){
+    if(where != NULL && name != NULL && where->size >= CONF_INDEX){
+        if(where->table == NULL){
+            where->table = index_names(where, where->size, entry_name);
+        }
+        return find_name(where->table, where, name, entry_name);
+    }
+    if(where != NULL){
     
         for(int i = 0; i < where->size; i++) {
             if( where->map[i] != NULL &&
@@ -341,12 +674,24 @@ config_t copy_config(config_t other){
 
 sequence_t new_sequence(int size) {
     
-    sequence_t r = (sequence_t)malloc(size*sizeof(struct sequence));
+    if(size < 0 || size > CONF_SEQ_MAX){
+    
+        return NULL;
+    }
+    sequence_t r = (sequence_t)malloc(sizeof(struct sequence));
+    if(r == NULL){
+    
+        return NULL;
+    }
 	memset(r, 0, sizeof(struct sequence));
 	r->size = size;
-	r->vars = (variable_t)malloc(size*sizeof(struct variable));
-	memset(r->vars, 0, size*sizeof(struct variable));
-	
+	r->cap = size;
+	r->vars = (variable_t)calloc(size ? size : 1, sizeof(struct variable));
+	if(r->vars == NULL){
+	    free(r);
+	    
+	    return NULL;
+	}
 	return r;
 }
 
@@ -356,12 +701,14 @@ sequence_t copy_sequence(sequence_t other){
         return NULL;
     }
     sequence_t r = new_sequence(other->size);
+    if(r == NULL){
+    
+        return NULL;
+    }
     int i = 0;
     for(;i < other->size; i++){
         r->vars[i].index = other->vars[i].index;
-        if(other->vars[i].name){
-            r->vars[i].name = strdup(other->vars[i].name);
-        }
+        r->vars[i].name = (char *)intern_str(other->vars[i].name);
         r->vars[i].params = copy_params(other->vars[i].params);
     }
     return r;
@@ -369,7 +716,20 @@ sequence_t copy_sequence(sequence_t other){
 
 config_t clear_config(config_t c){
 
-    return (config_t)NULL;
+    if(c == NULL
+    || __atomic_sub_fetch(&c->refs, 1, __ATOMIC_ACQ_REL) >= 0){
+    
+        return NULL;
+    }
+    int i = 0;
+    for(; i < c->size; i++){
+        clear_entry(c->map[i]);
+    }
+    drop_names(c->table);
+    free(c->map);
+    free(c);
+    
+    return NULL;
 }
 
 
@@ -412,7 +772,7 @@ config_t store_value(
 
 config_t store_seq_value(
                     const sequence_t s,
-                    unsigned char idx,  
+                    unsigned int idx,  
                     const char * key,
                     const char * value, 
                     config_t config){
@@ -426,29 +786,65 @@ config_t store_seq_value(
         return conf;
     }            
     variable_t var = &(s->vars[idx]);
-    s->vars[idx].index = idx;
+    var->index = idx;
     if(!strcmp(key, "ID")){
-        s->vars[idx].name = strdup_r(var->name, value);
+        var->name = (char *)intern_str(value);
+        s->table = drop_names(s->table);
     } else {
-        s->vars[idx].params = update_param(s->vars[idx].params,key,value);    
+        var->params = update_param(var->params,key,value);    
     }   
     return conf;                       
 }
 
 config_t resize_sequence(config_t config, int sequence, int size){
     config_t conf = config;
-    sequence_t seq = get_sequence_entry(sequence, conf);
+    entry_t e = get_entry(sequence, conf);
+    sequence_t seq = NULL;
     if(size <= 0 ||
-        size > CONF_MAX_SEQ || 
-        seq == NULL){
+        e == NULL ||
+        e->type_tag != ENTRY_SEQ ||
+        (seq = new_sequence(size)) == NULL){
         conf->err = CONF_ERR;
         
         return conf;
     }  
-    seq->size = size;
-	seq->vars = (variable_t)realloc(seq->vars, size*sizeof(struct variable));
-	memset(seq->vars, 0, size*sizeof(struct variable));    
+    //the values are dropped, even a shared sequence is just replaced
+    sequence_t old = e->e.seq;
+    e->e.seq = seq;
+    clear_sequence(old);
+        
+    return conf;
+}
+
+config_t grow_sequence(config_t config, int sequence, int size){
+    config_t conf = config;
+    sequence_t seq = NULL;
+    if(size > CONF_SEQ_MAX
+    || (seq = edit_sequence_entry(sequence, conf)) == NULL){
+        conf->err = CONF_ERR;
         
+        return conf;
+    }
+    if(size > seq->cap){
+        int cap = seq->cap > 0 ? seq->cap : 1;
+        while(cap < size){
+            cap *= 2;
+        }
+        variable_t vars = (variable_t)realloc(seq->vars, 
+                                              cap*sizeof(struct variable));
+        if(vars == NULL){
+            conf->err = CONF_ERR;
+            
+            return conf;
+        }
+        seq->vars = vars;
+        memset(seq->vars + seq->cap, 0, 
+               (cap - seq->cap)*sizeof(struct variable));
+        seq->cap = cap;
+    }
+    if(size > seq->size){//the name index still holds
+        seq->size = size;
+    }
     return conf;
 }
 
@@ -4,15 +4,19 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "util.h"
 #define LOGGER plc_log
 #define CONF_OK 0
 #define CONF_ERR -1
 #define CONF_STR 2048 //string length
-#define CONF_MAX_SEQ 256 //max sequence elements
 #define CONF_NUM 24 //number digits 
+#define CONF_SEQ_MAX 65536 //variables in a sequence, whatever a file asks for
 #define CONF_F 0
 #define CONF_T 1
+#define CONF_INDEX 8 //shorter lists are searched linearly
+#define CONF_ARENA 4096 //string pool chunk size
+#define CONF_IMAGE ".img" //suffix of the binary image of a configuration file
 
 typedef enum {
     STORE_KEY,
@@ -33,14 +37,31 @@ typedef struct param {
     char * key; //min, max, default, preset, readonly, countdown, etc.
     char * value;
     struct param * next;
+    struct param_table * table; //hash index of the list, kept by its head
 } * param_t;
 
-/*FIXME: make a hashmap out of this */
-#define MAX_PARAM 256
-typedef param_t * param_table_t;
+/**
+ * @brief open addressing hash index of a parameter list, 
+ * built on the first long lookup and kept in sync by append
+ */
+typedef struct param_table {
+    unsigned int size; //power of 2
+    unsigned int count;
+    param_t last; //to append without walking the list
+    param_t * slots;
+} * param_table_t;
+
+/**
+ * @brief open addressing hash index of variable names,
+ * built on the first lookup and dropped when a name changes
+ */
+typedef struct name_table {
+    unsigned int size; //power of 2
+    unsigned int * slots; //variable index + 1, 0 is empty
+} * name_table_t;
 
 typedef struct variable {
-    unsigned char index;
+    unsigned int index;
     char * name ;
 /*    unsigned char updated;
     char * value;
@@ -50,7 +71,10 @@ typedef struct variable {
 
 typedef struct sequence {
     int size;
+    int cap; //allocated variables
     variable_t vars;
+    name_table_t table; //by variable name
+    int refs; //owners besides the first, written only when 0
 } * sequence_t;
 
 typedef struct entry {
@@ -71,17 +95,37 @@ typedef struct config {
     unsigned int size;
     int err;
     entry_map_t map;
+    name_table_t table; //by entry name
+    int refs; //owners besides the first, written only when 0
 } * config_t;
 
+/**
+ * @brief intern a string in the pool shared by all configurations,
+ * so that copies share it instead of duplicating it.
+ * Only for names and keys: values change at runtime and are owned
+ * @param the string
+ * @return the pooled string, the same for equal strings.
+ * It is never freed and must not be written to
+ */
+const char * intern_str(const char * str);
+
+/**
+ * @brief duplicate a string into a buffer reallocated to fit it
+ * @param the buffer, or NULL for a new one
+ * @param the string
+ * @return the buffer
+ */
+char * strdup_r(char * dest, const char * src);
+
 /**
  * @brief construct a sequence
- * @param the size of the sequence
- * @return a newly alloced sequence
+ * @param the size of the sequence, up to CONF_SEQ_MAX
+ * @return a newly alloced sequence, or NULL
  */
 sequence_t new_sequence(int size);
 
 /**
- * @brief copy a sequence
+ * @brief deep copy a sequence
  * @param another sequence
  * @return a newly alloced sequence
  */
@@ -95,14 +139,15 @@ sequence_t copy_sequence(sequence_t other);
 config_t new_config(int size);
 
 /**
- * @brief copy a configuration
+ * @brief copy a configuration, the copy has its own entries 
+ * but shares the nested maps and sequences, copied on write
  * @param another configuration
  * @return a newly alloced config
  */
 config_t copy_config(config_t other);
 
 /**
- * @brief cleanup and free configuration
+ * @brief release a configuration, it is freed with its last owner
  * @param the configuration
  * @return NULL
  */
@@ -163,7 +208,7 @@ config_t update_entry(unsigned int key,
 entry_t get_entry(int key, const config_t conf);
 
 /**
- * @brief copy an entry
+ * @brief copy an entry, sharing its map or sequence
  * @param another entry
  * @return newly allocated entry
  */
@@ -194,6 +239,15 @@ char * get_string_entry(int key, const config_t conf);
  */
 sequence_t get_sequence_entry(int key, const config_t conf);
 
+/**
+ * @brief get sequence config entry by key, to write to it.
+ * A shared sequence is copied first
+ * @param the key
+ * @param the configuration, that must not be shared
+ * @return the sequence, only owned by the configuration, or NULL
+ */
+sequence_t edit_sequence_entry(int key, config_t conf);
+
 /**
  * @brief get variable by name
  * @param the name
@@ -208,7 +262,17 @@ variable_t get_variable(const char * name, const sequence_t seq);
 config_t get_recursive_entry(int key, const config_t conf);
 
 /**
- * @brief set recursive map config entry by key
+ * @brief get recursive map config entry by key, to write to it.
+ * A shared map is copied first
+ * @param the key
+ * @param the configuration, that must not be shared
+ * @return the map, only owned by the configuration, or NULL
+ */
+config_t edit_recursive_entry(int key, config_t conf);
+
+/**
+ * @brief set recursive map config entry by key, 
+ * the map is shared and the previous one released
  * @param the key
  * @param the recursive value
  * @param the configuration
@@ -276,7 +340,7 @@ param_t update_param(const param_t params,
  */
 config_t edit_seq_param(config_t conf,                     
                                 const char * seq_name, 
-                                unsigned char idx,
+                                unsigned int idx,
                                 const char * key, 
                                 const char * val);
 
@@ -294,7 +358,7 @@ config_t store_value(
 
 /**
  * @brief store a value to a map that is nested in a sequence
- * @param the sequence 
+ * @param the sequence, from edit_sequence_entry 
  * @param the sequence index
  * @param the key
  * @param the value
@@ -302,7 +366,7 @@ config_t store_value(
  * @return config with applied value or changed errorcode
  */
 config_t store_seq_value(const sequence_t seq,
-                    unsigned char idx, 
+                    unsigned int idx, 
                     const char * key, 
                     const char * value, 
                     config_t c);
@@ -316,14 +380,58 @@ config_t store_seq_value(const sequence_t seq,
 config_t copy_sequences(const config_t from, config_t to);
 
 /**
- * @brief resize sequence in memory
+ * @brief resize sequence in memory, dropping its variables
  * @param the configuration
  * @param seq number
- * @param new size
- * @return updated configuration
+ * @param new size, up to CONF_SEQ_MAX
+ * @return updated configuration, with err set if the size is invalid
  */
 config_t resize_sequence(config_t config, int sequence, int size);
 
+/**
+ * @brief grow a sequence, keeping its variables. 
+ * Memory grows geometrically, so growing by one is amortized O(1)
+ * @param the configuration
+ * @param seq number
+ * @param new size, smaller sizes are ignored, larger than CONF_SEQ_MAX fail
+ * @return updated configuration, with err set if it could not grow
+ */
+config_t grow_sequence(config_t config, int sequence, int size);
+
+/********binary image of a loaded configuration, to skip parsing it again*****/
+
+/**
+ * @brief key of a configuration image
+ * @param the source text of the configuration
+ * @param its length
+ * @param the configuration the text is loaded into, with its defaults
+ * @return a 64 bit hash of both, that changes when either does
+ */
+uint64_t image_key(const char * source, size_t len, const config_t base);
+
+/**
+ * @brief save a configuration image, replacing the previous one at once
+ * @param filename (full path)
+ * @param the key of what the configuration was loaded from
+ * @param the loaded configuration
+ * @return OK or ERR
+ */
+int save_config_image(const char * filename, 
+                      uint64_t key, 
+                      const config_t conf);
+
+/**
+ * @brief map a configuration image into a configuration
+ * @param filename (full path)
+ * @param the key the image must have been saved with
+ * @param the configuration, of the same schema as the saved one
+ * @return OK, or ERR when the image is missing, stale or damaged, 
+ * and the configuration is left as it was
+ */
+int load_config_image(const char * filename, 
+                      uint64_t key, 
+                      config_t conf);
+
 /********these are abstract, implementation is required per serialization format (yml/json/cbor)*****/
 
 /**
@@ -353,7 +461,7 @@ int print_config(FILE * f, const config_t conf);
 /**
  * @brief serialize configuration to a string
  * @param the configuration where the parsed values are stored
- * @return string allocated with CONF_STR size  
+ * @return terminated string of any length, or NULL on error; 
  * must be consequently free'd.
  */          
 char * serialize_config(const config_t conf);
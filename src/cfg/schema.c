@@ -5,6 +5,275 @@
  *@brief configuration schema 
 */
 
+struct entry SimSchema[N_SIM_VARS] = {
+    {
+        .type_tag = ENTRY_STR,
+        .name = "INPUT",
+        .e = {
+            .scalar_str = ""
+        }
+    },
+    {
+        .type_tag = ENTRY_STR,
+        .name = "OUTPUT",
+        .e = {
+            .scalar_str = ""
+        }
+    },
+};
+
+struct entry ShmSchema[N_SHM_VARS] = {
+    {
+        .type_tag = ENTRY_STR,
+        .name = "NAME",
+        .e = {
+            .scalar_str = "/plcemu"
+        }
+    },
+    {
+        .type_tag = ENTRY_INT,
+        .name = "STEPPED",
+        .e = {
+            .scalar_int = 0
+        }
+    },
+};
+
+struct entry DrySchema[N_DRY_VARS] = {
+    {
+        .type_tag = ENTRY_STR,
+        .name = "PATTERN",
+        .e = {
+            .scalar_str = "CONSTANT"
+        }
+    },
+    {
+        .type_tag = ENTRY_INT,
+        .name = "VALUE",
+        .e = {
+            .scalar_int = 0
+        }
+    },
+};
+
+struct entry GpioSchema[N_GPIO_VARS] = {
+    {
+        .type_tag = ENTRY_STR,
+        .name = "CHIP",
+        .e = {
+            .scalar_str = "/dev/gpiochip0"
+        }
+    },
+    {
+        .type_tag = ENTRY_STR,
+        .name = "INPUTS", //line offsets of DI 0, 1, ...
+        .e = {
+            .scalar_str = ""
+        }
+    },
+    {
+        .type_tag = ENTRY_STR,
+        .name = "OUTPUTS", //line offsets of DQ 0, 1, ...
+        .e = {
+            .scalar_str = ""
+        }
+    },
+    {
+        .type_tag = ENTRY_STR,
+        .name = "EDGE",
+        .e = {
+            .scalar_str = "NONE"
+        }
+    },
+};
+
+//one device slot by default, the yml resizes it
+static struct variable MbcDevices[1];
+
+static struct sequence MbcDeviceSeq = {
+    .size = 1,
+    .vars = MbcDevices
+};
+
+struct entry MbcSchema[N_MBC_VARS] = {
+    {
+        .type_tag = ENTRY_INT,
+        .name = "TIMEOUT", //msecs to wait for all devices every cycle
+        .e = {
+            .scalar_int = 50
+        }
+    },
+    {
+        .type_tag = ENTRY_SEQ,
+        .name = "DEVICES",
+        .e = {
+            .seq = &MbcDeviceSeq
+        }
+    },
+};
+
+//one frame slot by default, the yml resizes it
+static struct variable CanFrames[1];
+
+static struct sequence CanFrameSeq = {
+    .size = 1,
+    .vars = CanFrames
+};
+
+struct entry CanSchema[N_CAN_VARS] = {
+    {
+        .type_tag = ENTRY_STR,
+        .name = "BUS", //network interface, like can0 or vcan0
+        .e = {
+            .scalar_str = "can0"
+        }
+    },
+    {
+        .type_tag = ENTRY_INT,
+        .name = "TIMEOUT", //msecs without a received frame before an error
+        .e = {
+            .scalar_int = 100
+        }
+    },
+    {
+        .type_tag = ENTRY_SEQ,
+        .name = "FRAMES",
+        .e = {
+            .seq = &CanFrameSeq
+        }
+    },
+};
+
+/*statically allocated sub configurations, init_config deep copies them*/
+static entry_t SimMap[N_SIM_VARS] = {
+    &SimSchema[SIM_INPUT],
+    &SimSchema[SIM_OUTPUT],
+};
+
+static struct config SimConfig = {
+    .size = N_SIM_VARS,
+    .err = CONF_OK,
+    .map = SimMap
+};
+
+static entry_t ShmMap[N_SHM_VARS] = {
+    &ShmSchema[SHM_NAME],
+    &ShmSchema[SHM_STEPPED],
+};
+
+static struct config ShmConfig = {
+    .size = N_SHM_VARS,
+    .err = CONF_OK,
+    .map = ShmMap
+};
+
+static entry_t DryMap[N_DRY_VARS] = {
+    &DrySchema[DRY_PATTERN],
+    &DrySchema[DRY_VALUE],
+};
+
+static struct config DryConfig = {
+    .size = N_DRY_VARS,
+    .err = CONF_OK,
+    .map = DryMap
+};
+
+static entry_t GpioMap[N_GPIO_VARS] = {
+    &GpioSchema[GPIO_CHIP],
+    &GpioSchema[GPIO_INPUTS],
+    &GpioSchema[GPIO_OUTPUTS],
+    &GpioSchema[GPIO_EDGE],
+};
+
+static struct config GpioConfig = {
+    .size = N_GPIO_VARS,
+    .err = CONF_OK,
+    .map = GpioMap
+};
+
+static entry_t MbcMap[N_MBC_VARS] = {
+    &MbcSchema[MBC_TIMEOUT],
+    &MbcSchema[MBC_DEVICES],
+};
+
+static struct config MbcConfig = {
+    .size = N_MBC_VARS,
+    .err = CONF_OK,
+    .map = MbcMap
+};
+
+static entry_t CanMap[N_CAN_VARS] = {
+    &CanSchema[CAN_BUS],
+    &CanSchema[CAN_TIMEOUT],
+    &CanSchema[CAN_FRAMES],
+};
+
+static struct config CanConfig = {
+    .size = N_CAN_VARS,
+    .err = CONF_OK,
+    .map = CanMap
+};
+
+struct entry IfaceSchema[N_IFACE_VARS] = {
+    {
+        .type_tag = ENTRY_MAP,
+        .name = "SIM",
+        .e = {
+            .conf = &SimConfig
+        }
+    },
+    {
+        .type_tag = ENTRY_MAP,
+        .name = "SHM",
+        .e = {
+            .conf = &ShmConfig
+        }
+    },
+    {
+        .type_tag = ENTRY_MAP,
+        .name = "DRY",
+        .e = {
+            .conf = &DryConfig
+        }
+    },
+    {
+        .type_tag = ENTRY_MAP,
+        .name = "GPIO",
+        .e = {
+            .conf = &GpioConfig
+        }
+    },
+    {
+        .type_tag = ENTRY_MAP,
+        .name = "MODBUS",
+        .e = {
+            .conf = &MbcConfig
+        }
+    },
+    {
+        .type_tag = ENTRY_MAP,
+        .name = "CAN",
+        .e = {
+            .conf = &CanConfig
+        }
+    },
+};
+
+static entry_t IfaceMap[N_IFACE_VARS] = {
+    &IfaceSchema[IFACE_SIM],
+    &IfaceSchema[IFACE_SHM],
+    &IfaceSchema[IFACE_DRY],
+    &IfaceSchema[IFACE_GPIO],
+    &IfaceSchema[IFACE_MODBUS],
+    &IfaceSchema[IFACE_CAN],
+};
+
+static struct config IfaceConfig = {
+    .size = N_IFACE_VARS,
+    .err = CONF_OK,
+    .map = IfaceMap
+};
+
 struct entry HwSchema[N_HW_VARS] = {
     {
         .type_tag = ENTRY_STR,
@@ -17,9 +286,148 @@ struct entry HwSchema[N_HW_VARS] = {
         .type_tag = ENTRY_MAP,
         .name = "IFACE",
         .e = {
-            .conf = NULL
+            .conf = &IfaceConfig
         }          
     },
+    {
+        .type_tag = ENTRY_STR,
+        .name = "TYPE",
+        .e = {
+            .scalar_str = "" //empty for the build's default
+        }
+    },
+};
+
+static entry_t HwMap[N_HW_VARS] = {
+    &HwSchema[HW_LABEL],
+    &HwSchema[HW_IFACE],
+    &HwSchema[HW_TYPE],
+};
+
+static struct config HwConfig = {
+    .size = N_HW_VARS,
+    .err = CONF_OK,
+    .map = HwMap
+};
+
+struct entry ModbusSchema[N_MODBUS_VARS] = {
+    {
+        .type_tag = ENTRY_INT,
+        .name = "PORT",
+        .e = {
+            .scalar_int = 0 //disabled
+        }
+    },
+    {
+        .type_tag = ENTRY_INT,
+        .name = "UNIT",
+        .e = {
+            .scalar_int = 255 //any unit
+        }
+    },
+};
+
+static entry_t ModbusMap[N_MODBUS_VARS] = {
+    &ModbusSchema[MODBUS_PORT],
+    &ModbusSchema[MODBUS_UNIT],
+};
+
+static struct config ModbusConfig = {
+    .size = N_MODBUS_VARS,
+    .err = CONF_OK,
+    .map = ModbusMap
+};
+
+//one subscription slot by default, the yml resizes it
+static struct variable PeerSubs[1];
+
+static struct sequence PeerSubSeq = {
+    .size = 1,
+    .vars = PeerSubs
+};
+
+struct entry PeerSchema[N_PEER_VARS] = {
+    {
+        .type_tag = ENTRY_INT,
+        .name = "NODE", //id of this plc in its datagrams
+        .e = {
+            .scalar_int = 0
+        }
+    },
+    {
+        .type_tag = ENTRY_INT,
+        .name = "PORT", //udp port to receive on
+        .e = {
+            .scalar_int = 0 //no subscriptions
+        }
+    },
+    {
+        .type_tag = ENTRY_STR,
+        .name = "PUBLISH", //host:port destinations
+        .e = {
+            .scalar_str = ""
+        }
+    },
+    {
+        .type_tag = ENTRY_INT,
+        .name = "RATE", //msecs between periodic sends
+        .e = {
+            .scalar_int = 100
+        }
+    },
+    {
+        .type_tag = ENTRY_INT,
+        .name = "CHANGE", //also send as soon as the image changes
+        .e = {
+            .scalar_int = 1
+        }
+    },
+    {
+        .type_tag = ENTRY_INT,
+        .name = "STALE", //msecs of silence before a peer is stale
+        .e = {
+            .scalar_int = 500
+        }
+    },
+    {
+        .type_tag = ENTRY_STR,
+        .name = "Q", //published %q, first and count
+        .e = {
+            .scalar_str = ""
+        }
+    },
+    {
+        .type_tag = ENTRY_STR,
+        .name = "M", //published %m, first and count
+        .e = {
+            .scalar_str = ""
+        }
+    },
+    {
+        .type_tag = ENTRY_SEQ,
+        .name = "SUBSCRIBE",
+        .e = {
+            .seq = &PeerSubSeq
+        }
+    },
+};
+
+static entry_t PeerMap[N_PEER_VARS] = {
+    &PeerSchema[PEER_NODE],
+    &PeerSchema[PEER_PORT],
+    &PeerSchema[PEER_PUBLISH],
+    &PeerSchema[PEER_RATE],
+    &PeerSchema[PEER_CHANGE],
+    &PeerSchema[PEER_STALE],
+    &PeerSchema[PEER_Q],
+    &PeerSchema[PEER_M],
+    &PeerSchema[PEER_SUBSCRIBE],
+};
+
+static struct config PeerConfig = {
+    .size = N_PEER_VARS,
+    .err = CONF_OK,
+    .map = PeerMap
 };
 
 struct sequence default_seq = {
@@ -34,11 +442,32 @@ struct entry ConfigSchema[N_CONFIG_VARIABLES] = {
                 .scalar_int = 100
          }
     },
+    {//CONFIG_VIRTUAL,
+         .type_tag = ENTRY_INT,
+         .name = "VIRTUAL",
+         .e = {
+                .scalar_int = 0
+         }
+    },
     {//CONFIG_HW,
          .type_tag = ENTRY_MAP,
          .name = "HW",
          .e = {
-              .conf = NULL//&hw_config
+              .conf = &HwConfig
+         }
+    },
+    {//CONFIG_MODBUS,
+         .type_tag = ENTRY_MAP,
+         .name = "MODBUS",
+         .e = {
+              .conf = &ModbusConfig
+         }
+    },
+    {//CONFIG_PEER,
+         .type_tag = ENTRY_MAP,
+         .name = "PEER",
+         .e = {
+              .conf = &PeerConfig
          }
     },
     {//CONFIG_PROGRAM
@@ -12,6 +12,14 @@ typedef enum{
     MAP_COMEDI,
     MAP_COMEDI_SUBDEV,
     MAP_SIM,
+    MAP_SHM,
+    MAP_DRY,
+    MAP_GPIO,
+    MAP_MBC,
+    MAP_CAN,
+    MAP_IFACE,
+    MAP_MODBUS,
+    MAP_PEER,
     MAP_VARIABLE,
     N_MAPPINGS    
 }CONFIG_MAPPINGS;
@@ -43,15 +51,81 @@ typedef enum {
     N_SIM_VARS
 }SIM_VARS;
 
+typedef enum {
+    SHM_NAME,
+    SHM_STEPPED,
+    N_SHM_VARS
+}SHM_VARS;
+
+typedef enum {
+    DRY_PATTERN,
+    DRY_VALUE,
+    N_DRY_VARS
+}DRY_VARS;
+
+typedef enum {
+    GPIO_CHIP,
+    GPIO_INPUTS,
+    GPIO_OUTPUTS,
+    GPIO_EDGE,
+    N_GPIO_VARS
+}GPIO_VARS;
+
+typedef enum {
+    MBC_TIMEOUT,
+    MBC_DEVICES,
+    N_MBC_VARS
+}MBC_VARS;
+
+typedef enum {
+    CAN_BUS,
+    CAN_TIMEOUT,
+    CAN_FRAMES,
+    N_CAN_VARS
+}CAN_VARS;
+
+typedef enum {
+    IFACE_SIM,
+    IFACE_SHM,
+    IFACE_DRY,
+    IFACE_GPIO,
+    IFACE_MODBUS,
+    IFACE_CAN,
+    N_IFACE_VARS
+}IFACE_VARS;
+
 typedef enum {
     HW_LABEL,
     HW_IFACE,
+    HW_TYPE,
     N_HW_VARS
 }HW_VARS;
 
+typedef enum {
+    MODBUS_PORT,
+    MODBUS_UNIT,
+    N_MODBUS_VARS
+}MODBUS_VARS;
+
+typedef enum {
+    PEER_NODE,
+    PEER_PORT,
+    PEER_PUBLISH,
+    PEER_RATE,
+    PEER_CHANGE,
+    PEER_STALE,
+    PEER_Q,
+    PEER_M,
+    PEER_SUBSCRIBE,
+    N_PEER_VARS
+}PEER_VARS;
+
 typedef enum{
     CONFIG_STEP,
+    CONFIG_VIRTUAL,
     CONFIG_HW,
+    CONFIG_MODBUS,
+    CONFIG_PEER,
      //(runtime updatable) sequences,
     CONFIG_PROGRAM,
     CONFIG_AI,
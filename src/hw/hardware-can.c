@@ -0,0 +1,451 @@
+#define _GNU_SOURCE //sendmmsg, recvmmsg
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+
+#include "util.h"
+
+#include "config.h"
+#include "schema.h"
+#include "hardware.h"
+#include "plclib.h"
+
+#define CAN_BATCH 64 //frames per recvmmsg()
+#define CAN_IMAGE 256 //bytes of %i or %q a frame can be mapped to
+
+/**
+ * @brief a cyclic frame, its payload is a range of bytes of the plc image
+ */
+typedef struct can_pdo{
+    canid_t id; ///with CAN_EFF_FLAG for 29 bit ids
+    unsigned int first; ///first byte in the plc image
+    unsigned int len; ///payload bytes
+    long timeout; ///msecs, only received frames, 0 never times out
+    struct timespec due; ///when the next one has to be received
+    BYTE fresh;
+} * can_pdo_t;
+
+static char * Bus = NULL;
+static int Timeout = 0;
+static int Sock = PLC_ERR;
+
+//received frames sorted by id, transmitted frames in configuration order
+static can_pdo_t Rx = NULL;
+static unsigned int N_rx = 0;
+static can_pdo_t Tx = NULL;
+static unsigned int N_tx = 0;
+
+//the plc image
+static BYTE CanIn[CAN_IMAGE];
+static BYTE CanOut[CAN_IMAGE];
+static unsigned int InSize = 0;
+static unsigned int OutSize = 0;
+
+//one message per frame, so a whole cycle takes one syscall each way
+static struct can_frame RxFrames[CAN_BATCH];
+static struct iovec RxIov[CAN_BATCH];
+static struct mmsghdr RxMsgs[CAN_BATCH];
+static struct can_frame * TxFrames = NULL;
+static struct iovec * TxIov = NULL;
+static struct mmsghdr * TxMsgs = NULL;
+static unsigned int TxFirst = 0; //the oldest frame the queue did not take
+
+struct hardware Can;
+
+static long msecs_until(const struct timespec * t)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (t->tv_sec - now.tv_sec) * THOUSAND
+         + (t->tv_nsec - now.tv_nsec) / (THOUSAND * THOUSAND);
+}
+
+static void msecs_from_now(long msecs, struct timespec * t)
+{
+    clock_gettime(CLOCK_MONOTONIC, t);
+    t->tv_sec += msecs / THOUSAND;
+    t->tv_nsec += (msecs % THOUSAND) * THOUSAND * THOUSAND;
+    if(t->tv_nsec >= THOUSAND * THOUSAND * THOUSAND){
+        t->tv_sec++;
+        t->tv_nsec -= THOUSAND * THOUSAND * THOUSAND;
+    }
+}
+
+static int compare_ids(const void * a, const void * b)
+{
+    canid_t x = ((const struct can_pdo *)a)->id;
+    canid_t y = ((const struct can_pdo *)b)->id;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief parse a byte range of the image, like "0 2"
+ * @param the range
+ * @param the frame to fill in
+ * @param the image size so far, grown to fit the range
+ * @return OK or ERROR
+ */
+static int parse_bytes(const char * val, can_pdo_t f, unsigned int * size)
+{
+    char * end = NULL;
+    long first = strtol(val, &end, 10);
+    long len = strtol(end, &end, 10);
+    if(first < 0
+    || len <= 0
+    || len > CAN_MAX_DLEN
+    || first + len > CAN_IMAGE){
+
+        return PLC_ERR;
+    }
+    f->first = first;
+    f->len = len;
+    if(first + len > *size){
+        *size = first + len;
+    }
+    return PLC_OK;
+}
+
+/**
+ * @brief parse one entry of FRAMES, with an ID and either IN or OUT
+ * @param the entry
+ * @return OK or ERROR
+ */
+static int parse_frame(const variable_t v)
+{
+    char * end = NULL;
+    char * in = get_param_val("IN", v->params);
+    char * out = get_param_val("OUT", v->params);
+    char * timeout = get_param_val("TIMEOUT", v->params);
+    unsigned long id = strtoul(v->name, &end, 0); //0x181 or 385
+    can_pdo_t f = NULL;
+    if(*end
+    || id > CAN_EFF_MASK
+    || (in == NULL) == (out == NULL)){
+
+        return PLC_ERR;
+    }
+    if(in){
+        f = &Rx[N_rx++];
+        if(parse_bytes(in, f, &InSize) < 0){
+
+            return PLC_ERR;
+        }
+        f->timeout = timeout ? atol(timeout) : Timeout;
+    } else {
+        f = &Tx[N_tx++];
+        if(parse_bytes(out, f, &OutSize) < 0){
+
+            return PLC_ERR;
+        }
+    }
+    f->id = id > CAN_SFF_MASK ? id | CAN_EFF_FLAG : id;
+
+    return PLC_OK;
+}
+
+int can_config(const config_t conf)
+{
+    config_t hw = get_recursive_entry(CONFIG_HW, conf);
+    config_t ifc = get_recursive_entry(HW_IFACE, hw);
+    config_t can = get_recursive_entry(IFACE_CAN, ifc);
+    sequence_t frames = get_sequence_entry(CAN_FRAMES, can);
+    unsigned int i = 0;
+
+    Bus = get_string_entry(CAN_BUS, can);
+    Timeout = get_numeric_entry(CAN_TIMEOUT, can);
+    if(Timeout < 0){
+        plc_log("Invalid can timeout");
+
+        return PLC_ERR;
+    }
+    free(Rx);
+    free(Tx);
+    free(TxFrames);
+    free(TxIov);
+    free(TxMsgs);
+    Rx = NULL;
+    Tx = NULL;
+    N_rx = 0;
+    N_tx = 0;
+    TxFirst = 0;
+    InSize = 0;
+    OutSize = 0;
+    if(frames){
+        Rx = (can_pdo_t)calloc(frames->size + 1, sizeof(struct can_pdo));
+        Tx = (can_pdo_t)calloc(frames->size + 1, sizeof(struct can_pdo));
+    }
+    for(; frames && i < frames->size; i++){
+        variable_t v = &frames->vars[i];
+        if(v->name == NULL || v->name[0] == 0){ //unused slot
+            continue;
+        }
+        if(parse_frame(v) < 0){
+            plc_log("Invalid can frame %s, needs an id and IN or OUT bytes",
+                    v->name);
+
+            return PLC_ERR;
+        }
+    }
+    //received frames are looked up by id
+    qsort(Rx, N_rx, sizeof(struct can_pdo), compare_ids);
+    for(i = 1; i < N_rx; i++){
+        if(Rx[i].id == Rx[i - 1].id){
+            plc_log("Can frame %x is received twice", Rx[i].id & CAN_EFF_MASK);
+
+            return PLC_ERR;
+        }
+    }
+    TxFrames = (struct can_frame *)calloc(N_tx + 1, sizeof(struct can_frame));
+    TxIov = (struct iovec *)calloc(N_tx + 1, sizeof(struct iovec));
+    TxMsgs = (struct mmsghdr *)calloc(N_tx + 1, sizeof(struct mmsghdr));
+    for(i = 0; i < N_tx; i++){
+        TxFrames[i].can_id = Tx[i].id;
+        TxFrames[i].len = Tx[i].len;
+        TxIov[i].iov_base = &TxFrames[i];
+        TxIov[i].iov_len = sizeof(struct can_frame);
+        TxMsgs[i].msg_hdr.msg_iov = &TxIov[i];
+        TxMsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    for(i = 0; i < CAN_BATCH; i++){
+        RxIov[i].iov_base = &RxFrames[i];
+        RxIov[i].iov_len = sizeof(struct can_frame);
+        RxMsgs[i].msg_hdr.msg_iov = &RxIov[i];
+        RxMsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    Can.label = get_string_entry(HW_LABEL, hw);
+
+    return PLC_OK;
+}
+
+int can_enable() /* Enable bus communication */
+{
+    struct sockaddr_can addr;
+    struct can_filter filter[N_rx + 1];
+    unsigned int i = 0;
+    if(Sock >= 0){ //already open
+
+        return PLC_OK;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = if_nametoindex(Bus);
+    if(addr.can_ifindex == 0){
+        plc_log("No can interface %s", Bus);
+
+        return PLC_ERR;
+    }
+    Sock = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+    if(Sock < 0){
+        plc_log("Failed to open a can socket: %s", strerror(errno));
+
+        return PLC_ERR;
+    }
+    //the kernel drops every frame that is not mapped
+    for(; i < N_rx; i++){
+        filter[i].can_id = Rx[i].id;
+        filter[i].can_mask = CAN_EFF_FLAG | CAN_RTR_FLAG
+                           | (Rx[i].id & CAN_EFF_FLAG ?
+                              CAN_EFF_MASK : CAN_SFF_MASK);
+    }
+    if(setsockopt(Sock, SOL_CAN_RAW, CAN_RAW_FILTER,
+                  N_rx ? filter : NULL, N_rx * sizeof(struct can_filter)) < 0
+    || bind(Sock, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+        plc_log("Failed to bind to %s: %s", Bus, strerror(errno));
+        close(Sock);
+        Sock = PLC_ERR;
+
+        return PLC_ERR;
+    }
+    memset(CanIn, 0, sizeof(CanIn));
+    memset(CanOut, 0, sizeof(CanOut));
+    //every frame gets one timeout to show up
+    for(i = 0; i < N_rx; i++){
+        msecs_from_now(Rx[i].timeout, &Rx[i].due);
+        Rx[i].fresh = TRUE;
+    }
+    Can.status = PLC_OK;
+    plc_log("Opened %s, %d frames in, %d frames out", Bus, N_rx, N_tx);
+
+    return PLC_OK;
+}
+
+int can_disable() /* Disable bus communication */
+{
+    if(Sock >= 0){
+        close(Sock);
+        Sock = PLC_ERR;
+        plc_log("Closed %s", Bus);
+    }
+    //a restart starts over with fresh timeouts
+    Can.status = PLC_OK;
+
+    return PLC_OK;
+}
+
+/**
+ * @brief copy a received frame to the image, if it is mapped
+ * @param the frame
+ */
+static void receive(const struct can_frame * frame)
+{
+    struct can_pdo key;
+    can_pdo_t f = NULL;
+    if(frame->can_id & (CAN_ERR_FLAG | CAN_RTR_FLAG)){
+
+        return;
+    }
+    key.id = frame->can_id;
+    f = (can_pdo_t)bsearch(&key, Rx, N_rx, sizeof(struct can_pdo),
+                           compare_ids);
+    if(f == NULL){
+
+        return;
+    }
+    //a short frame only updates the bytes it carries
+    memcpy(CanIn + f->first, frame->data,
+           frame->len < f->len ? frame->len : f->len);
+    msecs_from_now(f->timeout, &f->due);
+}
+
+/**
+ * @brief check every received frame against its timeout
+ * @return OK, or ERR_HARDWARE if any of them is late
+ */
+static int check_timeouts()
+{
+    int r = PLC_OK;
+    unsigned int i = 0;
+    for(; i < N_rx; i++){
+        can_pdo_t f = &Rx[i];
+        BYTE fresh = f->timeout <= 0 || msecs_until(&f->due) >= 0;
+        if(f->fresh && !fresh){
+            plc_log("Can frame %x timed out", f->id & CAN_EFF_MASK);
+        } else if(!f->fresh && fresh){
+            plc_log("Can frame %x is back", f->id & CAN_EFF_MASK);
+        }
+        f->fresh = fresh;
+        if(!fresh){
+            r = ERR_HARDWARE;
+        }
+    }
+    return r;
+}
+
+int can_fetch()
+{
+    int n = 0;
+    int i = 0;
+    if(Sock < 0){
+
+        return PLC_ERR;
+    }
+    //drain everything pending, a full batch means there may be more
+    do{
+        n = recvmmsg(Sock, RxMsgs, CAN_BATCH, MSG_DONTWAIT, NULL);
+        for(i = 0; i < n; i++){
+            if(RxMsgs[i].msg_len == sizeof(struct can_frame)){
+                receive(&RxFrames[i]);
+            }
+        }
+    }while(n == CAN_BATCH);
+    if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK){
+        Can.status = ERR_HARDWARE;
+
+        return ERR_HARDWARE;
+    }
+    Can.status = check_timeouts();
+
+    return Can.status;
+}
+
+int can_flush()
+{
+    unsigned int i = 0;
+    unsigned int sent = 0;
+    if(Sock < 0){
+
+        return PLC_ERR;
+    }
+    for(; i < N_tx; i++){
+        memcpy(TxFrames[i].data, CanOut + Tx[i].first, Tx[i].len);
+    }
+    //every frame, every cycle, in one go unless the queue is full;
+    //then the frames it did not take go first next cycle
+    while(sent < N_tx){
+        unsigned int f = (TxFirst + sent) % N_tx;
+        unsigned int len = f < TxFirst ? TxFirst - f : N_tx - f;
+        int n = sendmmsg(Sock, TxMsgs + f, len, MSG_DONTWAIT);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n < 0
+        && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)){
+            TxFirst = f;
+
+            return PLC_OK;
+        }
+        if(n <= 0){
+
+            return ERR_HARDWARE;
+        }
+        sent += n;
+    }
+    return PLC_OK;
+}
+
+void can_dio_read(unsigned int n, BYTE* bit)
+{	//write input n to bit
+    *bit = n / BYTESIZE < InSize ? (CanIn[n / BYTESIZE] >> n % BYTESIZE) % 2
+                                 : 0;
+}
+
+void can_dio_write(const unsigned char *buf, unsigned int n,  BYTE bit)
+{	//write bit to n output
+    if(n / BYTESIZE < OutSize){
+        if(bit){
+            CanOut[n / BYTESIZE] |= 1 << n % BYTESIZE;
+        } else {
+            CanOut[n / BYTESIZE] &= ~(1 << n % BYTESIZE);
+        }
+    }
+}
+
+void can_dio_bitfield(const BYTE* mask, BYTE *bits)
+{	//simultaneusly write output bits defined by mask and read all inputs
+    /* FIXME */
+}
+
+void can_data_read(unsigned int index, uint64_t* value)
+{ //frames only carry digital bytes
+    *value = 0;
+}
+
+void can_data_write(unsigned int index, uint64_t value)
+{
+}
+
+struct hardware Can = {
+    HW_CAN,
+    0, //errorcode
+    "socketcan",
+    can_enable,// enable
+    can_disable, //disable
+    can_fetch, //fetch
+    can_flush, //flush
+    can_dio_read, //dio_read
+    can_dio_write, //dio_write
+    can_dio_bitfield, //dio_bitfield
+    can_data_read, //data_read
+    can_data_write, //data_write
+    can_config, //hw_config
+};
@@ -0,0 +1,142 @@
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+
+#include "util.h"
+
+#include "config.h"
+#include "schema.h"
+#include "hardware.h"
+
+typedef enum{
+    DRY_CONSTANT,
+    DRY_COUNTER,
+    DRY_RANDOM,
+    N_DRY_PATTERNS
+}DRY_PATTERNS;
+
+static const char * DryPatterns[N_DRY_PATTERNS] = {
+    "CONSTANT",
+    "COUNTER",
+    "RANDOM"
+};
+
+//inputs are generated in memory, outputs go nowhere
+static int Pattern = DRY_CONSTANT;
+static uint64_t Value = 0;
+static uint64_t Generated = 0;
+
+static unsigned int Dry_ni = 0;
+static unsigned int Dry_nai = 0;
+
+struct hardware Dry;
+
+int dry_config(const config_t conf)
+{
+    config_t hw = get_recursive_entry(CONFIG_HW, conf);
+    config_t ifc = get_recursive_entry(HW_IFACE, hw);
+    config_t dry = get_recursive_entry(IFACE_DRY, ifc);
+    char * pattern = get_string_entry(DRY_PATTERN, dry);
+    int value = get_numeric_entry(DRY_VALUE, dry);
+    int i = 0;
+
+    Pattern = PLC_ERR;
+    for(; pattern && i < N_DRY_PATTERNS; i++){
+        if(!strcmp(pattern, DryPatterns[i])){
+            Pattern = i;
+        }
+    }
+    if(Pattern == PLC_ERR){
+        plc_log("Invalid dry pattern %s", pattern ? pattern : "");
+
+        return PLC_ERR;
+    }
+    Value = value > 0 ? value : 0;
+
+    sequence_t s = get_sequence_entry(CONFIG_DI, conf);
+    Dry_ni = s ? s->size / BYTESIZE + 1 : 0;
+    s = get_sequence_entry(CONFIG_AI, conf);
+    Dry_nai = s ? s->size : 0;
+
+    Dry.label = get_string_entry(HW_LABEL, hw);
+
+    return PLC_OK;
+}
+
+int dry_enable() /* Enable bus communication */
+{
+    //xorshift can not leave zero
+    Generated = (Pattern == DRY_RANDOM && Value == 0) ? 1 : Value;
+
+    return PLC_OK;
+}
+
+int dry_disable() /* Disable bus communication */
+{
+    return PLC_OK;
+}
+
+int dry_fetch()
+{
+    switch(Pattern){
+        case DRY_COUNTER:
+            Generated++;
+            break;
+        case DRY_RANDOM: //xorshift64
+            Generated ^= Generated << 13;
+            Generated ^= Generated >> 7;
+            Generated ^= Generated << 17;
+            break;
+        default: break;
+    }
+    return PLC_OK;
+}
+
+int dry_flush()
+{
+    return PLC_OK;
+}
+
+void dry_dio_read(unsigned int n, BYTE* bit)
+{	//every input byte is a byte of the generated word
+    unsigned int position = n / BYTESIZE;
+    BYTE i = 0;
+    if(position < Dry_ni){
+        i = (Generated >> (BYTESIZE * (position % LONG_BYTES))) % 0x100;
+    }
+    *bit = (i >> n % BYTESIZE) % 2;
+}
+
+void dry_dio_write(const unsigned char *buf, unsigned int n,  BYTE bit)
+{
+}
+
+void dry_dio_bitfield(const BYTE* mask, BYTE *bits)
+{
+}
+
+void dry_data_read(unsigned int index, uint64_t* value)
+{
+    *value = index < Dry_nai ? Generated : 0;
+}
+
+void dry_data_write(unsigned int index, uint64_t value)
+{
+}
+
+struct hardware Dry = {
+    HW_DRY,
+    0, //errorcode
+    "dry run",
+    dry_enable,// enable
+    dry_disable, //disable
+    dry_fetch, //fetch
+    dry_flush, //flush
+    dry_dio_read, //dio_read
+    dry_dio_write, //dio_write
+    dry_dio_bitfield, //dio_bitfield
+    dry_data_read, //data_read
+    dry_data_write, //data_write
+    dry_config, //hw_config
+};
+
@@ -0,0 +1,306 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+
+#include "util.h"
+
+#include "config.h"
+#include "schema.h"
+#include "hardware.h"
+
+#define GPIO_CONSUMER "plcemu"
+#define GPIO_EVENTS 16 //edge events drained per read()
+
+typedef enum{
+    GPIO_EDGE_NONE,
+    GPIO_EDGE_RISING,
+    GPIO_EDGE_FALLING,
+    GPIO_EDGE_BOTH,
+    N_GPIO_EDGES
+}GPIO_EDGES;
+
+static const char * GpioEdges[N_GPIO_EDGES] = {
+    "NONE",
+    "RISING",
+    "FALLING",
+    "BOTH"
+};
+
+static char * GpioChip = NULL;
+static int Edges = GPIO_EDGE_NONE;
+
+//one line request per bank, bit i of a bank is line offsets[i]
+static struct gpio_v2_line_request InReq;
+static struct gpio_v2_line_request OutReq;
+
+static uint64_t InBits = 0;
+static uint64_t OutBits = 0;
+static uint64_t Flushed = 0;
+
+struct hardware Gpio;
+
+/**
+ * @brief parse a list of line offsets, like "0 1 2 17"
+ * @param the list
+ * @param the request to fill in
+ * @return number of lines or PLC_ERR
+ */
+static int parse_lines(const char * list, struct gpio_v2_line_request * req)
+{
+    char * end = NULL;
+    const char * it = list;
+    req->num_lines = 0;
+    while(it && *it){
+        long offset = strtol(it, &end, 10);
+        if(end == it){
+            it++; //separator
+            continue;
+        }
+        if(offset < 0 || req->num_lines >= GPIO_V2_LINES_MAX){
+
+            return PLC_ERR;
+        }
+        req->offsets[req->num_lines++] = (uint32_t)offset;
+        it = end;
+    }
+    return req->num_lines;
+}
+
+static int request_lines(int chip, struct gpio_v2_line_request * req)
+{
+    if(req->num_lines == 0){
+        req->fd = PLC_ERR;
+
+        return PLC_OK;
+    }
+    sprintf(req->consumer, "%s", GPIO_CONSUMER);
+    if(ioctl(chip, GPIO_V2_GET_LINE_IOCTL, req) < 0){
+        req->fd = PLC_ERR;
+        plc_log("Failed to request %d lines from %s: %s",
+                req->num_lines, GpioChip, strerror(errno));
+
+        return PLC_ERR;
+    }
+    return PLC_OK;
+}
+
+static void release_lines(struct gpio_v2_line_request * req)
+{
+    if(req->fd >= 0){
+        close(req->fd);
+    }
+    req->fd = PLC_ERR;
+}
+
+int gpio_config(const config_t conf)
+{
+    config_t hw = get_recursive_entry(CONFIG_HW, conf);
+    config_t ifc = get_recursive_entry(HW_IFACE, hw);
+    config_t gpio = get_recursive_entry(IFACE_GPIO, ifc);
+    char * edges = get_string_entry(GPIO_EDGE, gpio);
+    int i = 0;
+
+    GpioChip = get_string_entry(GPIO_CHIP, gpio);
+    memset(&InReq, 0, sizeof(InReq));
+    memset(&OutReq, 0, sizeof(OutReq));
+    if(parse_lines(get_string_entry(GPIO_INPUTS, gpio), &InReq) < 0
+    || parse_lines(get_string_entry(GPIO_OUTPUTS, gpio), &OutReq) < 0){
+        plc_log("Invalid gpio lines, at most %d per bank", GPIO_V2_LINES_MAX);
+
+        return PLC_ERR;
+    }
+    Edges = PLC_ERR;
+    for(; edges && i < N_GPIO_EDGES; i++){
+        if(!strcmp(edges, GpioEdges[i])){
+            Edges = i;
+        }
+    }
+    if(Edges == PLC_ERR){
+        plc_log("Invalid gpio edge %s", edges ? edges : "");
+
+        return PLC_ERR;
+    }
+    InReq.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+    if(Edges == GPIO_EDGE_RISING || Edges == GPIO_EDGE_BOTH){
+        InReq.config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+    }
+    if(Edges == GPIO_EDGE_FALLING || Edges == GPIO_EDGE_BOTH){
+        InReq.config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    }
+    OutReq.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    InReq.fd = PLC_ERR;
+    OutReq.fd = PLC_ERR;
+
+    Gpio.label = get_string_entry(HW_LABEL, hw);
+
+    return PLC_OK;
+}
+
+int gpio_enable() /* Enable bus communication */
+{
+    int r = PLC_OK;
+    if(InReq.fd >= 0 || OutReq.fd >= 0){ //already requested
+
+        return PLC_OK;
+    }
+    int chip = open(GpioChip, O_RDWR | O_CLOEXEC);
+    if(chip < 0){
+        plc_log("Failed to open %s", GpioChip);
+
+        return PLC_ERR;
+    }
+    if(request_lines(chip, &InReq) < 0
+    || request_lines(chip, &OutReq) < 0){
+        //all or nothing, so that a retry requests both again
+        release_lines(&InReq);
+        release_lines(&OutReq);
+        r = PLC_ERR;
+    }
+    //the line requests keep their own fds
+    close(chip);
+    if(InReq.fd >= 0 && Edges != GPIO_EDGE_NONE){
+    //events are only drained, never waited for
+        fcntl(InReq.fd, F_SETFL, fcntl(InReq.fd, F_GETFL) | O_NONBLOCK);
+    }
+    InBits = 0;
+    OutBits = 0;
+    Flushed = ~0ULL; //force the first write
+    if(r == PLC_OK){
+        plc_log("Opened %s, %d inputs, %d outputs",
+                GpioChip, InReq.num_lines, OutReq.num_lines);
+    }
+    return r;
+}
+
+int gpio_disable() /* Disable bus communication */
+{
+    release_lines(&InReq);
+    release_lines(&OutReq);
+    plc_log("Closed %s", GpioChip);
+
+    return PLC_OK;
+}
+
+/**
+ * @brief catch pulses shorter than a cycle from the edge events:
+ * a line that rose since the last fetch reads 1 once, 
+ * or 0 if only falling edges are watched and it fell
+ * @param the sampled values
+ * @return the values with the caught pulses
+ */
+static uint64_t catch_edges(uint64_t values)
+{
+    struct gpio_v2_line_event ev[GPIO_EVENTS];
+    uint64_t rose = 0;
+    uint64_t fell = 0;
+    ssize_t n = 0;
+    while((n = read(InReq.fd, ev, sizeof(ev))) > 0){
+        int e = 0;
+        for(; e < n / sizeof(struct gpio_v2_line_event); e++){
+            uint32_t i = 0;
+            for(; i < InReq.num_lines; i++){
+                if(InReq.offsets[i] == ev[e].offset){
+                    if(ev[e].id == GPIO_V2_LINE_EVENT_RISING_EDGE){
+                        rose |= 1ULL << i;
+                    } else {
+                        fell |= 1ULL << i;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    return Edges == GPIO_EDGE_FALLING ? values & ~fell : values | rose;
+}
+
+int gpio_fetch()
+{
+    struct gpio_v2_line_values val;
+    if(InReq.fd < 0){
+
+        return PLC_OK;
+    }
+    val.mask = InReq.num_lines < GPIO_V2_LINES_MAX ?
+               (1ULL << InReq.num_lines) - 1 : ~0ULL;
+    val.bits = 0;
+    //the whole bank in one syscall
+    if(ioctl(InReq.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &val) < 0){
+
+        return PLC_ERR;
+    }
+    InBits = Edges == GPIO_EDGE_NONE ? val.bits : catch_edges(val.bits);
+
+    return PLC_OK;
+}
+
+int gpio_flush()
+{
+    struct gpio_v2_line_values val;
+    if(OutReq.fd < 0 || OutBits == Flushed){
+
+        return PLC_OK;
+    }
+    val.mask = OutReq.num_lines < GPIO_V2_LINES_MAX ?
+               (1ULL << OutReq.num_lines) - 1 : ~0ULL;
+    val.bits = OutBits;
+    if(ioctl(OutReq.fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &val) < 0){
+
+        return PLC_ERR;
+    }
+    Flushed = OutBits;
+
+    return PLC_OK;
+}
+
+void gpio_dio_read(unsigned int n, BYTE* bit)
+{	//write input n to bit
+    *bit = n < InReq.num_lines ? (InBits >> n) % 2 : 0;
+}
+
+void gpio_dio_write(const unsigned char *buf, unsigned int n,  BYTE bit)
+{	//write bit to n output
+    if(n < OutReq.num_lines){
+        if(bit){
+            OutBits |= 1ULL << n;
+        } else {
+            OutBits &= ~(1ULL << n);
+        }
+    }
+}
+
+void gpio_dio_bitfield(const BYTE* mask, BYTE *bits)
+{	//simultaneusly write output bits defined by mask and read all inputs
+    /* FIXME */
+}
+
+void gpio_data_read(unsigned int index, uint64_t* value)
+{ //no analog lines on a gpio chip
+    *value = 0;
+}
+
+void gpio_data_write(unsigned int index, uint64_t value)
+{
+}
+
+struct hardware Gpio = {
+    HW_GPIO,
+    0, //errorcode
+    "gpio chardev",
+    gpio_enable,// enable
+    gpio_disable, //disable
+    gpio_fetch, //fetch
+    gpio_flush, //flush
+    gpio_dio_read, //dio_read
+    gpio_dio_write, //dio_write
+    gpio_dio_bitfield, //dio_bitfield
+    gpio_data_read, //data_read
+    gpio_data_write, //data_write
+    gpio_config, //hw_config
+};
+
@@ -0,0 +1,777 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+
+#include "util.h"
+
+#include "config.h"
+#include "schema.h"
+#include "hardware.h"
+#include "plclib.h"
+#include "modbus.h"
+#include "uring.h"
+
+#define MBC_REQUESTS 32 //outstanding requests per device
+#define MBC_OUTBUF (MBC_REQUESTS * MB_ADU)
+#define MBC_MAX_BITS (4 * MB_MAX_WRITE_BITS) //per device and bank
+#define MBC_MAX_REGS (4 * MB_MAX_WRITE_REGS)
+
+typedef enum{
+    MBC_DISCONNECTED,
+    MBC_CONNECTING,
+    MBC_CONNECTED
+}MBC_STATES;
+
+typedef enum{
+    MBC_DI,
+    MBC_DQ,
+    MBC_AI,
+    MBC_AQ,
+    N_MBC_BANKS
+}MBC_BANKS;
+
+static const char * MbcBanks[N_MBC_BANKS] = {
+    "DI",
+    "DQ",
+    "AI",
+    "AQ"
+};
+
+/**
+ * @brief a contiguous range of a device, mapped to the plc image
+ */
+struct mbc_range{
+    unsigned int address; ///first coil, input or register on the device
+    unsigned int count;
+    unsigned int offset; ///first bit or channel in the plc image
+};
+
+/**
+ * @brief a request in flight, matched to its response by transaction id
+ */
+struct mbc_request{
+    unsigned short tid;
+    BYTE function;
+    unsigned int count;
+    unsigned int offset;
+};
+
+typedef struct mbc_device{
+    char * id; ///host:port
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    BYTE unit;
+    struct mbc_range bank[N_MBC_BANKS];
+
+    int fd;
+    int state;
+    unsigned short tid;
+    struct mbc_request pending[MBC_REQUESTS];
+    unsigned int n_pending;
+    unsigned int in_len;
+    unsigned int out_len;
+    unsigned int out_sent;
+    BYTE in[MB_ADU];
+    BYTE out[MBC_OUTBUF];
+} * mbc_device_t;
+
+static mbc_device_t Devices = NULL;
+static unsigned int N_devices = 0;
+static int Timeout = 0;
+static uring_t Ring = NULL; //one send per device in flight
+
+//the plc image, all devices' ranges back to back
+static BYTE * MbcIn = NULL;
+static BYTE * MbcOut = NULL;
+static uint64_t * MbcAdcIn = NULL;
+static uint64_t * MbcAdcOut = NULL;
+static unsigned int Size[N_MBC_BANKS];
+
+struct hardware Mbc;
+
+static long msecs_until(const struct timespec * t)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (t->tv_sec - now.tv_sec) * THOUSAND
+         + (t->tv_nsec - now.tv_nsec) / (THOUSAND * THOUSAND);
+}
+
+static void msecs_from_now(long msecs, struct timespec * t)
+{
+    clock_gettime(CLOCK_MONOTONIC, t);
+    t->tv_sec += msecs / THOUSAND;
+    t->tv_nsec += (msecs % THOUSAND) * THOUSAND * THOUSAND;
+    if(t->tv_nsec >= THOUSAND * THOUSAND * THOUSAND){
+        t->tv_sec++;
+        t->tv_nsec -= THOUSAND * THOUSAND * THOUSAND;
+    }
+}
+
+static int get_bit(const BYTE * bits, unsigned int n)
+{
+    return (bits[n / BYTESIZE] >> n % BYTESIZE) % 2;
+}
+
+static void set_bit(BYTE * bits, unsigned int n, int bit)
+{
+    if(bit){
+        bits[n / BYTESIZE] |= 1 << n % BYTESIZE;
+    } else {
+        bits[n / BYTESIZE] &= ~(1 << n % BYTESIZE);
+    }
+}
+
+/**
+ * @brief resolve a device id, like "10.0.0.7:502"
+ * @return OK or ERROR
+ */
+static int resolve_id(mbc_device_t d)
+{
+    struct addrinfo hints;
+    struct addrinfo * res = NULL;
+    char host[MEDSTR];
+    const char * port = "502";
+    char * colon = NULL;
+    snprintf(host, MEDSTR, "%s", d->id);
+    colon = strrchr(host, ':');
+    if(colon){
+        *colon = 0;
+        port = colon + 1;
+    }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host, port, &hints, &res) != 0 || res == NULL){
+
+        return PLC_ERR;
+    }
+    memcpy(&d->addr, res->ai_addr, res->ai_addrlen);
+    d->addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    return PLC_OK;
+}
+
+/**
+ * @brief parse a range like "100 16", address and count
+ * @return OK or ERROR
+ */
+static int parse_range(const char * val, unsigned int max, struct mbc_range * r)
+{
+    char * end = NULL;
+    r->address = 0;
+    r->count = 0;
+    if(val == NULL){ //bank not used on this device
+
+        return PLC_OK;
+    }
+    long address = strtol(val, &end, 10);
+    long count = strtol(end, &end, 10);
+    if(address < 0
+    || count < 0
+    || count > max
+    || address + count > 0x10000){
+
+        return PLC_ERR;
+    }
+    r->address = address;
+    r->count = count;
+
+    return PLC_OK;
+}
+
+static void drop(mbc_device_t d)
+{
+    if(d->fd >= 0){
+        close(d->fd);
+    }
+    if(d->state != MBC_DISCONNECTED){
+        plc_log("Lost modbus device %s", d->id);
+    }
+    d->fd = PLC_ERR;
+    d->state = MBC_DISCONNECTED;
+    d->n_pending = 0;
+    d->in_len = 0;
+    d->out_len = 0;
+    d->out_sent = 0;
+}
+
+static void start_connect(mbc_device_t d)
+{
+    int on = 1;
+    d->fd = socket(d->addr.ss_family,
+                   SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                   0);
+    if(d->fd < 0){
+        drop(d);
+
+        return;
+    }
+    setsockopt(d->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if(connect(d->fd, (struct sockaddr *)&d->addr, d->addr_len) == 0){
+        d->state = MBC_CONNECTED;
+    } else if(errno == EINPROGRESS){
+        d->state = MBC_CONNECTING;
+    } else {
+        close(d->fd);
+        d->fd = PLC_ERR;
+    }
+}
+
+static void finish_connect(mbc_device_t d)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if(getsockopt(d->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err){
+        close(d->fd);
+        d->fd = PLC_ERR;
+        d->state = MBC_DISCONNECTED;
+
+        return;
+    }
+    d->state = MBC_CONNECTED;
+    plc_log("Connected modbus device %s", d->id);
+}
+
+/**
+ * @brief append a request to the device's output buffer
+ * @param the device
+ * @param function code
+ * @param the range, or a chunk of it
+ * @return OK or ERROR if too many requests are in flight
+ */
+static int request(mbc_device_t d, BYTE function, const struct mbc_range * r)
+{
+    BYTE * f = d->out + d->out_len;
+    unsigned int len = 5; //function, address, quantity
+    unsigned int i = 0;
+    if(d->n_pending == MBC_REQUESTS
+    || d->out_len + MB_ADU > MBC_OUTBUF){
+
+        return PLC_ERR;
+    }
+    d->tid++;
+    mb_put16(f, d->tid);
+    mb_put16(f + 2, 0);
+    f[6] = d->unit;
+    f[7] = function;
+    mb_put16(f + 8, r->address);
+    mb_put16(f + 10, r->count);
+    if(function == MB_WRITE_COILS){
+        f[12] = (r->count + BYTESIZE - 1) / BYTESIZE;
+        memset(f + 13, 0, f[12]);
+        for(; i < r->count; i++){
+            if(get_bit(MbcOut, r->offset + i)){
+                f[13 + i / BYTESIZE] |= 1 << i % BYTESIZE;
+            }
+        }
+        len += 1 + f[12];
+    } else if(function == MB_WRITE_REGISTERS){
+        f[12] = 2 * r->count;
+        for(; i < r->count; i++){
+            mb_put16(f + 13 + 2 * i, MbcAdcOut[r->offset + i]);
+        }
+        len += 1 + f[12];
+    }
+    mb_put16(f + 4, len + 1);
+    d->out_len += MB_MBAP + len;
+
+    d->pending[d->n_pending].tid = d->tid;
+    d->pending[d->n_pending].function = function;
+    d->pending[d->n_pending].count = r->count;
+    d->pending[d->n_pending].offset = r->offset;
+    d->n_pending++;
+
+    return PLC_OK;
+}
+
+/**
+ * @brief request a whole bank, in chunks the protocol allows
+ */
+static int request_bank(mbc_device_t d, BYTE function, int bank, unsigned int max)
+{
+    struct mbc_range chunk = d->bank[bank];
+    while(chunk.count > 0){
+        struct mbc_range r = chunk;
+        r.count = chunk.count < max ? chunk.count : max;
+        if(request(d, function, &r) < 0){
+
+            return PLC_ERR;
+        }
+        chunk.address += r.count;
+        chunk.offset += r.count;
+        chunk.count -= r.count;
+    }
+    return PLC_OK;
+}
+
+static int transmit(mbc_device_t d)
+{
+    while(d->out_sent < d->out_len){
+        ssize_t n = send(d->fd,
+                         d->out + d->out_sent,
+                         d->out_len - d->out_sent,
+                         MSG_NOSIGNAL);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? PLC_OK : PLC_ERR;
+        }
+        d->out_sent += n;
+    }
+    d->out_len = 0;
+    d->out_sent = 0;
+
+    return PLC_OK;
+}
+
+/**
+ * @brief send what every connected device has queued, with one submit.
+ * Whatever a socket does not take now goes out when collect() 
+ * finds it writable
+ * @return OK or ERR_HARDWARE if a device failed
+ */
+static int transmit_all()
+{
+    unsigned int i = 0;
+    unsigned int n = 0;
+    unsigned long tag = 0;
+    int res = 0;
+    int r = PLC_OK;
+    for(; i < N_devices; i++){
+        mbc_device_t d = &Devices[i];
+        if(d->state != MBC_CONNECTED || d->out_sent == d->out_len){
+            continue;
+        }
+        if(uring_send(Ring, d->fd,
+                      d->out + d->out_sent,
+                      d->out_len - d->out_sent,
+                      i) == PLC_OK){
+            n++;
+        } else if(transmit(d) < 0){ //no ring
+            drop(d);
+            r = ERR_HARDWARE;
+        }
+    }
+    //sends never wait, so all of them complete on submit
+    if(n > 0 && uring_submit(Ring, n) < 0){
+        //nothing was sent, start over with a new ring
+        clear_uring(Ring);
+        Ring = new_uring(N_devices + 1);
+        for(i = 0; i < N_devices; i++){
+            mbc_device_t d = &Devices[i];
+            if(d->state == MBC_CONNECTED && transmit(d) < 0){
+                drop(d);
+                r = ERR_HARDWARE;
+            }
+        }
+        return r;
+    }
+    while(uring_reap(Ring, &tag, &res)){
+        mbc_device_t d = &Devices[tag];
+        if(res >= 0){
+            d->out_sent += res;
+            if(d->out_sent == d->out_len){
+                d->out_len = 0;
+                d->out_sent = 0;
+            }
+        } else if(res != -EAGAIN && res != -EWOULDBLOCK && res != -EINTR){
+            drop(d);
+            r = ERR_HARDWARE;
+        }
+    }
+    return r;
+}
+
+/**
+ * @brief store a response in the plc image and retire its request
+ * @return OK or ERROR if the stream can not be trusted any more
+ */
+static int response(mbc_device_t d, const BYTE * f, unsigned int len)
+{
+    unsigned int tid = mb_get16(f);
+    const BYTE * pdu = f + MB_MBAP;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    for(; i < d->n_pending && d->pending[i].tid != tid; i++);
+    if(i == d->n_pending){
+
+        return PLC_ERR;
+    }
+    struct mbc_request * q = &d->pending[i];
+    if(pdu[0] == (q->function | 0x80)){
+        plc_log("Modbus device %s exception %d on function %d",
+                d->id, len > 1 ? pdu[1] : 0, q->function);
+    } else if(pdu[0] != q->function){
+
+        return PLC_ERR;
+    } else if(q->function == MB_READ_DISCRETE){
+        if(len < 2 + (q->count + BYTESIZE - 1) / BYTESIZE){
+
+            return PLC_ERR;
+        }
+        for(; j < q->count; j++){
+            set_bit(MbcIn, q->offset + j, get_bit(pdu + 2, j));
+        }
+    } else if(q->function == MB_READ_INPUT){
+        if(len < 2 + 2 * q->count){
+
+            return PLC_ERR;
+        }
+        for(; j < q->count; j++){
+            MbcAdcIn[q->offset + j] = mb_get16(pdu + 2 + 2 * j);
+        }
+    }
+    //responses mostly come in order, keep the rest in order too
+    d->n_pending--;
+    memmove(q, q + 1, (d->n_pending - i) * sizeof(struct mbc_request));
+
+    return PLC_OK;
+}
+
+static int receive(mbc_device_t d)
+{
+    for(;;){
+        ssize_t n = recv(d->fd, d->in + d->in_len, MB_ADU - d->in_len, 0);
+        if(n == 0){
+
+            return PLC_ERR;
+        }
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? PLC_OK : PLC_ERR;
+        }
+        d->in_len += n;
+        while(d->in_len >= MB_MBAP){
+            unsigned int len = mb_get16(d->in + 4);
+            if(len < 2 || len > MB_ADU - MB_MBAP + 1){
+
+                return PLC_ERR;
+            }
+            unsigned int size = MB_MBAP - 1 + len;
+            if(d->in_len < size){
+                break;
+            }
+            if(response(d, d->in, len - 1) < 0){
+
+                return PLC_ERR;
+            }
+            d->in_len -= size;
+            memmove(d->in, d->in + size, d->in_len);
+        }
+    }
+}
+
+/**
+ * @brief wait for every connected device to answer everything in flight,
+ * all devices in parallel, until the timeout
+ * @return OK or ERR_HARDWARE if any device is not connected,
+ * timed out or failed
+ */
+static int collect()
+{
+    struct pollfd fds[N_devices];
+    struct timespec deadline;
+    unsigned int i = 0;
+    int r = PLC_OK;
+    long wait = 0;
+    msecs_from_now(Timeout, &deadline);
+    do{
+        int n = 0;
+        int busy = FALSE;
+        for(i = 0; i < N_devices; i++){
+            mbc_device_t d = &Devices[i];
+            fds[i].fd = -1; //ignored by poll
+            fds[i].events = 0;
+            fds[i].revents = 0;
+            if(d->state == MBC_CONNECTING){
+                fds[i].fd = d->fd;
+                fds[i].events = POLLOUT;
+            } else if(d->state == MBC_CONNECTED
+                   && (d->n_pending > 0 || d->out_len > 0)){
+                fds[i].fd = d->fd;
+                fds[i].events = POLLIN | (d->out_len > 0 ? POLLOUT : 0);
+                busy = TRUE;
+            }
+        }
+        //devices still connecting are only checked, never waited for
+        wait = busy ? msecs_until(&deadline) : 0;
+        if(wait < 0){
+            break;
+        }
+        n = poll(fds, N_devices, wait);
+        if(n < 0 && errno != EINTR){
+            break;
+        }
+        for(i = 0; n > 0 && i < N_devices; i++){
+            mbc_device_t d = &Devices[i];
+            if(fds[i].revents == 0){
+                continue;
+            }
+            if(d->state == MBC_CONNECTING){
+                finish_connect(d);
+            } else if(fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)
+                   || ((fds[i].revents & POLLOUT) && transmit(d) < 0)
+                   || ((fds[i].revents & POLLIN) && receive(d) < 0)){
+                drop(d);
+                r = ERR_HARDWARE;
+            }
+        }
+        if(!busy){
+            break;
+        }
+    }while(TRUE);
+
+    for(i = 0; i < N_devices; i++){
+        mbc_device_t d = &Devices[i];
+        if(d->state == MBC_CONNECTED
+        && (d->n_pending > 0 || d->out_len > 0)){
+            plc_log("Modbus device %s timed out", d->id);
+            //late responses would be mistaken for the next cycle's
+            drop(d);
+        }
+        if(d->state != MBC_CONNECTED){
+            r = ERR_HARDWARE;
+        }
+    }
+    return r;
+}
+
+int mbc_config(const config_t conf)
+{
+    config_t hw = get_recursive_entry(CONFIG_HW, conf);
+    config_t ifc = get_recursive_entry(HW_IFACE, hw);
+    config_t mbc = get_recursive_entry(IFACE_MODBUS, ifc);
+    sequence_t devices = get_sequence_entry(MBC_DEVICES, mbc);
+    unsigned int i = 0;
+    int b = 0;
+
+    Timeout = get_numeric_entry(MBC_TIMEOUT, mbc);
+    if(Timeout <= 0){
+        plc_log("Invalid modbus timeout");
+
+        return PLC_ERR;
+    }
+    free(Devices);
+    Devices = NULL;
+    N_devices = 0;
+    memset(Size, 0, sizeof(Size));
+    if(devices){
+        Devices = (mbc_device_t)calloc(devices->size + 1,
+                                       sizeof(struct mbc_device));
+    }
+    for(; devices && i < devices->size; i++){
+        variable_t v = &devices->vars[i];
+        mbc_device_t d = &Devices[N_devices];
+        char * unit = NULL;
+        if(v->name == NULL || v->name[0] == 0){ //unused slot
+            continue;
+        }
+        d->id = v->name;
+        d->fd = PLC_ERR;
+        unit = get_param_val("UNIT", v->params);
+        d->unit = unit ? atoi(unit) : 1;
+        for(b = 0; b < N_MBC_BANKS; b++){
+            unsigned int max = b == MBC_AI || b == MBC_AQ ?
+                               MBC_MAX_REGS : MBC_MAX_BITS;
+            if(parse_range(get_param_val(MbcBanks[b], v->params),
+                           max,
+                           &d->bank[b]) < 0){
+                plc_log("Invalid %s range of modbus device %s",
+                        MbcBanks[b], d->id);
+
+                return PLC_ERR;
+            }
+            d->bank[b].offset = Size[b];
+            Size[b] += d->bank[b].count;
+        }
+        if(resolve_id(d) < 0){
+            plc_log("Could not resolve modbus device %s", d->id);
+
+            return PLC_ERR;
+        }
+        N_devices++;
+    }
+    if(N_devices == 0){
+        plc_log("No modbus devices");
+
+        return PLC_ERR;
+    }
+    Mbc.label = get_string_entry(HW_LABEL, hw);
+
+    return PLC_OK;
+}
+
+int mbc_enable() /* Enable bus communication */
+{
+    unsigned int i = 0;
+    if(MbcIn){ //already enabled
+
+        return PLC_OK;
+    }
+    MbcIn = (BYTE *)calloc(Size[MBC_DI] / BYTESIZE + 1, sizeof(BYTE));
+    MbcOut = (BYTE *)calloc(Size[MBC_DQ] / BYTESIZE + 1, sizeof(BYTE));
+    MbcAdcIn = (uint64_t *)calloc(Size[MBC_AI] + 1, sizeof(uint64_t));
+    MbcAdcOut = (uint64_t *)calloc(Size[MBC_AQ] + 1, sizeof(uint64_t));
+    Ring = new_uring(N_devices + 1);
+    for(; i < N_devices; i++){
+        start_connect(&Devices[i]);
+    }
+    //give every device one timeout to accept
+    struct timespec deadline;
+    msecs_from_now(Timeout, &deadline);
+    for(i = 0; i < N_devices && msecs_until(&deadline) > 0; i++){
+        mbc_device_t d = &Devices[i];
+        if(d->state == MBC_CONNECTING){
+            struct pollfd fd = {d->fd, POLLOUT, 0};
+            if(poll(&fd, 1, msecs_until(&deadline)) > 0){
+                finish_connect(d);
+            }
+        }
+    }
+    Mbc.status = PLC_OK;
+    plc_log("Polling %d modbus devices", N_devices);
+
+    return PLC_OK;
+}
+
+int mbc_disable() /* Disable bus communication */
+{
+    unsigned int i = 0;
+    if(MbcIn){//a restart starts over with fresh connections,
+    //but a bad configuration stays bad
+        Mbc.status = PLC_OK;
+    }
+    for(; i < N_devices; i++){
+        Devices[i].state = MBC_DISCONNECTED; //quietly
+        drop(&Devices[i]);
+    }
+    clear_uring(Ring);
+    Ring = NULL;
+    free(MbcIn);
+    MbcIn = NULL;
+    free(MbcOut);
+    MbcOut = NULL;
+    free(MbcAdcIn);
+    MbcAdcIn = NULL;
+    free(MbcAdcOut);
+    MbcAdcOut = NULL;
+
+    return PLC_OK;
+}
+
+int mbc_fetch()
+{
+    unsigned int i = 0;
+    if(!MbcIn){
+
+        return PLC_ERR;
+    }
+    for(; i < N_devices; i++){
+        mbc_device_t d = &Devices[i];
+        if(d->state != MBC_CONNECTED){ //collect() stops the plc, START reconnects
+            continue;
+        }
+        if(request_bank(d, MB_READ_DISCRETE, MBC_DI, MB_MAX_READ_BITS) < 0
+        || request_bank(d, MB_READ_INPUT, MBC_AI, MB_MAX_READ_REGS) < 0){
+            drop(d);
+        }
+    }
+    //every read of every device goes out before any answer is awaited
+    transmit_all();
+    //also collects the acknowledgements of the last flush
+    Mbc.status = collect();
+
+    return Mbc.status;
+}
+
+int mbc_flush()
+{
+    unsigned int i = 0;
+    int r = PLC_OK;
+    if(!MbcIn){
+
+        return PLC_ERR;
+    }
+    //written every cycle, which also keeps remote watchdogs fed;
+    //the acknowledgements are collected by the next fetch
+    for(; i < N_devices; i++){
+        mbc_device_t d = &Devices[i];
+        if(d->state != MBC_CONNECTED){
+            r = ERR_HARDWARE;
+            continue;
+        }
+        if(request_bank(d, MB_WRITE_COILS, MBC_DQ, MB_MAX_WRITE_BITS) < 0
+        || request_bank(d, MB_WRITE_REGISTERS, MBC_AQ, MB_MAX_WRITE_REGS) < 0){
+            drop(d);
+            r = ERR_HARDWARE;
+        }
+    }
+    if(transmit_all() < PLC_OK){
+        r = ERR_HARDWARE;
+    }
+    if(r < PLC_OK){
+        Mbc.status = r;
+    }
+    return r;
+}
+
+void mbc_dio_read(unsigned int n, BYTE* bit)
+{	//write input n to bit
+    *bit = n < Size[MBC_DI] ? get_bit(MbcIn, n) : 0;
+}
+
+void mbc_dio_write(const unsigned char *buf, unsigned int n,  BYTE bit)
+{	//write bit to n output
+    if(n < Size[MBC_DQ]){
+        set_bit(MbcOut, n, bit);
+    }
+}
+
+void mbc_dio_bitfield(const BYTE* mask, BYTE *bits)
+{	//simultaneusly write output bits defined by mask and read all inputs
+    /* FIXME */
+}
+
+void mbc_data_read(unsigned int index, uint64_t* value)
+{
+    *value = index < Size[MBC_AI] ? MbcAdcIn[index] : 0;
+}
+
+void mbc_data_write(unsigned int index, uint64_t value)
+{
+    if(index < Size[MBC_AQ]){
+        MbcAdcOut[index] = value;
+    }
+}
+
+struct hardware Mbc = {
+    HW_MODBUS,
+    0, //errorcode
+    "modbus tcp",
+    mbc_enable,// enable
+    mbc_disable, //disable
+    mbc_fetch, //fetch
+    mbc_flush, //flush
+    mbc_dio_read, //dio_read
+    mbc_dio_write, //dio_write
+    mbc_dio_bitfield, //dio_bitfield
+    mbc_data_read, //data_read
+    mbc_data_write, //data_write
+    mbc_config, //hw_config
+};
@@ -0,0 +1,270 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+
+#include "util.h"
+
+#include "config.h"
+#include "schema.h"
+#include "hardware.h"
+#include "hardware-shm.h"
+
+char * ShmName = NULL;
+shm_header_t ShmImage = NULL;
+size_t ShmSize = 0;
+unsigned char ShmStepped = FALSE;
+
+//local snapshots, the vm only ever sees these
+BYTE * ShmIn = NULL;
+BYTE * ShmOut = NULL;
+uint64_t * ShmAdcIn = NULL;
+uint64_t * ShmAdcOut = NULL;
+
+unsigned int Shm_ni = 0;
+unsigned int Shm_nq = 0;
+unsigned int Shm_nai = 0;
+unsigned int Shm_naq = 0;
+
+#define SHM_SYNC_TIMEOUT 100 //msecs before a stepped cycle is skipped
+
+struct hardware Shm;
+int shm_disable();
+
+int shm_sync()
+{
+    if(!ShmImage){
+
+        return PLC_ERR;
+    }
+    return shm_wait_turn(ShmImage, SHM_TURN_PLC, SHM_SYNC_TIMEOUT) < 0 ? 
+           PLC_ERR : PLC_OK;
+}
+
+int shm_config(const config_t conf)
+{
+    config_t hw = get_recursive_entry(CONFIG_HW, conf);
+    config_t ifc = get_recursive_entry(HW_IFACE, hw);
+    config_t shm = get_recursive_entry(IFACE_SHM, ifc);
+    char * name = get_string_entry(SHM_NAME, shm);
+    if(!name || name[0] != '/'){
+        plc_log("Invalid shared memory name %s", name ? name : "");
+
+        return PLC_ERR;
+    }
+    ShmName = name;
+    ShmStepped = get_numeric_entry(SHM_STEPPED, shm) > 0;
+    Shm.sync = ShmStepped ? shm_sync : NULL;
+
+    sequence_t s = get_sequence_entry(CONFIG_DI, conf);
+    Shm_ni = s ? s->size / BYTESIZE + 1 : 0;
+    s = get_sequence_entry(CONFIG_DQ, conf);
+    Shm_nq = s ? s->size / BYTESIZE + 1 : 0;
+    s = get_sequence_entry(CONFIG_AI, conf);
+    Shm_nai = s ? s->size : 0;
+    s = get_sequence_entry(CONFIG_AQ, conf);
+    Shm_naq = s ? s->size : 0;
+
+    Shm.label = get_string_entry(HW_LABEL, hw);
+
+    return PLC_OK;
+}
+
+static int shm_matches(const shm_header_t h)
+{   //a segment left behind is only reused if it was laid out for us
+    return __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) == SHM_MAGIC
+        && h->version == SHM_VERSION
+        && h->ni == Shm_ni
+        && h->nq == Shm_nq
+        && h->nai == Shm_nai
+        && h->naq == Shm_naq;
+}
+
+int shm_enable() /* Enable bus communication */
+{
+    struct stat st;
+    if(ShmImage){ //already attached
+
+        return PLC_OK;
+    }
+    int fd = shm_open(ShmName, O_CREAT | O_RDWR, 0660);
+    if(fd < 0){
+        plc_log("Failed to open shared memory %s", ShmName);
+
+        return PLC_ERR;
+    }
+    ShmSize = SHM_SIZE(Shm_ni, Shm_nq, Shm_nai, Shm_naq);
+    //a segment left behind with the same size may keep its sequences
+    int fresh = fstat(fd, &st) < 0 || (size_t)st.st_size != ShmSize;
+    if(fresh && ftruncate(fd, ShmSize) < 0){
+        plc_log("Failed to size shared memory %s", ShmName);
+        close(fd);
+
+        return PLC_ERR;
+    }
+    ShmImage = (shm_header_t)mmap(NULL,
+                                  ShmSize,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED,
+                                  fd,
+                                  0);
+    close(fd);
+    if(ShmImage == MAP_FAILED){
+        ShmImage = NULL;
+        plc_log("Failed to map shared memory %s", ShmName);
+
+        return PLC_ERR;
+    }
+    if(!fresh && !shm_matches(ShmImage)){
+        plc_log("Shared memory %s has another layout, reinitializing", ShmName);
+        fresh = TRUE;
+    }
+    if(fresh){
+        memset(ShmImage, 0, ShmSize);
+        ShmImage->version = SHM_VERSION;
+        ShmImage->ni = Shm_ni;
+        ShmImage->nq = Shm_nq;
+        ShmImage->nai = Shm_nai;
+        ShmImage->naq = Shm_naq;
+        //plant models poll for the magic before trusting the geometry
+        __atomic_store_n(&ShmImage->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    }
+    ShmImage->stepped = ShmStepped;
+    if(ShmStepped){ //the plant provides the first inputs
+        shm_pass_turn(ShmImage, SHM_TURN_PLANT);
+    }
+    ShmIn = (BYTE *)calloc(Shm_ni + 1, sizeof(BYTE));
+    ShmOut = (BYTE *)calloc(Shm_nq + 1, sizeof(BYTE));
+    ShmAdcIn = (uint64_t *)calloc(Shm_nai + 1, sizeof(uint64_t));
+    ShmAdcOut = (uint64_t *)calloc(Shm_naq + 1, sizeof(uint64_t));
+    if(!ShmIn || !ShmOut || !ShmAdcIn || !ShmAdcOut){
+        plc_log("Failed to allocate shared memory snapshots");
+        shm_disable();
+
+        return PLC_ERR;
+    }
+    plc_log("Opened shared memory %s, %lu bytes", ShmName, (unsigned long)ShmSize);
+
+    return PLC_OK;
+}
+
+int shm_disable() /* Disable bus communication */
+{
+    int r = PLC_OK;
+    //the segment outlives the plc, so that plant models can stay attached
+    if(ShmImage && munmap(ShmImage, ShmSize) < 0){
+        r = PLC_ERR;
+    }
+    ShmImage = NULL;
+    plc_log("Closed shared memory %s", ShmName);
+
+    free(ShmIn);
+    ShmIn = NULL;
+    free(ShmOut);
+    ShmOut = NULL;
+    free(ShmAdcIn);
+    ShmAdcIn = NULL;
+    free(ShmAdcOut);
+    ShmAdcOut = NULL;
+
+    return r;
+}
+
+int shm_fetch()
+{
+    if(!ShmImage){
+
+        return PLC_ERR;
+    }
+    int i = 0;
+    for(; i < SHM_RETRIES; i++){
+        uint32_t seq = shm_read_begin(&ShmImage->in_seq);
+        memcpy(ShmIn, SHM_DI(ShmImage), Shm_ni);
+        memcpy(ShmAdcIn, SHM_AI(ShmImage), Shm_nai * sizeof(uint64_t));
+        if(!shm_read_retry(&ShmImage->in_seq, seq)){
+
+            return PLC_OK;
+        }
+    }
+    //torn or abandoned write,
+    //keep the previous cycle's inputs rather than stall the plc
+
+    return PLC_ERR;
+}
+
+int shm_flush()
+{
+    if(!ShmImage){
+
+        return PLC_ERR;
+    }
+    shm_write_begin(&ShmImage->out_seq);
+    memcpy(SHM_DQ(ShmImage), ShmOut, Shm_nq);
+    memcpy(SHM_AQ(ShmImage), ShmAdcOut, Shm_naq * sizeof(uint64_t));
+    ShmImage->cycle++;
+    shm_write_end(&ShmImage->out_seq);
+    if(ShmStepped){
+        shm_pass_turn(ShmImage, SHM_TURN_PLANT);
+    }
+
+    return PLC_OK;
+}
+
+void shm_dio_read(unsigned int n, BYTE* bit)
+{	//write input n to bit
+    unsigned int position = n / BYTESIZE;
+    *bit = 0;
+    if(position < Shm_ni){
+        *bit = (ShmIn[position] >> n % BYTESIZE) % 2;
+    }
+}
+
+void shm_dio_write(const unsigned char *buf, unsigned int n,  BYTE bit)
+{	//write bit to n output
+    unsigned int position = n / BYTESIZE;
+    if(position < Shm_nq){
+        if(bit){
+            ShmOut[position] |= 1 << n % BYTESIZE;
+        } else {
+            ShmOut[position] &= ~(1 << n % BYTESIZE);
+        }
+    }
+}
+
+void shm_dio_bitfield(const BYTE* mask, BYTE *bits)
+{	//simultaneusly write output bits defined by mask and read all inputs
+    /* FIXME */
+}
+
+void shm_data_read(unsigned int index, uint64_t* value)
+{
+    *value = index < Shm_nai ? ShmAdcIn[index] : 0;
+}
+
+void shm_data_write(unsigned int index, uint64_t value)
+{
+    if(index < Shm_naq){
+        ShmAdcOut[index] = value;
+    }
+}
+
+struct hardware Shm = {
+    HW_SHM,
+    0, //errorcode
+    "shared memory",
+    shm_enable,// enable
+    shm_disable, //disable
+    shm_fetch, //fetch
+    shm_flush, //flush
+    shm_dio_read, //dio_read
+    shm_dio_write, //dio_write
+    shm_dio_bitfield, //dio_bitfield
+    shm_data_read, //data_read
+    shm_data_write, //data_write
+    shm_config, //hw_config
+};
+
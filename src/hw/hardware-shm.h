@@ -0,0 +1,134 @@
+#ifndef _HARDWARE_SHM_H_
+#define _HARDWARE_SHM_H_
+/**
+ *@file hardware-shm.h
+ *@brief shared memory process image,
+ * include this from external plant models that attach to the segment
+*/
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SHM_MAGIC 0x504c4345 //"PLCE"
+#define SHM_VERSION 2
+#define SHM_RETRIES 64 //give up on a torn snapshot after that many reads
+
+/**
+ * Segment layout: header, analog inputs, analog outputs,
+ * digital input bytes, digital output bytes.
+ * Inputs are written by the plant and guarded by in_seq,
+ * outputs are written by the plc and guarded by out_seq.
+ * A writer makes its sequence odd, updates the image and makes it even again;
+ * a reader copies the image and retries if the sequence was odd or changed.
+ * In stepped mode the two sides also take turns on a futex word:
+ * the plant writes inputs and hands the turn to the plc, 
+ * the plc runs exactly one cycle, publishes outputs and hands it back.
+ */
+typedef struct shm_header{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ni; ///digital input bytes
+    uint32_t nq; ///digital output bytes
+    uint32_t nai; ///analog input samples
+    uint32_t naq; ///analog output samples
+    uint32_t in_seq; ///input sequence lock
+    uint32_t out_seq; ///output sequence lock
+    uint64_t cycle; ///plc cycles published so far
+    uint32_t stepped; ///lock-step co-simulation
+    uint32_t turn; ///whose turn it is in stepped mode
+} * shm_header_t;
+
+typedef enum{
+    SHM_TURN_PLANT,
+    SHM_TURN_PLC,
+    N_SHM_TURNS
+}SHM_TURNS;
+
+#define SHM_AI(h) ((uint64_t *)((unsigned char *)(h) + sizeof(struct shm_header)))
+#define SHM_AQ(h) (SHM_AI(h) + (h)->nai)
+#define SHM_DI(h) ((unsigned char *)(SHM_AQ(h) + (h)->naq))
+#define SHM_DQ(h) (SHM_DI(h) + (h)->ni)
+#define SHM_SIZE(ni, nq, nai, naq) (sizeof(struct shm_header) \
+                            + sizeof(uint64_t) * ((nai) + (naq)) + (ni) + (nq))
+
+/**
+ * @brief start writing under a sequence lock
+ * @param the sequence
+ */
+static inline void shm_write_begin(uint32_t * seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief publish what was written under a sequence lock
+ * @param the sequence
+ */
+static inline void shm_write_end(uint32_t * seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief start reading under a sequence lock
+ * @param the sequence
+ * @return the sequence value to validate the read against
+ */
+static inline uint32_t shm_read_begin(const uint32_t * seq)
+{
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief validate what was read under a sequence lock
+ * @param the sequence
+ * @param the value returned by shm_read_begin
+ * @return 0 if the copy is consistent, else it has to be retried
+ */
+static inline int shm_read_retry(const uint32_t * seq, uint32_t begin)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (begin % 2) || __atomic_load_n(seq, __ATOMIC_RELAXED) != begin;
+}
+
+/**
+ * @brief block until it is someone's turn in stepped mode
+ * @param the segment
+ * @param who is waiting
+ * @param timeout in milliseconds
+ * @return 0 when the turn is taken, -1 on timeout
+ */
+static inline int shm_wait_turn(shm_header_t h, uint32_t who, long timeout)
+{
+    struct timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000;
+    uint32_t turn = 0;
+    while((turn = __atomic_load_n(&h->turn, __ATOMIC_ACQUIRE)) != who){
+    //the futex syscall rechecks the word, so a handover is never missed
+        if(syscall(SYS_futex, &h->turn, FUTEX_WAIT, turn, &ts, NULL, 0) < 0
+        && errno == ETIMEDOUT
+        && __atomic_load_n(&h->turn, __ATOMIC_ACQUIRE) != who){
+            
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief hand the turn over to the other side in stepped mode
+ * @param the segment
+ * @param whose turn is next
+ */
+static inline void shm_pass_turn(shm_header_t h, uint32_t who)
+{
+    __atomic_store_n(&h->turn, who, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &h->turn, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+#endif //_HARDWARE_SHM_H_
@@ -1,4 +1,6 @@
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "data.h"
 #include "instruction.h"
@@ -9,11 +11,21 @@
 #include "config.h"
 #include "schema.h"
 #include "hardware.h"
+#include "uring.h"
 
 #define ASCIISTART 0x30
+#define SIM_BACKLOG 8 //output records kept while a write is in flight,
+                       //a slower reader holds the plc back
 
-FILE * Ifd = NULL;
-FILE * Qfd = NULL;
+typedef enum{
+    SIM_READ,
+    SIM_WRITE
+}SIM_REQUESTS;
+
+static char * SimIn = NULL;
+static char * SimOut = NULL;
+int Ifd = PLC_ERR;
+int Qfd = PLC_ERR;
 char * BufIn = NULL;
 char * BufOut = NULL;
 char * AdcIn = NULL;
@@ -24,34 +36,30 @@ unsigned int Nq = 0;
 unsigned int Nai = 0;
 unsigned int Naq = 0;
 
-//char SimInFile[MAXSTR] = "";
-//char SimOutFile[MAXSTR] = "";
+//a cycle's output record and the next input record go in one batch
+static uring_t Ring = NULL;
+static char * RecIn = NULL; ///the input record being read ahead
+static unsigned int InLen = 0;
+static BYTE Reading = FALSE;
+static BYTE InFile = FALSE; ///a regular file, its records are never late
+//output records, one buffer in flight while the other fills up
+static char * RecOut[2] = {NULL, NULL};
+static unsigned int OutLen = 0;
+static unsigned int Fill = 0;
+static unsigned int FillLen = 0;
+static unsigned int FlyLen = 0;
+static BYTE Writing = FALSE;
 
 struct hardware Sim;
 
 int sim_config(const config_t conf)
 {
-    int r = PLC_OK;    
     config_t hw = get_recursive_entry(CONFIG_HW, conf);
     config_t ifc = get_recursive_entry(HW_IFACE, hw);
-    char * istr = get_string_entry(SIM_INPUT, ifc);
-    if(istr){
-        if(!(Ifd=fopen(istr, "r+"))){
-                plc_log("Failed to open simulation input from %s", istr);
-                r = PLC_ERR;
-        } else {
-                plc_log("Opened simulation input from %s", istr);
-        }
-    }
-    char * ostr = get_string_entry(SIM_OUTPUT, ifc);
-    if(ostr){
-         if(!(Qfd=fopen(ostr, "w+"))){
-             plc_log("Failed to open simulation output to %s", ostr);
-             r = PLC_ERR;
-        } else {
-            plc_log("Opened simulation output to %s", ostr);
-        }
-    }
+    config_t sim = get_recursive_entry(IFACE_SIM, ifc);
+    //the files are opened when the plc starts
+    SimIn = get_string_entry(SIM_INPUT, sim);
+    SimOut = get_string_entry(SIM_OUTPUT, sim);
     
     sequence_t s = get_sequence_entry(CONFIG_DI, conf);
     if(s){
@@ -71,12 +79,108 @@ int sim_config(const config_t conf)
     }    
     Sim.label = get_string_entry(HW_LABEL, hw);
         
-    return r;    
+    return PLC_OK;    
+}
+
+/**
+ * @brief queue a read of the next input record, if none is in flight
+ */
+static void read_ahead()
+{
+    if(Ifd >= 0 && InLen > 0 && !Reading
+    && uring_read(Ring, Ifd, RecIn, InLen, SIM_READ) == PLC_OK){
+        Reading = TRUE;
+    }
+}
+
+/**
+ * @brief queue the filled output records, if no write is in flight
+ */
+static void write_behind()
+{
+    if(Qfd >= 0 && FillLen > 0 && !Writing
+    && uring_write(Ring, Qfd, RecOut[Fill], FillLen, SIM_WRITE) == PLC_OK){
+        Writing = TRUE;
+        FlyLen = FillLen;
+        Fill = !Fill;
+        FillLen = 0;
+    }
+}
+
+/**
+ * @brief take in a completed read
+ * @param bytes read or -errno
+ * @return OK or ERROR
+ */
+static int read_done(int res)
+{
+    int i = 0;
+    Reading = FALSE;
+    if(res < 0){
+
+        return PLC_ERR;
+    }
+    if(res < InLen){ //end of file, start over
+        lseek(Ifd, 0, SEEK_SET);
+
+        return PLC_OK;
+    }
+    for(; i < Ni; i++){
+        BufIn[i] = RecIn[i] >= ASCIISTART ? RecIn[i] - ASCIISTART : RecIn[i];
+    }
+    memcpy(AdcIn, RecIn + Ni, LONG_BYTES * Nai);
+
+    return PLC_OK;
+}
+
+/**
+ * @brief take in a completed write, a short one is written again
+ * ahead of the records that filled up meanwhile
+ * @param bytes written or -errno
+ * @return OK or ERROR
+ */
+
+static int write_done(int res)
+{
+    unsigned int left = 0;
+    Writing = FALSE;
+    if(res < 0){
+
+        return PLC_ERR;
+    }
+    left = FlyLen - res;
+    if(left > 0){ //there is room for a whole backlog more
+        memmove(RecOut[Fill] + left, RecOut[Fill], FillLen);
+        memcpy(RecOut[Fill], RecOut[!Fill] + res, left);
+        FillLen += left;
+    }
+    return PLC_OK;
+}
+
+/**
+ * @brief take in every completion there is, without syscalls
+ * @return OK or ERROR
+ */
+static int reap()
+{
+    unsigned long tag = 0;
+    int res = 0;
+    int r = PLC_OK;
+    while(uring_reap(Ring, &tag, &res)){
+        if((tag == SIM_READ ? read_done(res) : write_done(res)) < 0){
+            r = PLC_ERR;
+        }
+    }
+    return r;
 }
 
 int sim_enable() /* Enable bus communication */
 {
     int r = PLC_OK;
+    if(Ring){ //already enabled
+
+        return PLC_OK;
+    }
     /*open input and output streams*/
     
     if(!(BufIn = (char * )malloc(Ni))){
@@ -99,84 +203,138 @@ int sim_enable() /* Enable bus communication */
     } else {
         memset(AdcOut, 0, LONG_BYTES * Naq);
     }
+    InLen = Ni + LONG_BYTES * Nai;
+    OutLen = Nq + LONG_BYTES * Naq + 1; //and a newline
+    RecIn = (char *)malloc(InLen + 1);
+    RecOut[0] = (char *)malloc(2 * SIM_BACKLOG * OutLen);
+    RecOut[1] = (char *)malloc(2 * SIM_BACKLOG * OutLen);
+    if(!RecIn || !RecOut[0] || !RecOut[1]){
+        r = PLC_ERR;
+    }
+    InFile = FALSE;
+    if(SimIn && SimIn[0]){
+        if((Ifd = open(SimIn, O_RDWR | O_CLOEXEC)) < 0){
+            plc_log("Failed to open simulation input from %s", SimIn);
+            r = PLC_ERR;
+        } else {
+            struct stat st;
+            InFile = fstat(Ifd, &st) == 0 && S_ISREG(st.st_mode);
+            plc_log("Opened simulation input from %s", SimIn);
+        }
+    }
+    if(SimOut && SimOut[0]){
+        if((Qfd = open(SimOut, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                       0666)) < 0){
+            plc_log("Failed to open simulation output to %s", SimOut);
+            r = PLC_ERR;
+        } else {
+            plc_log("Opened simulation output to %s", SimOut);
+        }
+    }
+    //one read and one write in flight at most
+    if(!(Ring = new_uring(2))){
+        r = PLC_ERR;
+    }
+    Reading = FALSE;
+    Writing = FALSE;
+    Fill = 0;
+    FillLen = 0;
+    if(r == PLC_OK){
+    //the first cycle finds its inputs read already
+        read_ahead();
+        uring_submit(Ring, 0);
+    }
     return r;
 }
 
 int sim_disable() /* Disable bus communication */
 {
     int r = PLC_OK;
+    //what is left of the output goes out, as fflush() would
+    write_behind();
+    while(Writing){
+        if(uring_submit(Ring, 1) < 0 || reap() < 0){
+            break;
+        }
+        write_behind();
+    }
+    //nothing may land in the buffers after they are freed
+    clear_uring(Ring);
+    Ring = NULL;
     /*close streams*/
-    if(Ifd && !fclose(Ifd)){
+    if(Ifd >= 0 && close(Ifd) < 0){
         r = PLC_ERR;
     }
+    Ifd = PLC_ERR;
     plc_log("Closed simulation input");
-    if(Qfd && !fclose(Qfd)){
+    if(Qfd >= 0 && close(Qfd) < 0){
         r = PLC_ERR;
     }
+    Qfd = PLC_ERR;
     plc_log("Closed simulation output"); 
-    if(BufIn){
-        free(BufIn);
-        BufIn = NULL;
-    }
-    if(BufOut){
-        free(BufOut);
-        BufOut = NULL;
-    }
+    free(BufIn);
+    BufIn = NULL;
+    free(BufOut);
+    BufOut = NULL;
+    free(AdcIn);
+    AdcIn = NULL;
+    free(AdcOut);
+    AdcOut = NULL;
+    free(RecIn);
+    RecIn = NULL;
+    free(RecOut[0]);
+    RecOut[0] = NULL;
+    free(RecOut[1]);
+    RecOut[1] = NULL;
+
     return r;
 }
 
 int sim_fetch()
 {
-    unsigned int digital = Ni;
-    unsigned int analog = Nai;
-    int bytes_read = 0;
-    if(Ifd){
-        bytes_read = fread(BufIn, 
-                        sizeof(BYTE), 
-                        digital, 
-                        Ifd ? Ifd : stdin);
-        int i = 0;
-        for(; i < bytes_read; i++){
-            if(BufIn[i] >= ASCIISTART){
-                BufIn[i] -= ASCIISTART;
-            }
-        }
-        bytes_read += fread(AdcIn, 
-                        sizeof(BYTE), 
-                        LONG_BYTES*analog, 
-                        Ifd ? Ifd : stdin);
-   
-        if(bytes_read < digital + LONG_BYTES*analog){
-        //plc_log("failed to read from %s, reopening", SimInFile);
-                if(feof(Ifd)){
-                    rewind(Ifd);
-                } else {
-                sim_disable();
-                sim_enable();
-                }
+    int r = reap();
+    //a file has one record per cycle, read ahead since the last cycle,
+    //a fifo's writer may simply not have written the next one yet
+    while(r == PLC_OK && Reading && InFile){
+        if(uring_submit(Ring, 1) < 0){
+            r = PLC_ERR;
+        } else {
+            r = reap();
         }
     }
-    return bytes_read;
+    //submitted with the outputs
+    read_ahead();
+
+    return r;
 }
 
 int sim_flush()
 {
-    int bytes_written = 0;
-    unsigned int digital = Nq;
-    unsigned int analog = Naq;
-    if(Qfd){
-        bytes_written = fwrite(BufOut, 
-                        sizeof(BYTE), 
-                        digital, 
-                        Qfd);
-        bytes_written += fwrite(AdcOut, 
-                            sizeof(BYTE), 
-                            analog * LONG_BYTES, 
-                            Qfd );
-        fputc('\n', Qfd );
-        fflush(Qfd);
+    int r = PLC_OK;
+    if(Qfd >= 0){
+        while(r == PLC_OK && Writing
+        && FillLen + OutLen > SIM_BACKLOG * OutLen){
+            if(uring_submit(Ring, 1) < 0){
+                r = PLC_ERR;
+            } else {
+                r = reap();
+            }
+        }
+        write_behind();
+        if(FillLen + OutLen <= SIM_BACKLOG * OutLen){
+            char * rec = RecOut[Fill] + FillLen;
+            memcpy(rec, BufOut, Nq);
+            memcpy(rec + Nq, AdcOut, LONG_BYTES * Naq);
+            rec[OutLen - 1] = '\n';
+            FillLen += OutLen;
+        }
+        write_behind();
+    }
+    //this cycle's outputs and the next cycle's inputs, one syscall
+    if(uring_submit(Ring, 0) < 0){
+        r = PLC_ERR;
     }
-    return bytes_written;
+    return r;
 }
 
 void sim_dio_read(unsigned int n, BYTE* bit)
@@ -184,7 +342,7 @@ void sim_dio_read(unsigned int n, BYTE* bit)
     unsigned int b, position;
     position = n / BYTESIZE;
     BYTE i = 0;
-    if(strlen(BufIn) > position){
+    if(position < Ni){
     /*read a byte from input stream*/
         i = BufIn[position];
     }
@@ -202,7 +360,7 @@ void sim_dio_write(const unsigned char *buf, unsigned int n,  BYTE bit)
     /*write a byte to output stream*/
     q+=ASCIISTART; //ASCII
    // plc_log("Send %d to byte %d", q, position);
-     if(strlen(BufOut) >= position){
+     if(position < Nq){
          BufOut[position] = q;
      }
 }
@@ -221,7 +379,7 @@ void sim_data_read(unsigned int index, uint64_t* value)
     unsigned int pos = index*LONG_BYTES;
     int i = LONG_BYTES - 1;
     *value = 0;
-    if(strlen(AdcIn) > pos) {
+    if(pos < LONG_BYTES * Nai) {
        uint64_t mult = 1;
        for(; i >= 0 ; i--){
             *value += (uint64_t)AdcIn[pos + i] * mult;
@@ -234,7 +392,14 @@ void sim_data_read(unsigned int index, uint64_t* value)
 void sim_data_write(unsigned int index, uint64_t value)
 {
     unsigned int pos = index*LONG_BYTES;
-    sprintf(AdcOut + pos, "%lx", value);
+    int i = LONG_BYTES - 1;
+    if(pos < LONG_BYTES * Naq) {
+    //same byte order as sim_data_read
+        for(; i >= 0 ; i--){
+            AdcOut[pos + i] = value % 0x100;
+            value /= 0x100;
+        }
+    }
     return; 
 }
 
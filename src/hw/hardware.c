@@ -1,12 +1,47 @@
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
 #include "config.h"
 #include "hardware.h"
 
 extern struct hardware Comedi;
 extern struct hardware Uspace;
 extern struct hardware Sim;
+extern struct hardware Shm;
+extern struct hardware Dry;
+extern struct hardware Gpio;
+extern struct hardware Mbc;
+extern struct hardware Can;
+
+static const char * HwNames[N_HW] = {
+    "DRY",
+    "SIM",
+    "COMEDI",
+    "USPACE",
+    "IIO",
+    "USB",
+    "SHM",
+    "GPIO",
+    "MODBUS",
+    "CAN"
+};
+
+int get_hardware_type(const char * name){
+    int i = 0;
+    for(; name && i < N_HW; i++){
+        if(!strcmp(name, HwNames[i])){
+        
+            return i;
+        }
+    }
+    return PLC_ERR;
+}
 
 hardware_t get_hardware( int type){
     switch(type){
+        case HW_DRY:
+            return &Dry;
+
         case HW_COMEDI:
 #ifdef COMEDI        
             return &Comedi;
@@ -18,6 +53,31 @@ hardware_t get_hardware( int type){
 
         case HW_SIM: 
         	return &Sim;
+
+        case HW_SHM:
+#ifdef SHM
+            return &Shm;
+#else
+            return NULL;
+#endif
+
+        case HW_GPIO:
+#ifdef GPIO
+            return &Gpio;
+#else
+            return NULL;
+#endif
+
+        case HW_MODBUS:
+            return &Mbc;
+
+        case HW_CAN:
+#ifdef CAN
+            return &Can;
+#else
+            return NULL;
+#endif
+
         default: return NULL;
     }
 }
@@ -7,12 +7,16 @@
 #include <inttypes.h>
 
 typedef enum{
-    HW_DRY,//TODO
+    HW_DRY,
     HW_SIM,
     HW_COMEDI,
     HW_USPACE,//TODO: update with current linux kernels
     HW_IIO, //TODO Linux industrial I/O
     HW_USB, //TODO FAR IN THE FUTURE
+    HW_SHM, //shared memory co-simulation
+    HW_GPIO, //linux gpio character device
+    HW_MODBUS, //remote I/O over modbus tcp
+    HW_CAN, //cyclic frames over socketcan
     N_HW
 }HARDWARES;
 
@@ -88,6 +92,13 @@ typedef struct hardware{
  */
    config_f configure;
 
+/**
+ * @brief block until an external simulator hands over the next cycle,
+ * only set for lock-step co-simulation, it replaces the timed wait
+ * @return PLC_OK when the cycle can run, error code to skip it
+ */
+   helper_f sync;
+
 } * hardware_t;
 
 
@@ -96,5 +107,12 @@ typedef struct hardware{
  */
 hardware_t get_hardware(int type);
 
+/**
+ * @brief look up a hardware type by name
+ * @param the name, as in HW/TYPE
+ * @return the type or PLC_ERR
+ */
+int get_hardware_type(const char * name);
+
 
 #endif //_HARDWARE_H_
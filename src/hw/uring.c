@@ -0,0 +1,403 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#include <linux/io_uring.h>
+#endif
+
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+
+#include "util.h"
+
+#include "uring.h"
+
+#define URING_CANCEL 0 //user data of cancellations, requests use slot + 1
+
+typedef enum{
+    URING_READ,
+    URING_WRITE,
+    URING_SEND
+}URING_OPS;
+
+//a send never waits for room in the socket, nor raises SIGPIPE
+#define URING_SEND_FLAGS (MSG_DONTWAIT | MSG_NOSIGNAL)
+
+typedef enum{
+    URING_FREE,
+    URING_QUEUED, //waiting for the next submit
+    URING_FLIGHT, //submitted
+    URING_DONE //completed, not reaped
+}URING_STATES;
+
+/**
+ * @brief a request, the slot index identifies it to the kernel
+ */
+struct uring_op{
+    BYTE state;
+    BYTE op;
+    int fd;
+    void * buf;
+    unsigned int len;
+    unsigned long tag;
+    int res;
+};
+
+struct uring{
+    int fd; ///the ring, PLC_ERR runs requests synchronously
+    unsigned int depth;
+    struct uring_op * ops;
+    unsigned int pending;
+    unsigned int queued;
+#ifdef __NR_io_uring_setup
+    //submission queue
+    unsigned int * sq_head;
+    unsigned int * sq_tail;
+    unsigned int * sq_mask;
+    unsigned int * sq_array;
+    struct io_uring_sqe * sqes;
+    //completion queue
+    unsigned int * cq_head;
+    unsigned int * cq_tail;
+    unsigned int * cq_mask;
+    struct io_uring_cqe * cqes;
+
+    void * sq_ring;
+    size_t sq_len;
+    void * cq_ring;
+    size_t cq_len;
+    size_t sqes_len;
+#endif
+};
+
+#ifdef __NR_io_uring_setup
+
+static int map_rings(uring_t r, const struct io_uring_params * p)
+{
+    r->sq_len = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+    r->cq_len = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if(p->features & IORING_FEAT_SINGLE_MMAP){
+        r->sq_len = r->cq_len = r->sq_len > r->cq_len ? r->sq_len : r->cq_len;
+    }
+    r->sq_ring = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if(r->sq_ring == MAP_FAILED){
+        r->sq_ring = NULL;
+
+        return PLC_ERR;
+    }
+    if(p->features & IORING_FEAT_SINGLE_MMAP){
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if(r->cq_ring == MAP_FAILED){
+            r->cq_ring = NULL;
+
+            return PLC_ERR;
+        }
+    }
+    r->sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if(r->sqes == MAP_FAILED){
+        r->sqes = NULL;
+
+        return PLC_ERR;
+    }
+    r->sq_head = (unsigned int *)((char *)r->sq_ring + p->sq_off.head);
+    r->sq_tail = (unsigned int *)((char *)r->sq_ring + p->sq_off.tail);
+    r->sq_mask = (unsigned int *)((char *)r->sq_ring + p->sq_off.ring_mask);
+    r->sq_array = (unsigned int *)((char *)r->sq_ring + p->sq_off.array);
+    r->cq_head = (unsigned int *)((char *)r->cq_ring + p->cq_off.head);
+    r->cq_tail = (unsigned int *)((char *)r->cq_ring + p->cq_off.tail);
+    r->cq_mask = (unsigned int *)((char *)r->cq_ring + p->cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)((char *)r->cq_ring + p->cq_off.cqes);
+
+    return PLC_OK;
+}
+
+static void unmap_rings(uring_t r)
+{
+    if(r->sqes){
+        munmap(r->sqes, r->sqes_len);
+    }
+    if(r->cq_ring && r->cq_ring != r->sq_ring){
+        munmap(r->cq_ring, r->cq_len);
+    }
+    if(r->sq_ring){
+        munmap(r->sq_ring, r->sq_len);
+    }
+}
+
+static int enter(uring_t r, unsigned int submit, unsigned int wait)
+{
+    int n = 0;
+    do{
+        n = syscall(__NR_io_uring_enter, r->fd, submit, wait,
+                    wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    }while(n < 0 && errno == EINTR);
+
+    return n;
+}
+
+/**
+ * @brief the next submission queue entry, cleared
+ * @param the ring
+ * @param opcode
+ * @param user data
+ * @return the entry, to fill in and push
+ */
+static struct io_uring_sqe * next_sqe(uring_t r, BYTE opcode, uint64_t data)
+{
+    unsigned int i = *r->sq_tail & *r->sq_mask;
+    struct io_uring_sqe * sqe = &r->sqes[i];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = data;
+    r->sq_array[i] = i;
+
+    return sqe;
+}
+
+static void push_sqe(uring_t r)
+{
+    //the kernel sees the entry only after the tail moves
+    __atomic_store_n(r->sq_tail, *r->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief move completions from the shared ring to their slots
+ * @param the ring
+ */
+static void complete(uring_t r)
+{
+    unsigned int head = *r->cq_head;
+    unsigned int tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    for(; head != tail; head++){
+        struct io_uring_cqe * cqe = &r->cqes[head & *r->cq_mask];
+        if(cqe->user_data != URING_CANCEL
+        && cqe->user_data <= r->depth){
+            struct uring_op * op = &r->ops[cqe->user_data - 1];
+            op->res = cqe->res;
+            op->state = URING_DONE;
+        }
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+#endif //__NR_io_uring_setup
+
+uring_t new_uring(unsigned int depth)
+{
+    uring_t r = (uring_t)calloc(1, sizeof(struct uring));
+    if(r == NULL || depth == 0){
+        free(r);
+
+        return NULL;
+    }
+    r->depth = depth;
+    r->fd = PLC_ERR;
+    r->ops = (struct uring_op *)calloc(depth, sizeof(struct uring_op));
+#ifdef __NR_io_uring_setup
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    //room for a cancellation per request
+    r->fd = syscall(__NR_io_uring_setup, 2 * depth, &p);
+    if(r->fd >= 0
+    && (!(p.features & IORING_FEAT_RW_CUR_POS)
+        || map_rings(r, &p) < 0)){
+        unmap_rings(r);
+        close(r->fd);
+        r->fd = PLC_ERR;
+    }
+    if(r->fd < 0){
+        plc_log("No io_uring, batched I/O runs synchronously");
+    }
+#endif
+    return r;
+}
+
+static int queue(uring_t r, int fd, void * buf, unsigned int len,
+                 unsigned long tag, BYTE opcode)
+{
+    unsigned int i = 0;
+    if(r == NULL){
+
+        return PLC_ERR;
+    }
+    for(; i < r->depth; i++){
+        struct uring_op * op = &r->ops[i];
+        if(op->state == URING_FREE){
+            op->state = URING_QUEUED;
+            op->op = opcode;
+            op->fd = fd;
+            op->buf = buf;
+            op->len = len;
+            op->tag = tag;
+            op->res = 0;
+            r->pending++;
+#ifdef __NR_io_uring_setup
+            if(r->fd >= 0){
+                struct io_uring_sqe * sqe = next_sqe(r,
+                    opcode == URING_SEND ? IORING_OP_SEND
+                    : opcode == URING_WRITE ? IORING_OP_WRITE 
+                    : IORING_OP_READ, i + 1);
+                sqe->fd = fd;
+                sqe->addr = (uint64_t)(uintptr_t)buf;
+                sqe->len = len;
+                if(opcode == URING_SEND){
+                    sqe->msg_flags = URING_SEND_FLAGS;
+                } else {
+                    sqe->off = (uint64_t)-1; //current position
+                }
+                push_sqe(r);
+                r->queued++;
+            }
+#endif
+            return PLC_OK;
+        }
+    }
+    return PLC_ERR;
+}
+
+int uring_read(uring_t r, int fd, void * buf, unsigned int len,
+               unsigned long tag)
+{
+    return queue(r, fd, buf, len, tag, URING_READ);
+}
+
+int uring_write(uring_t r, int fd, const void * buf, unsigned int len,
+                unsigned long tag)
+{
+    return queue(r, fd, (void *)buf, len, tag, URING_WRITE);
+}
+
+int uring_send(uring_t r, int fd, const void * buf, unsigned int len,
+               unsigned long tag)
+{
+    return queue(r, fd, (void *)buf, len, tag, URING_SEND);
+}
+
+int uring_submit(uring_t r, unsigned int wait)
+{
+    unsigned int i = 0;
+    if(r == NULL){
+
+        return PLC_ERR;
+    }
+#ifdef __NR_io_uring_setup
+    if(r->fd >= 0){
+        if(r->queued == 0 && wait == 0){ //nothing to do, no syscall
+
+            return PLC_OK;
+        }
+        int n = enter(r, r->queued, wait);
+        if(n < 0){
+
+            return PLC_ERR;
+        }
+        for(; i < r->depth; i++){
+            if(r->ops[i].state == URING_QUEUED){
+                r->ops[i].state = URING_FLIGHT;
+            }
+        }
+        //whatever the kernel did not take yet goes with the next submit
+        r->queued -= n < r->queued ? n : r->queued;
+
+        return PLC_OK;
+    }
+#endif
+    for(; i < r->depth; i++){
+        struct uring_op * op = &r->ops[i];
+        if(op->state == URING_QUEUED){
+            op->res = op->op == URING_SEND ? 
+                        send(op->fd, op->buf, op->len, URING_SEND_FLAGS)
+                    : op->op == URING_WRITE ? write(op->fd, op->buf, op->len)
+                    : read(op->fd, op->buf, op->len);
+            if(op->res < 0){
+                op->res = -errno;
+            }
+            op->state = URING_DONE;
+        }
+    }
+    return PLC_OK;
+}
+
+int uring_reap(uring_t r, unsigned long * tag, int * res)
+{
+    unsigned int i = 0;
+    if(r == NULL){
+
+        return FALSE;
+    }
+#ifdef __NR_io_uring_setup
+    if(r->fd >= 0){
+        complete(r);
+    }
+#endif
+    for(; i < r->depth; i++){
+        struct uring_op * op = &r->ops[i];
+        if(op->state == URING_DONE){
+            *tag = op->tag;
+            *res = op->res;
+            op->state = URING_FREE;
+            r->pending--;
+
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+unsigned int uring_pending(const uring_t r)
+{
+    return r ? r->pending : 0;
+}
+
+void clear_uring(uring_t r)
+{
+    if(r == NULL){
+
+        return;
+    }
+#ifdef __NR_io_uring_setup
+    if(r->fd >= 0){
+        unsigned int i = 0;
+        unsigned int flying = 0;
+        uring_submit(r, 0);
+        for(; i < r->depth; i++){
+            if(r->ops[i].state == URING_FLIGHT){
+                struct io_uring_sqe * sqe = next_sqe(r,
+                                                     IORING_OP_ASYNC_CANCEL,
+                                                     URING_CANCEL);
+                sqe->addr = i + 1;
+                push_sqe(r);
+                flying++;
+            }
+        }
+        //a cancelled request still completes, wait until they all have
+        if(flying > 0){
+            enter(r, flying, 0);
+        }
+        while(flying > 0){
+            complete(r);
+            for(i = 0, flying = 0; i < r->depth; i++){
+                flying += r->ops[i].state == URING_FLIGHT;
+            }
+            if(flying > 0 && enter(r, 0, 1) < 0){
+                break;
+            }
+        }
+        unmap_rings(r);
+        close(r->fd);
+    }
+#endif
+    free(r->ops);
+    free(r);
+}
@@ -0,0 +1,88 @@
+#ifndef _URING_H_
+#define _URING_H_
+/**
+ *@file uring.h
+ *@brief batched, non-blocking reads and writes for file, FIFO and socket
+ * backends. Requests are queued without syscalls, a cycle's batch is
+ * submitted with one io_uring_enter() and completions are reaped from
+ * the shared ring without any. Where io_uring is not available the same
+ * calls run the requests synchronously on submit.
+ * All requests use the file's current position, like read() and write().
+*/
+
+typedef struct uring * uring_t;
+
+/**
+ * @brief set up a ring
+ * @param max requests in flight
+ * @return the ring or NULL
+ */
+uring_t new_uring(unsigned int depth);
+
+/**
+ * @brief queue a read, the buffer must stay valid until it is reaped
+ * @param the ring
+ * @param file descriptor
+ * @param buffer
+ * @param bytes
+ * @param caller's tag, given back with the completion
+ * @return OK or ERROR if the ring is full
+ */
+int uring_read(uring_t r, int fd, void * buf, unsigned int len,
+               unsigned long tag);
+
+/**
+ * @brief queue a write, the buffer must stay valid until it is reaped
+ * @param the ring
+ * @param file descriptor
+ * @param buffer
+ * @param bytes
+ * @param caller's tag, given back with the completion
+ * @return OK or ERROR if the ring is full
+ */
+int uring_write(uring_t r, int fd, const void * buf, unsigned int len,
+                unsigned long tag);
+
+/**
+ * @brief queue a send on a socket. It never waits for room in the socket,
+ * so it completes with what the socket took, or -EAGAIN, on submit
+ * @param the ring
+ * @param socket
+ * @param buffer
+ * @param bytes
+ * @param caller's tag, given back with the completion
+ * @return OK or ERROR if the ring is full
+ */
+int uring_send(uring_t r, int fd, const void * buf, unsigned int len,
+               unsigned long tag);
+
+/**
+ * @brief submit everything queued, with one syscall
+ * @param the ring
+ * @param completions to wait for, 0 never blocks
+ * @return OK or ERROR
+ */
+int uring_submit(uring_t r, unsigned int wait);
+
+/**
+ * @brief take one completion, never blocks
+ * @param the ring
+ * @param the request's tag
+ * @param the request's result, bytes or -errno
+ * @return TRUE if there was one
+ */
+int uring_reap(uring_t r, unsigned long * tag, int * res);
+
+/**
+ * @return requests queued or in flight, not reaped yet
+ */
+unsigned int uring_pending(const uring_t r);
+
+/**
+ * @brief cancel whatever is in flight and tear the ring down,
+ * the buffers of cancelled requests are free to reuse afterwards
+ * @param the ring
+ */
+void clear_uring(uring_t r);
+
+#endif //_URING_H_
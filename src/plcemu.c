@@ -16,7 +16,13 @@
 #include "parser-tree.h"
 #include "parser-il.h"
 #include "parser-ld.h"
+#include "snapshot.h"
+#include "wire.h"
 #include "ui.h"
+#include "modbus.h"
+#include "peer.h"
+#include "reactor.h"
+#include "service.h"
 
 #include "app.h"
 #include "plcemu.h"
@@ -71,7 +77,12 @@ void sigkill() {
     plc_log("Total loops: %d", loop);
     plc_log("Average loop time: %f us", mean);
     plc_log("Standard deviation: +-%f us", sqrt(var));
+    plc_log("Missed cycles: %d", reactor_overruns());
+    modbus_end();
+    peer_end();
+    service_end();
     ui_end();
+    reactor_end();
     exit(0);
 }
 
@@ -93,10 +104,12 @@ app_t init_emu(const config_t conf) {
     return a;
 }
 
-const char * Usage = "Usage: plcemu [-c config file] \n \
+const char * Usage = "Usage: plcemu [-c config file] [-v] [-d] \n \
         Options:\n \
         -h displays this help message\n \
-        -c uses a configuration file other than config.yml";
+        -c uses a configuration file other than config.yml\n \
+        -v runs in virtual time, as fast as possible\n \
+        -d runs on dry hardware, inputs come from a generator";
 
 void print_error(int errcode)
 {
@@ -141,9 +154,11 @@ int main(int argc, char **argv)
     config_t conf = init_config(ConfigSchema, N_CONFIG_VARIABLES);
         
     char * cvalue = NULL;
+    int virtual = FALSE;
+    int dry = FALSE;
     opterr = 0;
     int c;
-    while ((c = getopt (argc, argv, "hc:")) != PLC_ERR){
+    while ((c = getopt (argc, argv, "hc:vd")) != PLC_ERR){
         switch (c) {
             case 'h':
                  plc_log(Usage);
@@ -152,6 +167,12 @@ int main(int argc, char **argv)
             case 'c':
                 cvalue = optarg;
                 break;
+            case 'v':
+                virtual = TRUE;
+                break;
+            case 'd':
+                dry = TRUE;
+                break;
             case '?':
                 plc_log(Usage);
                 if (optopt == 'c'){
@@ -178,35 +199,70 @@ int main(int argc, char **argv)
         plc_log("Invalid configuration file %s\n", cvalue);
         //return PLC_ERR;
     }
+    if(virtual){
+        conf = set_numeric_entry(CONFIG_VIRTUAL, TRUE, conf);
+    }
+    if(dry){
+        store_value(HW_TYPE, "DRY", edit_recursive_entry(CONFIG_HW, conf));
+    }
 //initialize PLC
     App = init_emu(conf);
     sequence_t programs = get_sequence_entry(CONFIG_PROGRAM, conf);
-    for(; programs && prog < programs->size; prog++){
-        if(programs->vars[prog].name){
-            App->plc = plc_load_program_file(programs->vars[prog].name, App->plc);
+    if(programs && programs->size > 0){
+        const char ** paths = (const char **)malloc(
+                                programs->size * sizeof(char *));
+        int n = 0;
+        for(; prog < programs->size; prog++){
+            if(programs->vars[prog].name){
+                paths[n++] = programs->vars[prog].name;
+            }
         }
+        App->plc = plc_load_program_files(paths, n, App->plc);
+        free(paths);
     }
 
 //start UI    
     ui_init(App->conf);
-    //UiReady=more;
-    config_t command = cli_init_command(conf);
-    config_t state = copy_config(conf);
-    ui_draw(state);
     if(conf->err == PLC_OK){
         App->plc = plc_start(App->plc);    
     }
-    while (get_numeric_entry(CLI_COM, command)!=COM_QUIT) {
+    modbus_init(conf, App->plc);
+    peer_init(conf, App->plc);
+    reactor_init(App->plc->step);
+    service_init(conf, App->plc);
+    config_t command = NULL;
+    int com = COM_NONE;
+    int ev = 0;
+    BYTE free_run = FALSE;
+    while (com != COM_QUIT) {
         
-        if(App->plc->update != 0){
-           state = get_state(App->plc, state);
-           ui_draw(state);
-           App->plc->update = 0;
-        }   
-        command = ui_update(command);
-        App = apply_command(command, App);
-        state = App->conf;
-        App->plc = plc_func(App->plc);
+        if(ev & EV_WAKE){//commands queued by the ui thread
+            while(com != COM_QUIT
+            && (command = service_command()) != NULL){
+                com = get_numeric_entry(CLI_COM, command);
+                if(com == COM_BATCH){
+                    App = apply_batch(service_batch(), App);
+                } else {
+                    App = apply_command(command, App);
+                }
+                if(com == COM_EDIT || com == COM_LOAD){
+                    service_reconfigure(App->plc, App->conf);
+                }
+                service_done();
+            }
+        }
+        if(ev & EV_CYCLE){
+            App->plc = plc_func(App->plc);
+            App->plc = modbus_update(App->plc);
+            App->plc = peer_update(App->plc);
+        }
+        App->plc = service_publish(App->plc);
+        free_run = plc_free_run(App->plc);
+        reactor_arm(!free_run);
+        ev = reactor_wait(!free_run);
+        if(free_run){
+            ev |= EV_CYCLE;
+        }
     }
     sigkill();
     App->plc = plc_stop(App->plc);
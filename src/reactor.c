@@ -0,0 +1,122 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+
+#include "util.h"
+#include "reactor.h"
+
+#define REACTOR_EVENTS 2 //descriptors, one slot each
+
+static int Epoll = PLC_ERR;
+static int Timer = PLC_ERR;
+static int Wake = PLC_ERR;
+static unsigned int Step = 0; //msecs
+static BYTE Armed = FALSE;
+static unsigned long Overruns = 0;
+
+static int watch(int fd, int ev)
+{
+    struct epoll_event e;
+    e.events = EPOLLIN;
+    e.data.u32 = ev;
+
+    return epoll_ctl(Epoll, EPOLL_CTL_ADD, fd, &e);
+}
+
+int reactor_init(unsigned int step)
+{
+    Step = step > 0 ? step : 1;
+    Epoll = epoll_create1(EPOLL_CLOEXEC);
+    Timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    Wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(Epoll < 0 || Timer < 0 || Wake < 0
+    || watch(Timer, EV_CYCLE) < 0
+    || watch(Wake, EV_WAKE) < 0){
+        plc_log("No epoll, the main loop polls every cycle");
+        reactor_end();
+
+        return PLC_ERR;
+    }
+    reactor_arm(TRUE);
+
+    return PLC_OK;
+}
+
+void reactor_arm(BYTE on)
+{
+    struct itimerspec t;
+    if(Timer < 0 || on == Armed){
+
+        return;
+    }
+    memset(&t, 0, sizeof(t));
+    if(on){
+        t.it_interval.tv_sec = Step / 1000;
+        t.it_interval.tv_nsec = (Step % 1000) * 1000000;
+        t.it_value = t.it_interval;
+    }
+    timerfd_settime(Timer, 0, &t, NULL);
+    Armed = on;
+}
+
+int reactor_wait(BYTE block)
+{
+    struct epoll_event e[REACTOR_EVENTS];
+    uint64_t count = 0;
+    int ev = 0;
+    int n = 0;
+    int i = 0;
+    if(Epoll < 0){//no reactor, a timed cycle that always checks for work
+        if(block){
+            usleep(Step * 1000);
+        }
+        return EV_CYCLE | EV_WAKE;
+    }
+    n = epoll_wait(Epoll, e, REACTOR_EVENTS, block ? -1 : 0);
+    for(; i < n; i++){
+        ev |= e[i].data.u32;
+    }
+    if((ev & EV_CYCLE)
+    && read(Timer, &count, sizeof(count)) == sizeof(count)
+    && count > 1){
+        Overruns += count - 1;
+    }
+    if(ev & EV_WAKE){
+        read(Wake, &count, sizeof(count));
+    }
+    return ev;
+}
+
+void reactor_wake()
+{
+    uint64_t one = 1;
+    if(Wake >= 0){
+        write(Wake, &one, sizeof(one));
+    }
+}
+
+unsigned long reactor_overruns()
+{
+    return Overruns;
+}
+
+void reactor_end()
+{
+    if(Epoll >= 0){
+        close(Epoll);
+    }
+    if(Timer >= 0){
+        close(Timer);
+    }
+    if(Wake >= 0){
+        close(Wake);
+    }
+    Epoll = Timer = Wake = PLC_ERR;
+    Armed = FALSE;
+}
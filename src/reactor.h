@@ -0,0 +1,50 @@
+#ifndef _REACTOR_H_
+#define _REACTOR_H_
+/**
+ *@file reactor.h
+ *@brief event loop of the emulator. The main loop sleeps in one epoll_wait()
+ * on a cycle timer and an eventfd that other threads signal, 
+ * and does work only for what became ready.
+*/
+
+typedef enum{
+    EV_CYCLE = 1, ///the cycle timer expired
+    EV_WAKE = 2   ///another thread asked for attention
+}EVENTS;
+
+/**
+ * @brief set up the event loop, the cycle timer starts armed
+ * @param cycle period in msecs
+ * @return OK or ERROR, the loop falls back to sleeping a period per wait
+ */
+int reactor_init(unsigned int step);
+
+/**
+ * @brief arm or disarm the cycle timer, for cycles that are not timed
+ * @param TRUE to arm it
+ */
+void reactor_arm(BYTE on);
+
+/**
+ * @brief wait for events
+ * @param FALSE to only check what is ready, without blocking
+ * @return mask of EVENTS
+ */
+int reactor_wait(BYTE block);
+
+/**
+ * @brief wake the event loop up, safe from any thread
+ */
+void reactor_wake();
+
+/**
+ * @return timer periods that passed without a cycle
+ */
+unsigned long reactor_overruns();
+
+/**
+ * @brief close all descriptors
+ */
+void reactor_end();
+
+#endif //_REACTOR_H_
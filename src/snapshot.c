@@ -0,0 +1,149 @@
+#include "config.h"
+#include "hardware.h"
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+#include "plclib.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_RETRIES 64
+
+snapshot_t new_snapshot(const plc_t p){
+    if(p == NULL){
+
+        return NULL;
+    }
+    snapshot_t s = (snapshot_t)malloc(sizeof(struct snapshot));
+    memset(s, 0, sizeof(struct snapshot));
+    s->ni = p->ni;
+    s->nq = p->nq;
+    s->nai = p->nai;
+    s->naq = p->naq;
+    s->nm = p->nm;
+    s->nmr = p->nmr;
+    s->nt = p->nt;
+    s->ns = p->ns;
+    s->inputs = (BYTE *)calloc(s->ni + 1, sizeof(BYTE));
+    s->outputs = (BYTE *)calloc(s->nq + 1, sizeof(BYTE));
+    s->real_in = (uint64_t *)calloc(s->nai + 1, sizeof(uint64_t));
+    s->real_out = (uint64_t *)calloc(s->naq + 1, sizeof(uint64_t));
+    s->m = (uint64_t *)calloc(s->nm + 1, sizeof(uint64_t));
+    s->mr = (double *)calloc(s->nmr + 1, sizeof(double));
+    s->ai = (double *)calloc(s->nai + 1, sizeof(double));
+    s->aq = (double *)calloc(s->naq + 1, sizeof(double));
+    s->t = (long *)calloc(s->nt + 1, sizeof(long));
+    s->t_out = (BYTE *)calloc(s->nt + 1, sizeof(BYTE));
+    s->s_out = (BYTE *)calloc(s->ns + 1, sizeof(BYTE));
+
+    return s;
+}
+
+snapshot_t clear_snapshot(snapshot_t s){
+    if(s){
+        free(s->inputs);
+        free(s->outputs);
+        free(s->real_in);
+        free(s->real_out);
+        free(s->m);
+        free(s->mr);
+        free(s->ai);
+        free(s->aq);
+        free(s->t);
+        free(s->t_out);
+        free(s->s_out);
+        free(s);
+    }
+    return NULL;
+}
+
+static void copy_image(const snapshot_t from, snapshot_t to){
+    to->status = from->status;
+    to->cycle = from->cycle;
+    memcpy(to->inputs, from->inputs, to->ni);
+    memcpy(to->outputs, from->outputs, to->nq);
+    memcpy(to->real_in, from->real_in, to->nai * sizeof(uint64_t));
+    memcpy(to->real_out, from->real_out, to->naq * sizeof(uint64_t));
+    memcpy(to->m, from->m, to->nm * sizeof(uint64_t));
+    memcpy(to->mr, from->mr, to->nmr * sizeof(double));
+    memcpy(to->ai, from->ai, to->nai * sizeof(double));
+    memcpy(to->aq, from->aq, to->naq * sizeof(double));
+    memcpy(to->t, from->t, to->nt * sizeof(long));
+    memcpy(to->t_out, from->t_out, to->nt);
+    memcpy(to->s_out, from->s_out, to->ns);
+}
+
+void publish_snapshot(const plc_t p, snapshot_t s){
+    int i = 0;
+    if(p == NULL
+    || s == NULL
+    || s->ni != p->ni
+    || s->nq != p->nq
+    || s->nai != p->nai
+    || s->naq != p->naq
+    || s->nm != p->nm
+    || s->nmr != p->nmr
+    || s->nt != p->nt
+    || s->ns != p->ns){
+    //reconfigured plc, the snapshot does not fit any more
+        return;
+    }
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    s->status = p->status;
+    s->cycle++;
+    memset(s->inputs, 0, s->ni);
+    for(i = 0; i < BYTESIZE * p->ni; i++){
+        s->inputs[i / BYTESIZE] |= p->di[i].I << i % BYTESIZE;
+    }
+    memset(s->outputs, 0, s->nq);
+    for(i = 0; i < BYTESIZE * p->nq; i++){
+        //as driven to the hardware, forced
+        BYTE q = (p->dq[i].Q || p->dq[i].MASK) && !p->dq[i].N_MASK;
+        s->outputs[i / BYTESIZE] |= q << i % BYTESIZE;
+    }
+    memcpy(s->real_in, p->real_in, s->nai * sizeof(uint64_t));
+    memcpy(s->real_out, p->real_out, s->naq * sizeof(uint64_t));
+    for(i = 0; i < p->nm; i++){
+        s->m[i] = p->m[i].V;
+    }
+    for(i = 0; i < p->nmr; i++){
+        s->mr[i] = p->mr[i].V;
+    }
+    for(i = 0; i < p->nai; i++){
+        s->ai[i] = p->ai[i].V;
+    }
+    for(i = 0; i < p->naq; i++){
+        s->aq[i] = p->aq[i].V;
+    }
+    for(i = 0; i < p->nt; i++){
+        s->t[i] = p->t[i].V;
+        s->t_out[i] = p->t[i].Q;
+    }
+    for(i = 0; i < p->ns; i++){
+        s->s_out[i] = p->s[i].Q;
+    }
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+int read_snapshot(const snapshot_t s, snapshot_t copy){
+    int i = 0;
+    if(s == NULL || copy == NULL){
+
+        return PLC_ERR;
+    }
+    for(; i < SNAPSHOT_RETRIES; i++){
+        unsigned int seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if(seq % 2){
+            continue;
+        }
+        copy_image(s, copy);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq){
+            copy->seq = seq;
+
+            return PLC_OK;
+        }
+    }
+    return PLC_ERR;
+}
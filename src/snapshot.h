@@ -0,0 +1,67 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+/**
+ *@file snapshot.h
+ *@brief consistent copies of the process image for other threads.
+ * The scan thread publishes under a sequence lock and never waits;
+ * readers copy and retry if a cycle was published meanwhile.
+*/
+
+/**
+ * @brief process image, as seen by the program at the end of a cycle
+ */
+typedef struct snapshot{
+    unsigned int seq; ///sequence lock, odd while being published
+    int status; ///plc status
+    unsigned long cycle; ///cycles published so far
+    BYTE ni; ///bytes of digital inputs
+    BYTE nq; ///bytes of digital outputs
+    BYTE nai; ///analog input channels
+    BYTE naq; ///analog output channels
+    BYTE nm; ///memory counters
+    BYTE nmr; ///real memory registers
+    BYTE nt; ///timers
+    BYTE ns; ///blinkers
+    BYTE * inputs; ///%i bits, packed
+    BYTE * outputs; ///%q bits, packed
+    uint64_t * real_in; ///raw analog inputs
+    uint64_t * real_out; ///raw analog outputs
+    uint64_t * m; ///%m values
+    double * mr; ///%mf values
+    double * ai; ///analog inputs, scaled
+    double * aq; ///analog outputs, scaled
+    long * t; ///timer values
+    BYTE * t_out; ///timer outputs, one per byte
+    BYTE * s_out; ///blinker outputs, one per byte
+} * snapshot_t;
+
+/**
+ * @brief allocate a snapshot that fits a plc
+ * @param the plc
+ * @return newly allocated snapshot
+ */
+snapshot_t new_snapshot(const plc_t p);
+
+/**
+ * @brief free a snapshot
+ * @param the snapshot
+ * @return NULL
+ */
+snapshot_t clear_snapshot(snapshot_t s);
+
+/**
+ * @brief publish the plc state, only from the scan thread
+ * @param the plc
+ * @param the shared snapshot
+ */
+void publish_snapshot(const plc_t p, snapshot_t s);
+
+/**
+ * @brief take a consistent copy of a published snapshot
+ * @param the shared snapshot
+ * @param private copy, allocated for the same plc
+ * @return PLC_OK or PLC_ERR if the publisher kept interfering
+ */
+int read_snapshot(const snapshot_t s, snapshot_t copy);
+
+#endif //_SNAPSHOT_H_
@@ -14,13 +14,27 @@
 #include "plclib.h"
 #include "plcemu.h"
 #include "config.h"
+#include "snapshot.h"
+#include "wire.h"
 #include "ui.h"
 
 /*************GLOBALS************************************************/
 
 char * Cli_buf = NULL; 
 char * Response_buf = NULL;
-char * Update_buf = NULL;
+
+const char * WireNames[N_WIRE_BLOCKS] = {
+    "",
+    "%i byte",
+    "%q byte",
+    "%ai",
+    "%aq",
+    "%m",
+    "%mf",
+    "%t",
+    "%t out byte",
+    "%s out byte"
+};
 
 pthread_t Reader;
 config_t init_config(){
@@ -79,9 +93,29 @@ void * read_cli(void * sock) {
     char * b = NULL;
     
     config_t command = cli_init_command(init_config());
+    struct wire_batch batch;
+    BYTE bin[WIRE_BATCH_MAX];
     while(getline((char **)&b, &l, stdin)>=0){
+        if(!strncasecmp(b, "BATCH ", 6)){//binary, many variables at once
+            if(wire_batch(b + 6, &batch) == PLC_OK){
+                zmq_send(sock, bin, wire_encode_batch(&batch, bin), 0);
+                int n = zmq_recv(sock, Response_buf, CONF_STR - 1, 0);
+                printf("Response:\n %.*s\n", n > 0 ? n : 0, Response_buf);
+            } else {
+                printf("Invalid batch\n");
+            }
+            free(b);
+            b = NULL;
+            continue;
+        }
         command = cli_parse(b, command);
         char * serialized = serialize_config(command);
+        if(serialized == NULL){
+            printf("Invalid command\n");
+            free(b);
+            b = NULL;
+            continue;
+        }
         printf("Sending... \n%s\n", serialized);
         zmq_send (sock, 
                   serialized, 
@@ -99,13 +133,99 @@ void * read_cli(void * sock) {
     return NULL;
 }
 
+static void print_record(BYTE block, unsigned int index, 
+                         uint64_t value, void * arg)
+{
+    if(block >= N_WIRE_BLOCKS){
+        
+        return;
+    }
+    switch(block){
+        case WIRE_AI:
+        case WIRE_AQ:
+        case WIRE_MR:
+            printf("  %s %d: %f\n", WireNames[block], index, wire_real(value));
+            break;
+        case WIRE_M:
+        case WIRE_T:
+            printf("  %s %d: %ld\n", WireNames[block], index, (long)value);
+            break;
+        default:
+            printf("  %s %d: 0x%02x\n", WireNames[block], index, 
+                   (unsigned int)value);
+    }
+}
+
+/**
+ * @brief print a state message
+ * @param the subscriber, to ask for a keyframe after a gap
+ * @param the message
+ */
+static void update(void * subscriber, zmq_msg_t * msg)
+{
+    static BYTE synced = FALSE;
+    static unsigned int last = 0;
+    struct wire_header h;
+    const BYTE * data = (const BYTE *)zmq_msg_data(msg);
+    unsigned int len = zmq_msg_size(msg);
+    if(len < 2 || memcmp(data, WIRE_MAGIC, 2)){//state document
+        printf("Update:\n %.*s\n", len, (const char *)data);
+        
+        return;
+    }
+    if(wire_decode(data, len, &h, NULL, NULL) < PLC_OK){
+        printf("Malformed update\n");
+        
+        return;
+    }
+    if(h.kind == WIRE_DELTA && (!synced || h.seq != last + 1)){
+        if(synced){//subscribing again makes the plc send a keyframe
+            printf("Lost updates, resynchronizing...\n");
+            zmq_setsockopt(subscriber, ZMQ_SUBSCRIBE, WIRE_MAGIC, 2);
+        }
+        synced = FALSE;
+        
+        return;
+    }
+    synced = TRUE;
+    last = h.seq;
+    printf("%s %d, cycle %d, status %d:\n", 
+           h.kind == WIRE_KEY ? "Keyframe" : "Update", 
+           h.seq, h.cycle, h.status);
+    wire_decode(data, len, &h, print_record, NULL);
+}
+
+/**
+ * @brief print the message of a watch list, that follows its topic
+ * @param the subscriber
+ * @param the topic frame
+ */
+static void update_watch(void * subscriber, zmq_msg_t * topic)
+{
+    zmq_msg_t msg;
+    struct wire_header h;
+    zmq_msg_init(&msg);
+    if(zmq_msg_more(topic)
+    && zmq_msg_recv(&msg, subscriber, 0) >= 0
+    && wire_decode((const BYTE *)zmq_msg_data(&msg), zmq_msg_size(&msg), 
+                   &h, NULL, NULL) == PLC_OK){
+        printf("Watch %.*s %s %d, cycle %d:\n", 
+               (int)zmq_msg_size(topic) - 2, 
+               (const char *)zmq_msg_data(topic) + 2,
+               h.kind == WIRE_KEY ? "sample" : "update", h.seq, h.cycle);
+        wire_decode((const BYTE *)zmq_msg_data(&msg), zmq_msg_size(&msg), 
+                    &h, print_record, NULL);
+    }
+    zmq_msg_close(&msg);
+}
+
 //  UI client
 
 int main (void)
 {    
+    zmq_msg_t msg;
     Cli_buf = (char*)malloc(CONF_STR);
     Response_buf = (char*)malloc(CONF_STR);
-    Update_buf = (char*)malloc(CONF_STR);
     memset(Cli_buf, 0, CONF_STR);
 
     void *context = zmq_ctx_new ();
@@ -116,16 +236,23 @@ int main (void)
     zmq_connect (requester, "tcp://localhost:5555");
     zmq_connect (subscriber, "tcp://localhost:5556");
     zmq_setsockopt (subscriber, ZMQ_SUBSCRIBE, "---", 3);
+    zmq_setsockopt (subscriber, ZMQ_SUBSCRIBE, WIRE_MAGIC, 2);
+    zmq_setsockopt (subscriber, ZMQ_SUBSCRIBE, WIRE_WATCH, 2);
     pthread_create(&Reader, NULL, read_cli, requester);
     
+    zmq_msg_init(&msg);
     for(;;){
-        if(zmq_recv (subscriber, 
-                    Update_buf, 
-                    CONF_STR, 
-                    ZMQ_DONTWAIT)>=0){ 
-            printf("Update:\n %s\n", Update_buf);
+        if(zmq_msg_recv(&msg, subscriber, 0) < 0){ 
+            continue;
+        }
+        if(zmq_msg_size(&msg) >= 2
+        && !memcmp(zmq_msg_data(&msg), WIRE_WATCH, 2)){
+            update_watch(subscriber, &msg);
+        } else {
+            update(subscriber, &msg);
         }
     }
+    zmq_msg_close(&msg);
     zmq_close (subscriber);
     zmq_close (requester);
     zmq_ctx_destroy (context);
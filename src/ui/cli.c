@@ -7,6 +7,8 @@
 #include "instruction.h"
 #include "rung.h"
 #include "plclib.h"
+#include "snapshot.h"
+#include "wire.h"
 
 #include "ui.h"
 #include "util.h"
@@ -27,7 +29,10 @@ const char * Command[N_COM] = {
         "LOAD",
         "SAVE",
         "CONFIG",
-        "QUIT"
+        "QUIT",
+        "WATCH",
+        "UNWATCH",
+        "BATCH"
 };
 
 struct entry CommandSchema[N_PAYLOADS] = {
@@ -45,6 +50,20 @@ struct entry CommandSchema[N_PAYLOADS] = {
               .conf = NULL
          }
     },
+    {//CLI_WATCH,
+         .type_tag = ENTRY_STR,
+         .name = "WATCH",
+         .e = {
+              .scalar_str = ""
+         }
+    },
+    {//CLI_EDIT,
+         .type_tag = ENTRY_STR,
+         .name = "EDIT",
+         .e = {
+              .scalar_str = ""
+         }
+    },
 };
 
 struct entry StatusSchema[N_PAYLOADS] = {
@@ -62,6 +81,20 @@ struct entry StatusSchema[N_PAYLOADS] = {
               .conf = NULL
          }
     },
+    {//CLI_WATCH,
+         .type_tag = ENTRY_STR,
+         .name = "WATCH",
+         .e = {
+              .scalar_str = ""
+         }
+    },
+    {//CLI_EDIT,
+         .type_tag = ENTRY_STR,
+         .name = "EDIT",
+         .e = {
+              .scalar_str = ""
+         }
+    },
 };
 
 void print_help()
@@ -103,14 +136,18 @@ void cli_header()
 config_t cli_init_command(config_t conf){
     
     config_t com = init_config(CommandSchema, N_PAYLOADS);
-    com = set_recursive_entry(CLI_ARG, copy_config(conf), com);
+    config_t arg = copy_config(conf);
+    com = set_recursive_entry(CLI_ARG, arg, com);
+    clear_config(arg);
     return com;
 }
 
 config_t cli_init_state(config_t conf){
 
     config_t stat = init_config(StatusSchema, N_PAYLOADS);
-    stat = set_recursive_entry(CLI_ARG, copy_config(conf), stat);
+    config_t arg = copy_config(conf);
+    stat = set_recursive_entry(CLI_ARG, arg, stat);
+    clear_config(arg);
     
     return stat;
 }
@@ -128,6 +165,7 @@ config_t cli_parse( char * input, config_t command){
         return command;
     }
     command = set_numeric_entry(CLI_COM, COM_NONE, command);
+    command = store_value(CLI_EDIT, "", command);
     config_t arg = get_recursive_entry(CLI_ARG, res);
     
     strtok(input, " \n");
@@ -219,9 +257,23 @@ config_t cli_parse( char * input, config_t command){
                                  key,
                                  value);
             if(res){                                          
+                char edit[MAXSTR];
+                snprintf(edit, MAXSTR, "%s %s %s %s", 
+                         block, index, key, value);
+                command = store_value(CLI_EDIT, edit, command);
                 command = set_numeric_entry(CLI_COM, COM_EDIT, command);
             }
         }
+    } else if(!strncasecmp(input, Command[COM_WATCH] , 4)
+           || !strncasecmp(input, Command[COM_UNWATCH] , 4)){
+        //the ui parses the rest, "name period block index..." or "name"
+        int com = strncasecmp(input, Command[COM_WATCH] , 4) ? 
+                  COM_UNWATCH : COM_WATCH;
+        value = strtok(NULL, "\n");
+        if(value != NULL){
+            command = store_value(CLI_WATCH, value, command);
+            command = set_numeric_entry(CLI_COM, com, command);
+        }
     }//TODO: CONF command
     /*if(get_numeric_entry(CLI_COM, command)!=COM_NONE){
         char * serialized = serialize_config(command);
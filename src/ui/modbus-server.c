@@ -0,0 +1,609 @@
+#define _GNU_SOURCE //accept4
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "config.h"
+#include "schema.h"
+#include "hardware.h"
+#include "util.h"
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+#include "plclib.h"
+#include "snapshot.h"
+#include "modbus.h"
+
+#define MB_OUTBUF (16 * MB_ADU) //pipelined responses per client
+#define MB_CLIENTS 256
+#define MB_EVENTS 64
+#define MB_WRITES 2048 //queued writes, a full coil or register request fits
+
+#define MB_WORDS 4 //registers per 64 bit value
+#define MB_WORD_BITS 16
+
+typedef struct mb_client{
+    int fd;
+    int slot;
+    unsigned int events; ///epoll interest
+    unsigned int in_len;
+    unsigned int out_len;
+    unsigned int out_sent;
+    BYTE in[MB_ADU];
+    BYTE out[MB_OUTBUF];
+} * mb_client_t;
+
+/**
+ * @brief a client write, applied by the scan thread
+ */
+struct mb_write{
+    BYTE coil; ///coil or holding register
+    unsigned short address;
+    unsigned short value;
+};
+
+static int Listen = PLC_ERR;
+static int Wake = PLC_ERR;
+static int Epoll = PLC_ERR;
+static int Unit = MB_ANY_UNIT;
+static pthread_t Server;
+static int Serving = FALSE;
+
+static mb_client_t Clients[MB_CLIENTS];
+
+//published by the scan thread, copied by the server
+static snapshot_t Published = NULL;
+static snapshot_t View = NULL; //what is served
+static snapshot_t Next = NULL; //read into, and swapped with View if whole
+
+static struct mb_write Writes[MB_WRITES];
+static unsigned int WriteHead = 0;
+static unsigned int WriteTail = 0;
+static pthread_mutex_t WriteLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief queue writes, all or none
+ * @return OK or ERROR if the scan thread is lagging behind
+ */
+static int queue_writes(const struct mb_write * w, unsigned int n)
+{
+    unsigned int i = 0;
+    pthread_mutex_lock(&WriteLock);
+    if(WriteTail - WriteHead + n > MB_WRITES){
+        pthread_mutex_unlock(&WriteLock);
+
+        return PLC_ERR;
+    }
+    for(; i < n; i++){
+        Writes[WriteTail++ % MB_WRITES] = w[i];
+    }
+    pthread_mutex_unlock(&WriteLock);
+
+    return PLC_OK;
+}
+
+static unsigned int n_coils(const snapshot_t s)
+{
+    return BYTESIZE * s->nq;
+}
+
+static unsigned int n_discrete(const snapshot_t s)
+{
+    return BYTESIZE * s->ni;
+}
+
+static unsigned int n_holding(const snapshot_t s)
+{
+    return MB_WORDS * (s->nm + s->nmr);
+}
+
+static unsigned int n_input(const snapshot_t s)
+{
+    return MB_WORDS * (s->nai + s->naq);
+}
+
+static unsigned int word_shift(unsigned int reg)
+{
+    return MB_WORD_BITS * (MB_WORDS - 1 - reg % MB_WORDS);
+}
+
+static unsigned int get_holding(const snapshot_t s, unsigned int reg)
+{
+    unsigned int v = reg / MB_WORDS;
+    uint64_t bits = 0;
+    if(v < s->nm){
+        bits = s->m[v];
+    } else {
+        memcpy(&bits, &s->mr[v - s->nm], sizeof(bits));
+    }
+    return (bits >> word_shift(reg)) & 0xFFFF;
+}
+
+static unsigned int get_input(const snapshot_t s, unsigned int reg)
+{
+    unsigned int v = reg / MB_WORDS;
+    uint64_t bits = v < s->nai ? s->real_in[v] : s->real_out[v - s->nai];
+
+    return (bits >> word_shift(reg)) & 0xFFFF;
+}
+
+/**
+ * @brief the pdu handlers return the response pdu length,
+ * or a negative exception code
+ */
+static int read_bits(const BYTE * bits,
+                     unsigned int count,
+                     const BYTE * pdu,
+                     BYTE * rsp)
+{
+    unsigned int address = mb_get16(pdu + 1);
+    unsigned int qty = mb_get16(pdu + 3);
+    unsigned int i = 0;
+    if(qty < 1 || qty > MB_MAX_READ_BITS){
+
+        return -MB_ILLEGAL_VALUE;
+    }
+    if(address + qty > count){
+
+        return -MB_ILLEGAL_ADDRESS;
+    }
+    rsp[0] = pdu[0];
+    rsp[1] = (qty + BYTESIZE - 1) / BYTESIZE;
+    memset(rsp + 2, 0, rsp[1]);
+    for(; i < qty; i++){
+        unsigned int n = address + i;
+        if((bits[n / BYTESIZE] >> n % BYTESIZE) % 2){
+            rsp[2 + i / BYTESIZE] |= 1 << i % BYTESIZE;
+        }
+    }
+    return 2 + rsp[1];
+}
+
+static int read_registers(unsigned int (*get)(const snapshot_t, unsigned int),
+                          unsigned int count,
+                          const BYTE * pdu,
+                          BYTE * rsp)
+{
+    unsigned int address = mb_get16(pdu + 1);
+    unsigned int qty = mb_get16(pdu + 3);
+    unsigned int i = 0;
+    if(qty < 1 || qty > MB_MAX_READ_REGS){
+
+        return -MB_ILLEGAL_VALUE;
+    }
+    if(address + qty > count){
+
+        return -MB_ILLEGAL_ADDRESS;
+    }
+    rsp[0] = pdu[0];
+    rsp[1] = 2 * qty;
+    for(; i < qty; i++){
+        mb_put16(rsp + 2 + 2 * i, get(View, address + i));
+    }
+    return 2 + rsp[1];
+}
+
+static int write_single(const BYTE * pdu, BYTE * rsp)
+{
+    struct mb_write w;
+    w.coil = pdu[0] == MB_WRITE_COIL;
+    w.address = mb_get16(pdu + 1);
+    w.value = mb_get16(pdu + 3);
+    if(w.coil && w.value != MB_COIL_ON && w.value != 0){
+
+        return -MB_ILLEGAL_VALUE;
+    }
+    if(w.address >= (w.coil ? n_coils(View) : n_holding(View))){
+
+        return -MB_ILLEGAL_ADDRESS;
+    }
+    if(queue_writes(&w, 1) < 0){
+
+        return -MB_BUSY;
+    }
+    memcpy(rsp, pdu, 5); //echo
+    return 5;
+}
+
+static int write_multiple(const BYTE * pdu, unsigned int len, BYTE * rsp)
+{
+    static struct mb_write w[MB_MAX_WRITE_BITS];
+    BYTE coil = pdu[0] == MB_WRITE_COILS;
+    unsigned int address = mb_get16(pdu + 1);
+    unsigned int qty = mb_get16(pdu + 3);
+    unsigned int bytes = pdu[5];
+    unsigned int i = 0;
+    if(qty < 1
+    || qty > (coil ? MB_MAX_WRITE_BITS : MB_MAX_WRITE_REGS)
+    || bytes != (coil ? (qty + BYTESIZE - 1) / BYTESIZE : 2 * qty)
+    || len < 6 + bytes){
+
+        return -MB_ILLEGAL_VALUE;
+    }
+    if(address + qty > (coil ? n_coils(View) : n_holding(View))){
+
+        return -MB_ILLEGAL_ADDRESS;
+    }
+    for(; i < qty; i++){
+        w[i].coil = coil;
+        w[i].address = address + i;
+        w[i].value = coil ? (pdu[6 + i / BYTESIZE] >> i % BYTESIZE) % 2
+                          : mb_get16(pdu + 6 + 2 * i);
+    }
+    if(queue_writes(w, qty) < 0){
+
+        return -MB_BUSY;
+    }
+    memcpy(rsp, pdu, 5);
+    return 5;
+}
+
+static int process_pdu(const BYTE * pdu, unsigned int len, BYTE * rsp)
+{
+    //every supported function starts with an address and a quantity
+    if(len < 5
+    && ((pdu[0] >= MB_READ_COILS && pdu[0] <= MB_WRITE_REGISTER)
+     || pdu[0] == MB_WRITE_COILS
+     || pdu[0] == MB_WRITE_REGISTERS)){
+
+        return -MB_ILLEGAL_VALUE;
+    }
+    switch(pdu[0]){
+        case MB_READ_COILS:
+            return read_bits(View->outputs, n_coils(View), pdu, rsp);
+        case MB_READ_DISCRETE:
+            return read_bits(View->inputs, n_discrete(View), pdu, rsp);
+        case MB_READ_HOLDING:
+            return read_registers(get_holding, n_holding(View), pdu, rsp);
+        case MB_READ_INPUT:
+            return read_registers(get_input, n_input(View), pdu, rsp);
+        case MB_WRITE_COIL:
+        case MB_WRITE_REGISTER:
+            return write_single(pdu, rsp);
+        case MB_WRITE_COILS:
+        case MB_WRITE_REGISTERS:
+            return len < 6 ? -MB_ILLEGAL_VALUE : write_multiple(pdu, len, rsp);
+        default:
+            return -MB_ILLEGAL_FUNCTION;
+    }
+}
+
+/**
+ * @brief answer one frame
+ * @param request adu
+ * @param response buffer, fits the largest adu
+ * @return response length
+ */
+static unsigned int process_frame(const BYTE * req, BYTE * rsp)
+{
+    unsigned int len = mb_get16(req + 4) - 1; //pdu after the unit
+    int r = 0;
+    memcpy(rsp, req, MB_MBAP);
+    if(Unit != MB_ANY_UNIT
+    && req[6] != Unit
+    && req[6] != MB_ANY_UNIT){
+        r = -MB_NO_TARGET;
+    } else {
+        r = process_pdu(req + MB_MBAP, len, rsp + MB_MBAP);
+    }
+    if(r < 0){
+        rsp[MB_MBAP] = req[MB_MBAP] | 0x80;
+        rsp[MB_MBAP + 1] = -r;
+        r = 2;
+    }
+    mb_put16(rsp + 4, r + 1);
+
+    return MB_MBAP + r;
+}
+
+static void close_client(mb_client_t c)
+{
+    epoll_ctl(Epoll, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    Clients[c->slot] = NULL;
+    free(c);
+}
+
+/**
+ * @brief take requests while there is room for their responses
+ * @return OK or ERROR if the client should be dropped
+ */
+static int receive(mb_client_t c)
+{
+    for(;;){
+        while(c->in_len >= MB_MBAP
+        && c->out_len + MB_ADU <= MB_OUTBUF){
+            unsigned int len = mb_get16(c->in + 4);
+            if(mb_get16(c->in + 2) != 0 //not modbus
+            || len < 2
+            || len > MB_ADU - MB_MBAP + 1){
+
+                return PLC_ERR;
+            }
+            unsigned int size = MB_MBAP - 1 + len;
+            if(c->in_len < size){
+                break;
+            }
+            c->out_len += process_frame(c->in, c->out + c->out_len);
+            c->in_len -= size;
+            memmove(c->in, c->in + size, c->in_len);
+        }
+        if(c->out_len + MB_ADU > MB_OUTBUF){ //wait until the client reads
+
+            return PLC_OK;
+        }
+        ssize_t n = recv(c->fd, c->in + c->in_len, MB_ADU - c->in_len, 0);
+        if(n == 0){
+
+            return PLC_ERR;
+        }
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? PLC_OK : PLC_ERR;
+        }
+        c->in_len += n;
+    }
+}
+
+static int transmit(mb_client_t c)
+{
+    while(c->out_sent < c->out_len){
+        ssize_t n = send(c->fd,
+                         c->out + c->out_sent,
+                         c->out_len - c->out_sent,
+                         MSG_NOSIGNAL);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? PLC_OK : PLC_ERR;
+        }
+        c->out_sent += n;
+    }
+    c->out_len = 0;
+    c->out_sent = 0;
+
+    return PLC_OK;
+}
+
+static void serve_client(mb_client_t c, unsigned int events)
+{
+    struct epoll_event ev;
+    if(events & (EPOLLERR | EPOLLHUP)
+    || transmit(c) < 0
+    || receive(c) < 0
+    || transmit(c) < 0){
+        close_client(c);
+
+        return;
+    }
+    //stop reading from clients that do not read their responses
+    ev.events = (c->out_len + MB_ADU <= MB_OUTBUF ? EPOLLIN : 0)
+              | (c->out_len > 0 ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    if(ev.events != c->events){
+        c->events = ev.events;
+        epoll_ctl(Epoll, EPOLL_CTL_MOD, c->fd, &ev);
+    }
+}
+
+static void accept_clients()
+{
+    struct epoll_event ev;
+    int fd = PLC_ERR;
+    int on = 1;
+    while((fd = accept4(Listen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0){
+        int slot = 0;
+        while(slot < MB_CLIENTS && Clients[slot]){
+            slot++;
+        }
+        if(slot == MB_CLIENTS){
+            plc_log("Too many modbus clients");
+            close(fd);
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        mb_client_t c = (mb_client_t)malloc(sizeof(struct mb_client));
+        memset(c, 0, sizeof(struct mb_client));
+        c->fd = fd;
+        c->slot = slot;
+        c->events = EPOLLIN;
+        ev.events = c->events;
+        ev.data.ptr = c;
+        if(epoll_ctl(Epoll, EPOLL_CTL_ADD, fd, &ev) < 0){
+            close(fd);
+            free(c);
+            continue;
+        }
+        Clients[slot] = c;
+    }
+}
+
+static void * serve(void * arg)
+{
+    struct epoll_event ev[MB_EVENTS];
+    int i = 0;
+    int more = TRUE;
+    while(more){
+        int n = epoll_wait(Epoll, ev, MB_EVENTS, -1);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            break;
+        }
+        //one consistent image per batch; if the scan kept publishing
+        //throughout, the last whole image is served again
+        if(read_snapshot(Published, Next) == PLC_OK){
+            snapshot_t served = View;
+            View = Next;
+            Next = served;
+        }
+        for(i = 0; i < n; i++){
+            if(ev[i].data.ptr == &Wake){
+                more = FALSE;
+            } else if(ev[i].data.ptr == &Listen){
+                accept_clients();
+            } else {
+                serve_client((mb_client_t)ev[i].data.ptr, ev[i].events);
+            }
+        }
+    }
+    for(i = 0; i < MB_CLIENTS; i++){
+        if(Clients[i]){
+            close_client(Clients[i]);
+        }
+    }
+    return NULL;
+}
+
+static void apply_write(plc_t p, const struct mb_write * w)
+{
+    if(w->coil){
+        if(w->address < BYTESIZE * p->nq){
+            //a coil written from scada stays forced
+            p->dq[w->address].MASK = w->value > 0;
+            p->dq[w->address].N_MASK = w->value == 0;
+            p->update |= CHANGED_O;
+        }
+        return;
+    }
+    unsigned int v = w->address / MB_WORDS;
+    uint64_t mask = (uint64_t)0xFFFF << word_shift(w->address);
+    uint64_t word = (uint64_t)w->value << word_shift(w->address);
+    if(v < p->nm){
+        if(!p->m[v].RO){
+            p->m[v].V = (p->m[v].V & ~mask) | word;
+            p->update |= CHANGED_M;
+        }
+    } else if(v - p->nm < p->nmr && !p->mr[v - p->nm].RO){
+        uint64_t bits = 0;
+        memcpy(&bits, &p->mr[v - p->nm].V, sizeof(bits));
+        bits = (bits & ~mask) | word;
+        memcpy(&p->mr[v - p->nm].V, &bits, sizeof(bits));
+        p->update |= CHANGED_M;
+    }
+}
+
+plc_t modbus_update(plc_t p)
+{
+    if(Published == NULL || p == NULL){
+
+        return p;
+    }
+    publish_snapshot(p, Published);
+    //never wait for the server, its writes can wait for the next cycle
+    if(pthread_mutex_trylock(&WriteLock) == 0){
+        for(; WriteHead != WriteTail; WriteHead++){
+            apply_write(p, &Writes[WriteHead % MB_WRITES]);
+        }
+        pthread_mutex_unlock(&WriteLock);
+    }
+    return p;
+}
+
+static int open_listener(int port)
+{
+    struct sockaddr_in addr;
+    int on = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+
+        return PLC_ERR;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+    || listen(fd, SOMAXCONN) < 0){
+        close(fd);
+
+        return PLC_ERR;
+    }
+    return fd;
+}
+
+int modbus_init(const config_t conf, const plc_t p)
+{
+    config_t mb = get_recursive_entry(CONFIG_MODBUS, conf);
+    int port = get_numeric_entry(MODBUS_PORT, mb);
+    struct epoll_event ev;
+    sigset_t all;
+    sigset_t old;
+    if(port <= 0 || p == NULL){ //disabled
+
+        return PLC_OK;
+    }
+    Unit = get_numeric_entry(MODBUS_UNIT, mb);
+    Listen = open_listener(port);
+    Epoll = epoll_create1(EPOLL_CLOEXEC);
+    Wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(Listen < 0 || Epoll < 0 || Wake < 0){
+        plc_log("Failed to serve modbus on port %d: %s", port, strerror(errno));
+        modbus_end();
+
+        return PLC_ERR;
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = &Listen;
+    epoll_ctl(Epoll, EPOLL_CTL_ADD, Listen, &ev);
+    ev.data.ptr = &Wake;
+    epoll_ctl(Epoll, EPOLL_CTL_ADD, Wake, &ev);
+
+    Published = new_snapshot(p);
+    View = new_snapshot(p);
+    Next = new_snapshot(p);
+    publish_snapshot(p, Published);
+    read_snapshot(Published, View);
+    WriteHead = WriteTail = 0;
+
+    //signals are for the scan thread
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int r = pthread_create(&Server, NULL, serve, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if(r != 0){
+        plc_log("Failed to start modbus server");
+        modbus_end();
+
+        return PLC_ERR;
+    }
+    Serving = TRUE;
+    plc_log("Modbus server on port %d", port);
+
+    return PLC_OK;
+}
+
+void modbus_end()
+{
+    uint64_t one = 1;
+    if(Serving
+    && write(Wake, &one, sizeof(one)) == sizeof(one)){
+        pthread_join(Server, NULL);
+    }
+    Serving = FALSE;
+    if(Listen >= 0){
+        close(Listen);
+    }
+    if(Wake >= 0){
+        close(Wake);
+    }
+    if(Epoll >= 0){
+        close(Epoll);
+    }
+    Listen = Wake = Epoll = PLC_ERR;
+    Published = clear_snapshot(Published);
+    View = clear_snapshot(View);
+    Next = clear_snapshot(Next);
+}
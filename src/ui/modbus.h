@@ -0,0 +1,79 @@
+#ifndef _MODBUS_H_
+#define _MODBUS_H_
+/**
+ *@file modbus.h
+ *@brief Modbus TCP protocol, and a server 
+ * that exposes the process image to SCADA clients
+ *
+ * coils              %q bits
+ * discrete inputs    %i bits
+ * holding registers  %m, then %mf, 4 registers per value, high word first
+ * input registers    raw analog inputs, then raw analog outputs,
+ *                    4 registers per channel, high word first
+*/
+
+#define MB_PORT 502
+
+#define MB_MBAP 7 //transaction, protocol, length, unit
+#define MB_ADU 260 //largest frame
+#define MB_MAX_READ_BITS 2000
+#define MB_MAX_WRITE_BITS 1968
+#define MB_MAX_READ_REGS 125
+#define MB_MAX_WRITE_REGS 123
+#define MB_COIL_ON 0xFF00
+#define MB_ANY_UNIT 0xFF
+
+typedef enum{
+    MB_READ_COILS = 1,
+    MB_READ_DISCRETE = 2,
+    MB_READ_HOLDING = 3,
+    MB_READ_INPUT = 4,
+    MB_WRITE_COIL = 5,
+    MB_WRITE_REGISTER = 6,
+    MB_WRITE_COILS = 15,
+    MB_WRITE_REGISTERS = 16
+}MB_FUNCTIONS;
+
+typedef enum{
+    MB_ILLEGAL_FUNCTION = 1,
+    MB_ILLEGAL_ADDRESS = 2,
+    MB_ILLEGAL_VALUE = 3,
+    MB_BUSY = 6,
+    MB_NO_TARGET = 0x0B
+}MB_EXCEPTIONS;
+
+static inline unsigned int mb_get16(const unsigned char * b)
+{
+    return (b[0] << 8) | b[1];
+}
+
+static inline void mb_put16(unsigned char * b, unsigned int v)
+{
+    b[0] = (v >> 8) & 0xFF;
+    b[1] = v & 0xFF;
+}
+
+/*****************server*****************************************/
+
+/**
+ * @brief start serving on a separate thread, if a port is configured
+ * @param system configuration
+ * @param the plc
+ * @return OK or ERROR
+ */
+int modbus_init(const config_t conf, const plc_t p);
+
+/**
+ * @brief publish the state and apply queued client writes,
+ * called from the scan loop once per cycle, never blocks
+ * @param the plc
+ * @return the plc
+ */
+plc_t modbus_update(plc_t p);
+
+/**
+ * @brief stop the server and disconnect all clients
+ */
+void modbus_end();
+
+#endif //_MODBUS_H_
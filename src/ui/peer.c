@@ -0,0 +1,402 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "config.h"
+#include "schema.h"
+#include "hardware.h"
+#include "util.h"
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+#include "plclib.h"
+#include "peer.h"
+
+#define PEER_DESTINATIONS 16
+#define PEER_DATAGRAM (PEER_HEADER + 256 + 256 * LONG_BYTES)
+
+/**
+ * @brief a subscription to another plc's image
+ */
+struct peer_sub{
+    BYTE node; ///publisher
+    int input; ///first local %i bit for its %q, or PLC_ERR
+    int mvar; ///first local %m for its %m, or PLC_ERR
+    int ok; ///local %m that is 1 while it is fresh, or PLC_ERR
+    unsigned int q_count; ///bits it last published
+    BYTE seen;
+    BYTE fresh;
+    uint32_t seq;
+    long long last; ///msecs
+};
+
+static int Sock = PLC_ERR;
+static BYTE Node = 0;
+static int Rate = 0;
+static int Change = FALSE;
+static int Stale = 0;
+
+static struct sockaddr_storage Dest[PEER_DESTINATIONS];
+static socklen_t DestLen[PEER_DESTINATIONS];
+static int N_dest = 0;
+
+static unsigned int Q_first = 0;
+static unsigned int Q_count = 0;
+static unsigned int M_first = 0;
+static unsigned int M_count = 0;
+
+static struct peer_sub * Subs = NULL;
+static int N_subs = 0;
+
+static uint32_t Seq = 0;
+static long long Sent = 0;
+static BYTE Last[PEER_DATAGRAM]; //payload last sent
+static unsigned int LastLen = 0;
+
+static void put32(BYTE * b, uint32_t v)
+{
+    b[0] = v >> 24;
+    b[1] = (v >> 16) & 0xFF;
+    b[2] = (v >> 8) & 0xFF;
+    b[3] = v & 0xFF;
+}
+
+static uint32_t get32(const BYTE * b)
+{
+    return ((uint32_t)b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+static void put16(BYTE * b, unsigned int v)
+{
+    b[0] = (v >> 8) & 0xFF;
+    b[1] = v & 0xFF;
+}
+
+static unsigned int get16(const BYTE * b)
+{
+    return (b[0] << 8) | b[1];
+}
+
+static long long now_msecs()
+{
+    struct timeval tv;
+    get_clock(&tv);
+
+    return (long long)tv.tv_sec * THOUSAND + tv.tv_usec / THOUSAND;
+}
+
+/**
+ * @brief parse a range like "8 16", first and count
+ * @return OK or ERROR
+ */
+static int parse_range(const char * val,
+                       unsigned int max,
+                       unsigned int * first,
+                       unsigned int * count)
+{
+    char * end = NULL;
+    *first = 0;
+    *count = 0;
+    if(val == NULL || val[0] == 0){
+
+        return PLC_OK;
+    }
+    long f = strtol(val, &end, 10);
+    long c = strtol(end, &end, 10);
+    if(f < 0 || c < 0 || f + c > max){
+
+        return PLC_ERR;
+    }
+    *first = f;
+    *count = c;
+
+    return PLC_OK;
+}
+
+/**
+ * @brief parse destinations, like "10.0.0.2:5100 10.0.0.3:5100"
+ * @return number of destinations or PLC_ERR
+ */
+static int parse_destinations(const char * list)
+{
+    char buf[CONF_STR];
+    char * save = NULL;
+    char * it = NULL;
+    N_dest = 0;
+    if(list == NULL){
+
+        return 0;
+    }
+    snprintf(buf, CONF_STR, "%s", list);
+    for(it = strtok_r(buf, " ,", &save);
+        it;
+        it = strtok_r(NULL, " ,", &save)){
+        struct addrinfo hints;
+        struct addrinfo * res = NULL;
+        char * colon = strrchr(it, ':');
+        if(colon == NULL || N_dest == PEER_DESTINATIONS){
+
+            return PLC_ERR;
+        }
+        *colon = 0;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        if(getaddrinfo(it, colon + 1, &hints, &res) != 0 || res == NULL){
+
+            return PLC_ERR;
+        }
+        memcpy(&Dest[N_dest], res->ai_addr, res->ai_addrlen);
+        DestLen[N_dest] = res->ai_addrlen;
+        N_dest++;
+        freeaddrinfo(res);
+    }
+    return N_dest;
+}
+
+static int parse_index(const char * val)
+{
+    return val && val[0] ? atoi(val) : PLC_ERR;
+}
+
+static int parse_subscriptions(const sequence_t s)
+{
+    int i = 0;
+    free(Subs);
+    Subs = NULL;
+    N_subs = 0;
+    if(s == NULL){
+
+        return PLC_OK;
+    }
+    Subs = (struct peer_sub *)calloc(s->size + 1, sizeof(struct peer_sub));
+    for(; i < s->size; i++){
+        variable_t v = &s->vars[i];
+        if(v->name == NULL || v->name[0] == 0){ //unused slot
+            continue;
+        }
+        struct peer_sub * sub = &Subs[N_subs++];
+        sub->node = atoi(v->name);
+        sub->input = parse_index(get_param_val("I", v->params));
+        sub->mvar = parse_index(get_param_val("M", v->params));
+        sub->ok = parse_index(get_param_val("OK", v->params));
+    }
+    return PLC_OK;
+}
+
+/**
+ * @brief build the datagram of the published ranges
+ * @return its length
+ */
+static unsigned int build(const plc_t p, BYTE * d)
+{
+    unsigned int i = 0;
+    BYTE * q = d + PEER_HEADER;
+    BYTE * m = q + (Q_count + BYTESIZE - 1) / BYTESIZE;
+    put16(d, PEER_MAGIC);
+    d[2] = PEER_VERSION;
+    d[3] = Node;
+    put32(d + 4, Seq);
+    put32(d + 8, get_loop());
+    put16(d + 12, Q_first);
+    put16(d + 14, Q_count);
+    put16(d + 16, M_first);
+    put16(d + 18, M_count);
+    memset(q, 0, m - q);
+    for(i = 0; i < Q_count; i++){
+        unsigned int n = Q_first + i;
+        //as driven to the hardware, forced
+        if((p->dq[n].Q || p->dq[n].MASK) && !p->dq[n].N_MASK){
+            q[i / BYTESIZE] |= 1 << i % BYTESIZE;
+        }
+    }
+    for(i = 0; i < M_count; i++){
+        uint64_t v = p->m[M_first + i].V;
+        put32(m + i * LONG_BYTES, v >> 32);
+        put32(m + i * LONG_BYTES + 4, v & 0xFFFFFFFF);
+    }
+    return m - d + M_count * LONG_BYTES;
+}
+
+static void publish(const plc_t p)
+{
+    static BYTE d[PEER_DATAGRAM];
+    long long now = now_msecs();
+    int i = 0;
+    unsigned int len = build(p, d);
+    //the stamps are left out of the comparison
+    int changed = len != LastLen
+               || memcmp(d + 12, Last + 12, len - 12);
+    if(!(Change && changed) && now - Sent < Rate){
+
+        return;
+    }
+    for(; i < N_dest; i++){
+        sendto(Sock, d, len, MSG_DONTWAIT,
+               (struct sockaddr *)&Dest[i], DestLen[i]);
+    }
+    memcpy(Last, d, len);
+    LastLen = len;
+    Sent = now;
+    Seq++;
+}
+
+static void set_fresh(plc_t p, struct peer_sub * s, BYTE fresh)
+{
+    unsigned int i = 0;
+    if(s->fresh && !fresh){
+        plc_log("Peer %d is stale", s->node);
+        //fail safe, its inputs read 0 until it is back
+        for(i = 0; s->input >= 0 && i < s->q_count; i++){
+            if(s->input + i < BYTESIZE * p->ni){
+                p->di[s->input + i].MASK = FALSE;
+                p->di[s->input + i].N_MASK = TRUE;
+            }
+        }
+    } else if(!s->fresh && fresh){
+        plc_log("Peer %d is fresh", s->node);
+    }
+    if(!fresh){//a publisher that restarted counts from 0 again
+        s->seen = FALSE;
+    }
+    s->fresh = fresh;
+    if(s->ok >= 0 && s->ok < p->nm){
+        p->m[s->ok].V = fresh;
+    }
+}
+
+static void receive(plc_t p)
+{
+    BYTE d[PEER_DATAGRAM];
+    ssize_t len = 0;
+    while((len = recv(Sock, d, sizeof(d), MSG_DONTWAIT)) >= 0){
+        int i = 0;
+        if(len < PEER_HEADER){
+            continue;
+        }
+        unsigned int q_count = get16(d + 14);
+        unsigned int m_count = get16(d + 18);
+        const BYTE * q = d + PEER_HEADER;
+        const BYTE * m = q + (q_count + BYTESIZE - 1) / BYTESIZE;
+        uint32_t seq = get32(d + 4);
+        if(get16(d) != PEER_MAGIC
+        || d[2] != PEER_VERSION
+        || PEER_HEADER + (q_count + BYTESIZE - 1) / BYTESIZE
+           + m_count * LONG_BYTES > len){
+            continue;
+        }
+        for(; i < N_subs; i++){
+            struct peer_sub * s = &Subs[i];
+            unsigned int k = 0;
+            //late or duplicate datagrams are older than what is applied
+            if(s->node != d[3]
+            || (s->seen && (int32_t)(seq - s->seq) <= 0)){
+                continue;
+            }
+            s->seen = TRUE;
+            s->seq = seq;
+            s->q_count = q_count;
+            s->last = now_msecs();
+            for(k = 0; s->input >= 0 && k < q_count; k++){
+                unsigned int n = s->input + k;
+                if(n < BYTESIZE * p->ni){
+                    BYTE bit = (q[k / BYTESIZE] >> k % BYTESIZE) % 2;
+                    p->di[n].MASK = bit;
+                    p->di[n].N_MASK = !bit;
+                }
+            }
+            for(k = 0; s->mvar >= 0 && k < m_count; k++){
+                unsigned int n = s->mvar + k;
+                if(n < p->nm){
+                    p->m[n].V = ((uint64_t)get32(m + k * LONG_BYTES) << 32)
+                              | get32(m + k * LONG_BYTES + 4);
+                }
+            }
+            p->update |= CHANGED_I | CHANGED_M;
+        }
+    }
+}
+
+plc_t peer_update(plc_t p)
+{
+    int i = 0;
+    if(Sock < 0 || p == NULL){
+
+        return p;
+    }
+    receive(p);
+    for(; i < N_subs; i++){
+        set_fresh(p, &Subs[i],
+                  Subs[i].seen && now_msecs() - Subs[i].last <= Stale);
+    }
+    if(N_dest > 0 && p->status == ST_RUNNING){
+        publish(p);
+    }
+    return p;
+}
+
+int peer_init(const config_t conf, const plc_t p)
+{
+    config_t peer = get_recursive_entry(CONFIG_PEER, conf);
+    int port = get_numeric_entry(PEER_PORT, peer);
+    struct sockaddr_in addr;
+    int i = 0;
+    if(p == NULL){
+
+        return PLC_ERR;
+    }
+    Node = get_numeric_entry(PEER_NODE, peer);
+    Rate = get_numeric_entry(PEER_RATE, peer);
+    Change = get_numeric_entry(PEER_CHANGE, peer) > 0;
+    Stale = get_numeric_entry(PEER_STALE, peer);
+    if(parse_destinations(get_string_entry(PEER_PUBLISH, peer)) < 0
+    || parse_range(get_string_entry(PEER_Q, peer),
+                   BYTESIZE * p->nq, &Q_first, &Q_count) < 0
+    || parse_range(get_string_entry(PEER_M, peer),
+                   p->nm, &M_first, &M_count) < 0
+    || parse_subscriptions(get_sequence_entry(PEER_SUBSCRIBE, peer)) < 0){
+        plc_log("Invalid peer configuration");
+
+        return PLC_ERR;
+    }
+    if(N_dest == 0 && (port <= 0 || N_subs == 0)){ //disabled
+
+        return PLC_OK;
+    }
+    Sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(Sock < 0){
+
+        return PLC_ERR;
+    }
+    if(port > 0){
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if(bind(Sock, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+            plc_log("Failed to bind peer port %d: %s", port, strerror(errno));
+            peer_end();
+
+            return PLC_ERR;
+        }
+    }
+    for(; i < N_subs; i++){ //stale until heard from
+        set_fresh(p, &Subs[i], FALSE);
+    }
+    Sent = now_msecs() - Rate;
+    LastLen = 0;
+    plc_log("Peer %d publishing to %d, subscribed to %d", Node, N_dest, N_subs);
+
+    return PLC_OK;
+}
+
+void peer_end()
+{
+    if(Sock >= 0){
+        close(Sock);
+    }
+    Sock = PLC_ERR;
+}
@@ -0,0 +1,41 @@
+#ifndef _PEER_H_
+#define _PEER_H_
+/**
+ *@file peer.h
+ *@brief process image exchange between plc instances over UDP.
+ * A plc publishes ranges of its %q and %m, other plcs subscribe to them
+ * and see the publisher's %q bits as inputs and its %m in their own %m.
+*/
+
+#define PEER_MAGIC 0x5045 //"PE"
+#define PEER_VERSION 1
+/**
+ * datagram, network byte order:
+ * magic(2) version(1) node(1) sequence(4) cycle(4)
+ * q_first(2) q_count(2) m_first(2) m_count(2)
+ * %q bits packed, then %m values 8 bytes each
+ */
+#define PEER_HEADER 20
+
+/**
+ * @brief open the peer socket, if publishing or subscribing is configured
+ * @param system configuration
+ * @param the plc
+ * @return OK or ERROR
+ */
+int peer_init(const config_t conf, const plc_t p);
+
+/**
+ * @brief take in received images, check staleness and publish,
+ * called from the scan loop once per cycle, never blocks
+ * @param the plc
+ * @return the plc
+ */
+plc_t peer_update(plc_t p);
+
+/**
+ * @brief close the peer socket
+ */
+void peer_end();
+
+#endif //_PEER_H_
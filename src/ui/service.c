@@ -0,0 +1,236 @@
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "config.h"
+#include "schema.h"
+#include "hardware.h"
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+#include "plclib.h"
+#include "snapshot.h"
+#include "wire.h"
+#include "reactor.h"
+#include "util.h"
+#include "ui.h"
+#include "app.h"
+#include "service.h"
+
+static pthread_t Thread;
+static int Serving = FALSE;
+static int Wake = PLC_ERR;
+static int Epoll = PLC_ERR;
+
+static snapshot_t Published = NULL;
+static snapshot_t View = NULL;
+static snapshot_t Shown = NULL; //the copy published last
+static unsigned int Drawn = 1; //sequence of the last state drawn, odd for none
+
+static config_t State = NULL; //only the ui thread touches it
+static config_t Fresh = NULL; //configuration handed over by the scan
+
+//command queue, slots are prepared once and parsed into in place
+static config_t Queue[SERVICE_QUEUE];
+static struct wire_batch Batches[SERVICE_QUEUE]; //of COM_BATCH commands
+static unsigned int Head = 0; //only the ui thread writes it
+static unsigned int Tail = 0; //only the scan thread writes it
+
+static void take_commands()
+{
+    unsigned int head = Head;
+    while(head - __atomic_load_n(&Tail, __ATOMIC_ACQUIRE) < SERVICE_QUEUE){
+        config_t com = ui_update(Queue[head % SERVICE_QUEUE]);
+        Queue[head % SERVICE_QUEUE] = com;
+        int c = get_numeric_entry(CLI_COM, com);
+        if(c == COM_NONE){
+            break;
+        }
+        if(c == COM_BATCH
+        && ui_batch(&Batches[head % SERVICE_QUEUE]) < PLC_OK){
+            continue;
+        }
+        __atomic_store_n(&Head, ++head, __ATOMIC_RELEASE);
+        reactor_wake();
+    }//a full queue is left in the ui until the scan catches up
+}
+
+/**
+ * @brief bring the variables of the free command slots up to date, 
+ * so that a command that carries a whole configuration does not undo 
+ * what was edited through another slot
+ * @param the new configuration
+ */
+static void refresh_commands(const config_t conf)
+{
+    unsigned int i = Head;
+    for(; i - __atomic_load_n(&Tail, __ATOMIC_ACQUIRE) < SERVICE_QUEUE; i++){
+        config_t arg = get_recursive_entry(CLI_ARG, Queue[i % SERVICE_QUEUE]);
+        int s = CONFIG_PROGRAM + 1;//programs come with their listing
+        for(; arg && s < N_CONFIG_VARIABLES; s++){
+            entry_t e = get_entry(s, conf);
+            if(e && e->type_tag == ENTRY_SEQ){
+                arg = update_entry(s, copy_entry(e), arg);
+            }
+        }
+    }
+}
+
+static void draw()
+{
+    int published = PLC_ERR;
+    config_t c = __atomic_exchange_n(&Fresh, NULL, __ATOMIC_ACQ_REL);
+    if(c){
+        refresh_commands(c);
+        clear_config(State);
+        State = c;
+        Drawn = 1;
+    }
+    if(read_snapshot(Published, View) != PLC_OK){
+
+        return;
+    }
+    if(Drawn != 1){//described already, only values change
+        published = ui_publish(View, Shown);
+    }
+    if(published != PLC_OK && View->seq != Drawn){
+        State = get_state(View, State);
+        ui_draw(State);
+        ui_publish(View, NULL);
+    }
+    read_snapshot(View, Shown);
+    Drawn = View->seq;
+}
+
+static void * serve(void * arg)
+{
+    struct epoll_event ev[2];
+    int i = 0;
+    int more = TRUE;
+    draw();
+    while(more){
+        int n = epoll_wait(Epoll, ev, 2, SERVICE_PERIOD);
+        if(n < 0 && errno != EINTR){
+            break;
+        }
+        for(i = 0; i < n; i++){
+            if(ev[i].data.ptr == &Wake){
+                more = FALSE;
+            }
+        }
+        //also on timeout: the ui may only be pollable, or the queue was full
+        take_commands();
+        draw();
+    }
+    return NULL;
+}
+
+int service_init(const config_t conf, const plc_t p)
+{
+    struct epoll_event ev;
+    sigset_t all;
+    sigset_t old;
+    int i = 0;
+    int fd = ui_fd();
+    Epoll = epoll_create1(EPOLL_CLOEXEC);
+    Wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(Epoll < 0 || Wake < 0){
+        plc_log("Failed to start the ui: %s", strerror(errno));
+        service_end();
+
+        return PLC_ERR;
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = &Wake;
+    epoll_ctl(Epoll, EPOLL_CTL_ADD, Wake, &ev);
+    if(fd >= 0){
+        ev.data.ptr = NULL;
+        epoll_ctl(Epoll, EPOLL_CTL_ADD, fd, &ev);
+    }
+    for(; i < SERVICE_QUEUE; i++){
+        Queue[i] = cli_init_command(conf);
+    }
+    Head = Tail = 0;
+    Drawn = 1;
+    State = get_program(p, copy_config(conf));
+    Published = new_snapshot(p);
+    View = new_snapshot(p);
+    Shown = new_snapshot(p);
+    publish_snapshot(p, Published);
+
+    //signals are for the scan thread
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int r = pthread_create(&Thread, NULL, serve, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if(r != 0){
+        plc_log("Failed to start the ui");
+        service_end();
+
+        return PLC_ERR;
+    }
+    Serving = TRUE;
+
+    return PLC_OK;
+}
+
+plc_t service_publish(plc_t p)
+{
+    if(Serving && p->update != 0){
+        publish_snapshot(p, Published);
+        p->update = 0;
+    }
+    return p;
+}
+
+config_t service_command()
+{
+    if(!Serving
+    || Tail == __atomic_load_n(&Head, __ATOMIC_ACQUIRE)){
+
+        return NULL;
+    }
+    return Queue[Tail % SERVICE_QUEUE];
+}
+
+wire_batch_t service_batch()
+{
+    return &Batches[Tail % SERVICE_QUEUE];
+}
+
+void service_done()
+{
+    __atomic_store_n(&Tail, Tail + 1, __ATOMIC_RELEASE);
+}
+
+void service_reconfigure(const plc_t p, const config_t conf)
+{
+    config_t c = get_program(p, copy_config(conf));
+    c = __atomic_exchange_n(&Fresh, c, __ATOMIC_ACQ_REL);
+    if(c){//never taken by the ui thread
+        clear_config(c);
+    }
+}
+
+void service_end()
+{
+    uint64_t one = 1;
+    if(Serving
+    && write(Wake, &one, sizeof(one)) == sizeof(one)){
+        pthread_join(Thread, NULL);
+    }
+    Serving = FALSE;
+    if(Wake >= 0){
+        close(Wake);
+    }
+    if(Epoll >= 0){
+        close(Epoll);
+    }
+    Wake = Epoll = PLC_ERR;
+    Published = clear_snapshot(Published);
+    View = clear_snapshot(View);
+    Shown = clear_snapshot(Shown);
+}
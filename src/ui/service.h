@@ -0,0 +1,60 @@
+#ifndef _SERVICE_H_
+#define _SERVICE_H_
+/**
+ *@file service.h
+ *@brief user interface thread. It takes commands from the ui into a
+ * single producer, single consumer queue that the scan drains between
+ * cycles, and draws the plc state from a snapshot that the scan publishes
+ * when it changes, at most once every SERVICE_PERIOD msecs.
+ * The scan thread never parses, serializes, allocates or blocks for the ui.
+*/
+
+#define SERVICE_QUEUE 8 //commands waiting for the scan
+#define SERVICE_PERIOD 100 //msecs between state updates, at most
+
+/**
+ * @brief start the ui thread, after ui_init()
+ * @param system configuration
+ * @param the plc
+ * @return OK or ERROR
+ */
+int service_init(const config_t conf, const plc_t p);
+
+/**
+ * @brief publish the plc state if it changed, from the scan thread
+ * @param the plc
+ * @return the plc
+ */
+plc_t service_publish(plc_t p);
+
+/**
+ * @brief the oldest command queued by the ui thread, from the scan thread
+ * @return the command, valid until service_done(), or NULL
+ */
+config_t service_command();
+
+/**
+ * @brief the batch of the oldest command, when it is COM_BATCH
+ * @return the batch, valid until service_done()
+ */
+wire_batch_t service_batch();
+
+/**
+ * @brief hand the command slot back to the ui thread
+ */
+void service_done();
+
+/**
+ * @brief hand a changed configuration over to the ui thread,
+ * from the scan thread
+ * @param the plc
+ * @param the new configuration
+ */
+void service_reconfigure(const plc_t p, const config_t conf);
+
+/**
+ * @brief stop the ui thread, before ui_end()
+ */
+void service_end();
+
+#endif //_SERVICE_H_
@@ -5,9 +5,17 @@
 #include <sys/stat.h>
 #include <time.h>
 #include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 #include "data.h"
+#include "instruction.h"
+#include "rung.h"
 #include "config.h"
+#include "hardware.h"
+#include "plclib.h"
+#include "snapshot.h"
+#include "wire.h"
 #include "ui.h"
 
 /*************GLOBALS************************************************/
@@ -16,6 +24,8 @@ int Enable = TRUE;
 int More = TRUE;
 char * Cli_buf = NULL; //only reader thread writes here
 pthread_t Reader;
+int Typed = PLC_ERR; //signalled by the reader when a line is in
+struct wire_batch Batch; //typed as BATCH FORCE|UNFORCE|WRITE ...
 
 void ui_display_message(char * msgstr)
 {
@@ -28,6 +38,12 @@ void ui_draw(config_t state)
     cli_header();
 }
 
+int ui_publish(const snapshot_t now, const snapshot_t last)
+{//the console prints whole states
+
+    return PLC_ERR;
+}
+
 void * read_cli(void *buf) {
     
     size_t len = sizeof(buf);
@@ -40,6 +56,8 @@ void * read_cli(void *buf) {
     if(n >=0){
         sprintf(buf, "%s", b);
         free(b);
+        uint64_t one = 1;
+        write(Typed, &one, sizeof(one));
     }
     return buf;
 }
@@ -48,24 +66,53 @@ int ui_init(const config_t conf)
 {
     Cli_buf = (char*)malloc(MAXBUF);
     memset(Cli_buf, 0, MAXBUF);
+    Typed = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
     int rc = pthread_create(&Reader, NULL, read_cli, (void *) Cli_buf);
     
     return rc;
 }
 
+int ui_fd()
+{
+    return Typed;
+}
+
 config_t ui_update(config_t command)
 {
+    uint64_t count = 0;
     command = set_numeric_entry(CLI_COM, COM_NONE, command);
     
     if(Cli_buf != NULL && Cli_buf[0]){
-        config_t c = cli_parse(Cli_buf, command);
+        read(Typed, &count, sizeof(count));
+        config_t c = command;
+        if(!strncasecmp(Cli_buf, "BATCH ", 6)){
+            if(wire_batch(Cli_buf + 6, &Batch) == PLC_OK){
+                c = set_numeric_entry(CLI_COM, COM_BATCH, command);
+            } else {
+                ui_display_message("Invalid batch");
+            }
+        } else {
+            c = cli_parse(Cli_buf, command);
+        }
         pthread_join(Reader, NULL);
+        Cli_buf[0] = 0;
         pthread_create(&Reader, NULL, read_cli, (void *) Cli_buf);
         return c;
     }
     return command;
 }
 
+int ui_batch(wire_batch_t b)
+{
+    if(Batch.n == 0){
+    
+        return PLC_ERR;
+    }
+    memcpy(b, &Batch, sizeof(struct wire_batch));
+    
+    return PLC_OK;
+}
+
 void ui_end()
 {
     More = FALSE;
@@ -13,6 +13,8 @@
 #include "plclib.h"
 #include "plcemu.h"
 #include "config.h"
+#include "snapshot.h"
+#include "wire.h"
 #include "ui.h"
 
 /*************GLOBALS************************************************/
@@ -23,6 +25,24 @@ char * Ui_buf = NULL;
 void * Zmq_context = NULL;
 void * Zmq_responder = NULL;
 void * Zmq_publisher = NULL;
+char * Doc = NULL; //last state document, for late joiners
+unsigned int Sent = 0; //messages published
+BYTE Resync = FALSE; //a client subscribed, send it a keyframe
+BYTE Describe = FALSE; //a client subscribed, send it the state document
+BYTE Full = FALSE; //someone subscribed to the whole image
+struct wire_batch Batch; //of the last COM_BATCH
+
+//room for a command, text or binary
+#define UI_BUF (CONF_STR > WIRE_BATCH_MAX ? CONF_STR : WIRE_BATCH_MAX)
+#define UI_WATCHES 16 //watch lists, at most
+struct watch{
+    struct wire_watch w;
+    BYTE used;
+    BYTE subscribed;
+    BYTE resync;
+    unsigned int sent;
+    long due; //msecs, when a sampled watch list is sent next
+} Watches[UI_WATCHES];
 
 void ui_display_message(char * msgstr)
 {
@@ -32,53 +52,269 @@ void ui_display_message(char * msgstr)
 void ui_draw(config_t state)
 {
 //send state for printing
-    char * state_buf = serialize_config(state);
-    zmq_send (Zmq_publisher, 
-                state_buf, 
-                strlen(state_buf),
+    free(Doc);
+    Doc = serialize_config(state);
+    if(Doc){
+        zmq_send (Zmq_publisher, 
+                Doc, 
+                strlen(Doc),
                 0);//ZMQ_DONTWAIT);
-    free(state_buf);
+    }
+}
+
+static void free_msg(void * data, void * hint)
+{
+    free(data);
+}
+
+static long msecs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void publish_all(const snapshot_t now, const snapshot_t last)
+{
+    zmq_msg_t msg;
+    BYTE key = last == NULL || Resync || Sent % WIRE_KEYFRAME == 0;
+    BYTE * buf = (BYTE *)malloc(wire_max(now));
+    unsigned int len = wire_encode(now, key ? NULL : last, Sent, buf);
+    if(len == 0){//nothing changed
+        free(buf);
+
+        return;
+    }
+    Resync = FALSE;
+    //zeromq frees the buffer once it is sent
+    zmq_msg_init_data(&msg, buf, len, free_msg, NULL);
+    if(zmq_msg_send(&msg, Zmq_publisher, 0) < 0){
+        zmq_msg_close(&msg);
+    }
+    Sent++;
+}
+
+static void publish_watch(const snapshot_t now, struct watch * w,
+                          BYTE key, long t)
+{
+    BYTE buf[WIRE_WATCH_MAX];
+    unsigned int len = 0;
+    if(w->w.period > 0){
+        if(t < w->due){
+
+            return;
+        }//samples carry all the values
+        key = TRUE;
+        w->due = t + w->w.period;
+    }
+    key = key || w->resync || w->sent % WIRE_KEYFRAME == 0;
+    len = wire_encode_watch(now, &w->w, key, w->sent, buf);
+    if(len == 0){
+
+        return;
+    }
+    w->resync = FALSE;
+    zmq_send(Zmq_publisher, w->w.topic, strlen(w->w.topic), ZMQ_SNDMORE);
+    zmq_send(Zmq_publisher, buf, len, 0);
+    w->sent++;
+}
+
+int ui_publish(const snapshot_t now, const snapshot_t last)
+{
+    long t = msecs();
+    int i = 0;
+    if(Describe && Doc){//names and parameters first
+        zmq_send(Zmq_publisher, Doc, strlen(Doc), 0);
+    }
+    Describe = FALSE;
+    if(Full){//only encode what someone listens to
+        publish_all(now, last);
+    }
+    for(; i < UI_WATCHES; i++){
+        if(Watches[i].used && Watches[i].subscribed){
+            publish_watch(now, &Watches[i], last == NULL, t);
+        }
+    }
+    return PLC_OK;
+}
+
+/**
+ * @brief track what clients subscribe to, from XPUB frames.
+ * A shorter prefix turns watching on, only the exact topic turns it off,
+ * so sampling may go on for nobody but never stops for someone.
+ * @param the frame, 1 or 0 for (un)subscription, then the topic
+ * @param its length
+ */
+static void subscription(const char * sub, unsigned int len)
+{
+    BYTE on = sub[0] == 1;
+    const char * topic = sub + 1;
+    unsigned int n = len - 1;
+    int i = 0;
+    Describe = Describe || on;
+    if(on ? n <= 2 && !memcmp(topic, WIRE_MAGIC, n)
+          : n == 2 && !memcmp(topic, WIRE_MAGIC, n)){
+        Full = on;
+        Resync = Resync || on;
+    }
+    for(; i < UI_WATCHES; i++){
+        struct watch * w = &Watches[i];
+        unsigned int tn = strlen(w->w.topic);
+        if(w->used
+        && (on ? n <= tn : n == tn)
+        && !memcmp(topic, w->w.topic, n)){
+            w->subscribed = on;
+            w->resync = w->resync || on;
+        }
+    }
+}
+
+/**
+ * @brief register, replace or drop a watch list
+ * @param the command
+ * @return OK or ERROR
+ */
+static int watch(const config_t command)
+{
+    struct wire_watch w;
+    struct watch * free_slot = NULL;
+    char topic[WIRE_TOPIC];
+    const char * spec = get_string_entry(CLI_WATCH, command);
+    int i = 0;
+    if(get_numeric_entry(CLI_COM, command) == COM_WATCH){
+        if(wire_watch(spec, &w) < PLC_OK){
+
+            return PLC_ERR;
+        }
+    } else if(spec == NULL
+           || strlen(spec) + 2 >= WIRE_TOPIC
+           || sscanf(spec, "%13s", topic + 2) != 1){
+
+        return PLC_ERR;
+    } else {
+        memcpy(topic, WIRE_WATCH, 2);
+        memset(&w, 0, sizeof(w));
+        strcpy(w.topic, topic);
+    }
+    for(; i < UI_WATCHES; i++){
+        if(Watches[i].used && !strcmp(Watches[i].w.topic, w.topic)){
+            Watches[i].used = FALSE;
+            free_slot = &Watches[i];
+        } else if(!Watches[i].used && free_slot == NULL){
+            free_slot = &Watches[i];
+        }
+    }
+    if(get_numeric_entry(CLI_COM, command) == COM_UNWATCH){
+
+        return PLC_OK;
+    }
+    if(free_slot == NULL){
+
+        return PLC_ERR;
+    }
+    memset(free_slot, 0, sizeof(struct watch));
+    free_slot->w = w;
+    free_slot->used = TRUE;
+    //the client subscribes, maybe before it registers
+    free_slot->subscribed = TRUE;
+    free_slot->resync = TRUE;
+
+    return PLC_OK;
 }
 
 int ui_init(const config_t conf)
 {
-    Ui_buf = (char*)malloc(CONF_STR);
-    memset(Ui_buf, 0, CONF_STR);
+    Ui_buf = (char*)malloc(UI_BUF);
+    memset(Ui_buf, 0, UI_BUF);
     Zmq_context = zmq_ctx_new ();
     
     Zmq_responder = zmq_socket (Zmq_context, ZMQ_REP);
     int rc = zmq_bind (Zmq_responder, "tcp://*:5555");
     
-    Zmq_publisher = zmq_socket (Zmq_context, ZMQ_PUB);
+    //subscriptions come through, to resynchronize late joiners
+    Zmq_publisher = zmq_socket (Zmq_context, ZMQ_XPUB);
+    int verbose = 1;
+    zmq_setsockopt(Zmq_publisher, ZMQ_XPUB_VERBOSE, &verbose, sizeof(verbose));
  
     rc = zmq_bind (Zmq_publisher, "tcp://*:5556");
     
     return rc;
 }
 
+int ui_fd()
+{
+    int fd = PLC_ERR;
+    size_t len = sizeof(fd);
+    if(Zmq_responder == NULL
+    || zmq_getsockopt(Zmq_responder, ZMQ_FD, &fd, &len) < 0){
+
+        return PLC_ERR;
+    }
+    return fd;
+}
+
 config_t ui_update(config_t command)
 {
     //time_header();
- //peek socket for messages
-    int rc = zmq_recv (Zmq_responder, 
-                        Ui_buf, 
-                        CONF_STR, 
-                        ZMQ_DONTWAIT);
-    if(rc > 0){
+    char sub[TINYBUF];
+    int rc = 0;
+    command = set_numeric_entry(CLI_COM, COM_NONE, command);
+    while((rc = zmq_recv(Zmq_publisher, sub, TINYBUF, ZMQ_DONTWAIT)) > 0){
+        subscription(sub, rc < TINYBUF ? rc : TINYBUF);
+    }
+ //peek socket for messages, watch lists are served here
+    while(get_numeric_entry(CLI_COM, command) == COM_NONE
+    && (rc = zmq_recv(Zmq_responder, Ui_buf, UI_BUF, ZMQ_DONTWAIT)) > 0){
+        const char * reply = "OK";
+        if(rc >= 2 && !memcmp(Ui_buf, WIRE_COMMAND, 2)){//binary
+            if(rc <= UI_BUF
+            && wire_decode_batch((BYTE *)Ui_buf, rc, &Batch) == PLC_OK){
+                command = set_numeric_entry(CLI_COM, COM_BATCH, command);
+            } else {
+                reply = "ERROR";
+            }
+            zmq_send(Zmq_responder, reply, strlen(reply), 0);
+            continue;
+        }
+        Ui_buf[rc < UI_BUF - 1 ? rc : UI_BUF - 1] = 0;
         printf ("Received %s\n", Ui_buf); 
+ //deserialize command 
+        command = store_value(CLI_EDIT, "", command);
+        command = deserialize_config(Ui_buf, command);
+        switch(get_numeric_entry(CLI_COM, command)){
+            case COM_WATCH:
+            case COM_UNWATCH:
+                reply = watch(command) == PLC_OK ? "OK" : "ERROR";
+                command = set_numeric_entry(CLI_COM, COM_NONE, command);
+                break;
+            default: break;
+        }
         zmq_send (Zmq_responder, 
-                "OK", 
-                strlen("OK"),
+                reply, 
+                strlen(reply),
                 0);
-        command = deserialize_config(Ui_buf, command);
     }         
- //deserialize command 
     return command;
 }
 
+int ui_batch(wire_batch_t b)
+{
+    if(Batch.n == 0){
+
+        return PLC_ERR;
+    }
+    memcpy(b, &Batch, sizeof(struct wire_batch));
+
+    return PLC_OK;
+}
+
 void ui_end()
 {
     More = FALSE;
+    free(Doc);
+    Doc = NULL;
+    memset(Watches, 0, sizeof(Watches));
     zmq_close (Zmq_publisher);
     zmq_close (Zmq_responder);
     zmq_ctx_destroy (Zmq_context);
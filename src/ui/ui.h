@@ -10,6 +10,8 @@ typedef enum
 {/// CLI schema
     CLI_COM,//commands always go to first payload entry
     CLI_ARG, //optional arguments start at second payload entry
+    CLI_WATCH, //watch list, for COM_WATCH and COM_UNWATCH
+    CLI_EDIT, //"block index key value..." for COM_EDIT, only what changed
     N_PAYLOADS
 } CLI_PAYLOADS;
 
@@ -26,6 +28,9 @@ typedef enum
     COM_SAVE,
     COM_CONFIG, //TODO
     COM_QUIT,
+    COM_WATCH, //served by the ui, never reaches the plc
+    COM_UNWATCH,
+    COM_BATCH, //binary, see ui_batch()
     N_COM
 } COMMANDS;
 
@@ -44,18 +49,41 @@ void ui_display_message(char *msgstr);
 void ui_draw(config_t state);
 
 /**
- * @brief update ui and get the next command
+ * @brief publish the values of the plc state, after ui_draw() has
+ * described it
+ * @param consistent copy of the plc state
+ * @param the copy published before, NULL if there was none
+ * @return OK, or ERROR if the ui can only draw whole states
+ */
+int ui_publish(const snapshot_t now, const snapshot_t last);
+
+/**
+ * @brief update ui and get the next command, never blocks
  * @param the command configuration
- * @return next command
+ * @return next command, COM_NONE if none is pending
  */
 config_t ui_update(config_t command);
 
+/**
+ * @brief the batch of the COM_BATCH command that ui_update() returned last
+ * @param where to copy it
+ * @return OK, or ERROR if there is none
+ */
+int ui_batch(wire_batch_t b);
+
 /**
  * @brief initialize ui
  * @return OK or ERROR
  */
 int ui_init();
 
+/**
+ * @brief descriptor for the ui thread to wait on
+ * @return a descriptor that becomes readable when commands may be pending,
+ * or PLC_ERR if the ui can only be polled
+ */
+int ui_fd();
+
 /**
  * @brief cleanup
  */
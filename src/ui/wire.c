@@ -0,0 +1,490 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "data.h"
+#include "instruction.h"
+#include "rung.h"
+#include "config.h"
+#include "hardware.h"
+#include "plclib.h"
+#include "snapshot.h"
+#include "wire.h"
+
+static void put16(BYTE * b, unsigned int v)
+{
+    b[0] = (v >> 8) & 0xFF;
+    b[1] = v & 0xFF;
+}
+
+static unsigned int get16(const BYTE * b)
+{
+    return (b[0] << 8) | b[1];
+}
+
+static void put32(BYTE * b, uint32_t v)
+{
+    put16(b, v >> 16);
+    put16(b + 2, v & 0xFFFF);
+}
+
+static uint32_t get32(const BYTE * b)
+{
+    return ((uint32_t)get16(b) << 16) | get16(b + 2);
+}
+
+static void put64(BYTE * b, uint64_t v)
+{
+    put32(b, v >> 32);
+    put32(b + 4, v & 0xFFFFFFFF);
+}
+
+static uint64_t get64(const BYTE * b)
+{
+    return ((uint64_t)get32(b) << 32) | get32(b + 4);
+}
+
+static uint64_t real_bits(double d)
+{
+    uint64_t v = 0;
+    memcpy(&v, &d, sizeof(v));
+
+    return v;
+}
+
+double wire_real(uint64_t v)
+{
+    double d = 0;
+    memcpy(&d, &v, sizeof(d));
+
+    return d;
+}
+
+/**
+ * @brief 8 flags of a one flag per byte array as bits
+ * @param the flags
+ * @param how many there are
+ * @param which 8
+ * @return the bits
+ */
+static BYTE pack(const BYTE * flags, unsigned int n, unsigned int byte)
+{
+    BYTE r = 0;
+    unsigned int i = byte * BYTESIZE;
+    for(; i < n && i < (byte + 1) * BYTESIZE; i++){
+        r |= (flags[i] ? 1 : 0) << (i % BYTESIZE);
+    }
+    return r;
+}
+
+/**
+ * @brief append a record if the value changed, or always for a keyframe
+ * @return bytes appended
+ */
+static unsigned int record(BYTE * b, BYTE block, unsigned int index,
+                           uint64_t now, uint64_t last, BYTE key)
+{
+    if(!key && now == last){
+
+        return 0;
+    }
+    b[0] = block;
+    put16(b + 1, index);
+    put64(b + 3, now);
+
+    return WIRE_RECORD;
+}
+
+/**
+ * @return records in a block of an image
+ */
+static unsigned int count(const snapshot_t s, BYTE block)
+{
+    switch(block){
+        case WIRE_I: return s->ni;
+        case WIRE_Q: return s->nq;
+        case WIRE_AI: return s->nai;
+        case WIRE_AQ: return s->naq;
+        case WIRE_M: return s->nm;
+        case WIRE_MR: return s->nmr;
+        case WIRE_T: return s->nt;
+        case WIRE_TQ: return (s->nt + BYTESIZE - 1) / BYTESIZE;
+        case WIRE_S: return (s->ns + BYTESIZE - 1) / BYTESIZE;
+        default: return 0;
+    }
+}
+
+/**
+ * @return the value of a record, index within count()
+ */
+static uint64_t value(const snapshot_t s, BYTE block, unsigned int index)
+{
+    switch(block){
+        case WIRE_I: return s->inputs[index];
+        case WIRE_Q: return s->outputs[index];
+        case WIRE_AI: return real_bits(s->ai[index]);
+        case WIRE_AQ: return real_bits(s->aq[index]);
+        case WIRE_M: return s->m[index];
+        case WIRE_MR: return real_bits(s->mr[index]);
+        case WIRE_T: return (uint64_t)s->t[index];
+        case WIRE_TQ: return pack(s->t_out, s->nt, index);
+        case WIRE_S: return pack(s->s_out, s->ns, index);
+        default: return 0;
+    }
+}
+
+/**
+ * @brief write the header, and the image sizes of a keyframe
+ * @return where records start
+ */
+static BYTE * header(BYTE * buf, BYTE key, unsigned int seq,
+                     const snapshot_t s)
+{
+    BYTE * r = buf + WIRE_HEADER;
+    memcpy(buf, WIRE_MAGIC, 2);
+    buf[2] = WIRE_VERSION;
+    buf[3] = key ? WIRE_KEY : WIRE_DELTA;
+    put32(buf + 4, seq);
+    put32(buf + 8, s->cycle);
+    put32(buf + 12, s->status);
+    if(key){
+        r[0] = s->ni;
+        r[1] = s->nq;
+        r[2] = s->nai;
+        r[3] = s->naq;
+        r[4] = s->nm;
+        r[5] = s->nmr;
+        r[6] = s->nt;
+        r[7] = s->ns;
+        r += WIRE_SIZES;
+    }
+    return r;
+}
+
+/**
+ * @brief count the records, once they are all appended
+ * @return the message length, 0 for a delta without changes
+ */
+static unsigned int finish(BYTE * buf, BYTE key, const BYTE * end)
+{
+    unsigned int n = (end - buf - WIRE_HEADER - (key ? WIRE_SIZES : 0))
+                   / WIRE_RECORD;
+    if(!key && n == 0){
+
+        return 0;
+    }
+    put16(buf + 16, n);
+
+    return end - buf;
+}
+
+unsigned int wire_max(const snapshot_t s)
+{
+    unsigned int n = 0;
+    BYTE b = WIRE_I;
+    for(; b < N_WIRE_BLOCKS; b++){
+        n += count(s, b);
+    }
+    return WIRE_HEADER + WIRE_SIZES + WIRE_RECORD * n;
+}
+
+unsigned int wire_encode(const snapshot_t now, const snapshot_t last,
+                         unsigned int seq, BYTE * buf)
+{
+    BYTE key = last == NULL;
+    const snapshot_t old = key ? now : last;
+    BYTE * r = header(buf, key, seq, now);
+    BYTE b = WIRE_I;
+    unsigned int i = 0;
+    for(; b < N_WIRE_BLOCKS; b++){
+        for(i = 0; i < count(now, b); i++){
+            r += record(r, b, i, value(now, b, i), value(old, b, i), key);
+        }
+    }
+    return finish(buf, key, r);
+}
+
+//configuration block names of what can be watched, by wire block
+static const char * Watchable[N_WIRE_BLOCKS] = {
+    "",
+    "DI",
+    "DQ",
+    "AI",
+    "AQ",
+    "MREG",
+    "MVAR",
+    "TIMERS",
+    "", //timer outputs come with TIMERS
+    "PULSES"
+};
+
+/**
+ * @brief parse an index, a decimal number
+ * @param the text
+ * @param largest valid index
+ * @param the index
+ * @return OK or ERROR if it is not a number, negative or too large
+ */
+static int parse_index(const char * s, unsigned long max, unsigned int * index)
+{
+    char * end = NULL;
+    unsigned long i = 0;
+    if(s == NULL || *s == '-'){
+
+        return PLC_ERR;
+    }
+    i = strtoul(s, &end, 10);
+    if(end == s || *end != 0 || i > max){
+
+        return PLC_ERR;
+    }
+    *index = i;
+
+    return PLC_OK;
+}
+
+static int watch_record(wire_watch_t w, BYTE block, unsigned int index)
+{
+    unsigned int i = 0;
+    for(; i < w->n; i++){
+        if(w->block[i] == block && w->index[i] == index){
+
+            return PLC_OK;
+        }
+    }
+    if(w->n == WIRE_WATCHED){
+
+        return PLC_ERR;
+    }
+    w->block[w->n] = block;
+    w->index[w->n] = index;
+    w->last[w->n++] = 0;
+
+    return PLC_OK;
+}
+
+int wire_watch(const char * spec, wire_watch_t w)
+{
+    char buf[MAXSTR];
+    char * save = NULL;
+    char * name = NULL;
+    char * period = NULL;
+    char * block = NULL;
+    char * index = NULL;
+    int r = PLC_OK;
+    if(spec == NULL
+    || w == NULL
+    || strlen(spec) >= MAXSTR){
+
+        return PLC_ERR;
+    }
+    memset(w, 0, sizeof(struct wire_watch));
+    strcpy(buf, spec);
+    name = strtok_r(buf, " \n", &save);
+    period = strtok_r(NULL, " \n", &save);
+    if(name == NULL
+    || period == NULL
+    || strlen(name) + 2 >= WIRE_TOPIC
+    || atoi(period) < 0){
+
+        return PLC_ERR;
+    }
+    sprintf(w->topic, "%s%s", WIRE_WATCH, name);
+    w->period = atoi(period);
+    while(r == PLC_OK
+    && (block = strtok_r(NULL, " \n", &save))
+    && (index = strtok_r(NULL, " \n", &save))){
+        BYTE b = WIRE_I;
+        unsigned int i = 0;
+        for(; b < N_WIRE_BLOCKS && strcasecmp(block, Watchable[b]); b++);
+        if(b == N_WIRE_BLOCKS
+        || parse_index(index,
+                       b == WIRE_I || b == WIRE_Q || b == WIRE_S ?
+                       WIRE_INDEX * BYTESIZE + BYTESIZE - 1 : WIRE_INDEX,
+                       &i) < 0){
+
+            return PLC_ERR;
+        }
+        switch(b){
+            case WIRE_I:
+            case WIRE_Q:
+            case WIRE_S://a byte of 8 bits per record
+                r = watch_record(w, b, i / BYTESIZE);
+                break;
+            case WIRE_T:
+                r = watch_record(w, b, i);
+                if(r == PLC_OK){
+                    r = watch_record(w, WIRE_TQ, i / BYTESIZE);
+                }
+                break;
+            default:
+                r = watch_record(w, b, i);
+        }
+    }
+    if(block != NULL || w->n == 0){//an index was missing, or nothing to watch
+
+        return PLC_ERR;
+    }
+    return r;
+}
+
+unsigned int wire_encode_watch(const snapshot_t now, wire_watch_t w,
+                               BYTE key, unsigned int seq, BYTE * buf)
+{
+    BYTE * r = header(buf, key, seq, now);
+    unsigned int i = 0;
+    for(; i < w->n; i++){
+        if(w->index[i] < count(now, w->block[i])){
+            uint64_t v = value(now, w->block[i], w->index[i]);
+            r += record(r, w->block[i], w->index[i], v, w->last[i], key);
+            w->last[i] = v;
+        }
+    }
+    return finish(buf, key, r);
+}
+
+static const char * Ops[N_WIRE_OPS] = {
+    "",
+    "FORCE",
+    "UNFORCE",
+    "WRITE"
+};
+
+int wire_batch(const char * spec, wire_batch_t b)
+{
+    char buf[MAXSTR];
+    char * save = NULL;
+    char * op = NULL;
+    char * block = NULL;
+    char * index = NULL;
+    char * value = NULL;
+    if(spec == NULL
+    || b == NULL
+    || strlen(spec) >= MAXSTR){
+
+        return PLC_ERR;
+    }
+    memset(b, 0, sizeof(struct wire_batch));
+    strcpy(buf, spec);
+    op = strtok_r(buf, " \n", &save);
+    for(b->op = WIRE_FORCE; 
+        op && b->op < N_WIRE_OPS && strcasecmp(op, Ops[b->op]); 
+        b->op++);
+    if(op == NULL || b->op == N_WIRE_OPS){
+
+        return PLC_ERR;
+    }
+    while((block = strtok_r(NULL, " \n", &save))){
+        BYTE k = WIRE_I;
+        unsigned int i = 0;
+        index = strtok_r(NULL, " \n", &save);
+        value = b->op == WIRE_UNFORCE ? "0" : strtok_r(NULL, " \n", &save);
+        for(; k <= WIRE_MR && strcasecmp(block, Watchable[k]); k++);
+        if(k > WIRE_MR
+        || index == NULL
+        || value == NULL
+        || parse_index(index, WIRE_INDEX, &i) < 0
+        || b->n == WIRE_BATCH){
+
+            return PLC_ERR;
+        }
+        b->block[b->n] = k;
+        b->index[b->n] = i;
+        switch(k){
+            case WIRE_AI:
+            case WIRE_AQ:
+            case WIRE_MR:
+                b->value[b->n++] = real_bits(atof(value));
+                break;
+            default:
+                b->value[b->n++] = strtoull(value, NULL, 10);
+        }
+    }
+    return b->n > 0 ? PLC_OK : PLC_ERR;
+}
+
+unsigned int wire_encode_batch(const wire_batch_t b, BYTE * buf)
+{
+    BYTE * r = buf + WIRE_BATCH_HEADER;
+    unsigned int i = 0;
+    memcpy(buf, WIRE_COMMAND, 2);
+    buf[2] = WIRE_VERSION;
+    buf[3] = b->op;
+    put16(buf + 4, b->n);
+    for(; i < b->n; i++){
+        r += record(r, b->block[i], b->index[i], b->value[i], 0, TRUE);
+    }
+    return r - buf;
+}
+
+int wire_decode_batch(const BYTE * buf, unsigned int len, wire_batch_t b)
+{
+    const BYTE * r = buf + WIRE_BATCH_HEADER;
+    unsigned int i = 0;
+    if(buf == NULL
+    || b == NULL
+    || len < WIRE_BATCH_HEADER
+    || memcmp(buf, WIRE_COMMAND, 2)
+    || buf[2] != WIRE_VERSION
+    || buf[3] < WIRE_FORCE
+    || buf[3] >= N_WIRE_OPS){
+
+        return PLC_ERR;
+    }
+    b->op = buf[3];
+    b->n = get16(buf + 4);
+    if(b->n == 0
+    || b->n > WIRE_BATCH
+    || len != WIRE_BATCH_HEADER + b->n * WIRE_RECORD){
+
+        return PLC_ERR;
+    }
+    for(; i < b->n; i++, r += WIRE_RECORD){
+        if(r[0] < WIRE_I || r[0] > WIRE_MR){
+
+            return PLC_ERR;
+        }
+        b->block[i] = r[0];
+        b->index[i] = get16(r + 1);
+        b->value[i] = get64(r + 3);
+    }
+    return PLC_OK;
+}
+
+int wire_decode(const BYTE * buf, unsigned int len, wire_header_t h,
+                wire_record_f f, void * arg)
+{
+    const BYTE * r = buf + WIRE_HEADER;
+    unsigned int i = 0;
+    if(buf == NULL
+    || h == NULL
+    || len < WIRE_HEADER
+    || memcmp(buf, WIRE_MAGIC, 2)
+    || buf[2] != WIRE_VERSION
+    || (buf[3] != WIRE_KEY && buf[3] != WIRE_DELTA)){
+
+        return PLC_ERR;
+    }
+    memset(h, 0, sizeof(struct wire_header));
+    h->kind = buf[3];
+    h->seq = get32(buf + 4);
+    h->cycle = get32(buf + 8);
+    h->status = (int)get32(buf + 12);
+    h->records = get16(buf + 16);
+    if(h->kind == WIRE_KEY){
+        if(len < WIRE_HEADER + WIRE_SIZES){
+
+            return PLC_ERR;
+        }
+        memcpy(h->sizes, r, WIRE_SIZES);
+        r += WIRE_SIZES;
+    }
+    if(len < (r - buf) + h->records * WIRE_RECORD){
+
+        return PLC_ERR;
+    }
+    for(; f && i < h->records; i++, r += WIRE_RECORD){
+        f(r[0], get16(r + 1), get64(r + 3), arg);
+    }
+    return PLC_OK;
+}
@@ -0,0 +1,189 @@
+#ifndef _WIRE_H_
+#define _WIRE_H_
+/**
+ *@file wire.h
+ *@brief binary publication of the plc state to ui clients.
+ * A keyframe carries the whole process image, a delta only what changed
+ * since the previous message. Keyframes go out every WIRE_KEYFRAME
+ * messages and whenever a client subscribes, so late joiners and clients
+ * that see a gap in the sequence resynchronize on the next one.
+*/
+
+#define WIRE_MAGIC "PS" //also the subscription prefix
+#define WIRE_WATCH "PW" //prefix of watch list topics
+#define WIRE_COMMAND "PC" //binary commands
+#define WIRE_VERSION 1
+#define WIRE_KEYFRAME 50 //messages between keyframes, at most
+/**
+ * message, network byte order:
+ * magic(2) version(1) kind(1) sequence(4) cycle(4) status(4) records(2)
+ * keyframes go on with the image sizes:
+ * ni(1) nq(1) nai(1) naq(1) nm(1) nmr(1) nt(1) ns(1)
+ * then records: block(1) index(2) value(8)
+ * bits go 8 to a record, reals as IEEE 754 doubles
+ */
+#define WIRE_HEADER 18
+#define WIRE_SIZES 8
+#define WIRE_RECORD 11
+#define WIRE_INDEX 0xFFFF //largest index a record carries
+/**
+ * binary command, a batch of variables applied together:
+ * magic(2) version(1) opcode(1) records(2)
+ * then records as above, with the variable index and the value
+ */
+#define WIRE_BATCH_HEADER 6
+#define WIRE_BATCH 512 //records in a command, at most
+#define WIRE_BATCH_MAX (WIRE_BATCH_HEADER + WIRE_RECORD * WIRE_BATCH)
+#define WIRE_TOPIC 16 //watch list topic, prefix included
+#define WIRE_WATCHED 32 //records in a watch list, at most
+#define WIRE_WATCH_MAX (WIRE_HEADER + WIRE_SIZES + WIRE_RECORD * WIRE_WATCHED)
+
+typedef enum{
+    WIRE_KEY = 1,
+    WIRE_DELTA
+}WIRE_KINDS;
+
+typedef enum{
+    WIRE_FORCE = 1, ///digital values are 0 or 1, reals within their range
+    WIRE_UNFORCE, ///values are ignored
+    WIRE_WRITE, ///%m and %mf values, registers that are not read only
+    N_WIRE_OPS
+}WIRE_OPS;
+
+typedef enum{
+    WIRE_I = 1, ///%i bits, a byte per record
+    WIRE_Q, ///%q bits as driven, a byte per record
+    WIRE_AI, ///analog inputs, scaled
+    WIRE_AQ, ///analog outputs, scaled
+    WIRE_M, ///%m values
+    WIRE_MR, ///%mf values
+    WIRE_T, ///timer values
+    WIRE_TQ, ///timer outputs, a byte per record
+    WIRE_S, ///blinker outputs, a byte per record
+    N_WIRE_BLOCKS
+}WIRE_BLOCKS;
+
+typedef struct wire_header{
+    BYTE kind;
+    unsigned int seq;
+    unsigned int cycle;
+    int status;
+    unsigned int records;
+    BYTE sizes[WIRE_SIZES]; ///keyframes only
+} * wire_header_t;
+
+/**
+ * watch list, the records a client asked for. Messages for it are sent
+ * as two frames, the topic and a message in the format above.
+ */
+typedef struct wire_watch{
+    char topic[WIRE_TOPIC]; ///WIRE_WATCH followed by the name
+    unsigned int period; ///msecs between samples, 0 to send changes only
+    unsigned int n; ///records
+    BYTE block[WIRE_WATCHED];
+    unsigned short index[WIRE_WATCHED];
+    uint64_t last[WIRE_WATCHED]; ///values sent last
+} * wire_watch_t;
+
+/**
+ * @brief called for every record of a message
+ * @param block
+ * @param index in the block
+ * @param value, raw bits of reals
+ * @param caller's argument
+ */
+typedef void (*wire_record_f)(BYTE block, unsigned int index,
+                              uint64_t value, void * arg);
+
+typedef struct wire_batch{
+    BYTE op; ///WIRE_OPS
+    unsigned int n; ///records
+    BYTE block[WIRE_BATCH]; ///WIRE_I, Q, AI, AQ, M or MR
+    unsigned short index[WIRE_BATCH]; ///of the variable, bits one by one
+    uint64_t value[WIRE_BATCH]; ///raw bits of reals
+} * wire_batch_t;
+
+/**
+ * @brief room a message for an image may need
+ * @param the image
+ * @return bytes
+ */
+unsigned int wire_max(const snapshot_t s);
+
+/**
+ * @brief encode a keyframe, or a delta against the previous image
+ * @param the image to send
+ * @param the image sent before, NULL for a keyframe
+ * @param message sequence
+ * @param buffer of wire_max() bytes
+ * @return bytes, 0 for a delta without changes
+ */
+unsigned int wire_encode(const snapshot_t now, const snapshot_t last,
+                         unsigned int seq, BYTE * buf);
+
+/**
+ * @brief parse a watch list
+ * @param "name period block index [block index]...", blocks named as in
+ * the configuration (DI, DQ, AI, AQ, MREG, MVAR, TIMERS, PULSES)
+ * @param the watch list, filled in
+ * @return OK or ERROR, also for an index a record can not carry
+ */
+int wire_watch(const char * spec, wire_watch_t w);
+
+/**
+ * @brief encode the records of a watch list, and remember what was sent
+ * @param the image to send
+ * @param the watch list
+ * @param TRUE for a keyframe, FALSE for what changed since the last one
+ * @param message sequence
+ * @param buffer of WIRE_WATCH_MAX bytes
+ * @return bytes, 0 for a delta without changes
+ */
+unsigned int wire_encode_watch(const snapshot_t now, wire_watch_t w,
+                               BYTE key, unsigned int seq, BYTE * buf);
+
+/**
+ * @brief parse a batch command
+ * @param "FORCE|UNFORCE|WRITE block index [value] [block index [value]]...",
+ * values go with FORCE and WRITE, blocks are named as in the configuration
+ * (DI, DQ, AI, AQ, MREG, MVAR)
+ * @param the batch, filled in
+ * @return OK or ERROR, also for an index above WIRE_INDEX
+ */
+int wire_batch(const char * spec, wire_batch_t b);
+
+/**
+ * @brief encode a batch command
+ * @param the batch
+ * @param buffer of WIRE_BATCH_MAX bytes
+ * @return bytes
+ */
+unsigned int wire_encode_batch(const wire_batch_t b, BYTE * buf);
+
+/**
+ * @brief decode a batch command
+ * @param the message
+ * @param its length
+ * @param the batch, filled in
+ * @return OK or ERROR for a malformed message
+ */
+int wire_decode_batch(const BYTE * buf, unsigned int len, wire_batch_t b);
+
+/**
+ * @brief decode a message
+ * @param the message
+ * @param its length
+ * @param the header, filled in
+ * @param called for every record, can be NULL
+ * @param its argument
+ * @return OK or ERROR for a malformed message
+ */
+int wire_decode(const BYTE * buf, unsigned int len, wire_header_t h,
+                wire_record_f f, void * arg);
+
+/**
+ * @return a real from the raw value of a record
+ */
+double wire_real(uint64_t v);
+
+#endif //_WIRE_H_
@@ -1,36 +1,48 @@
 #include <stdarg.h>
+#include <pthread.h>
 #include <time.h>
 
 #include "data.h"
 
 #include "config.h"
+#include "instruction.h"
+#include "rung.h"
+#include "hardware.h"
+#include "plclib.h"
+#include "snapshot.h"
+#include "wire.h"
 #include "ui.h"
 
 #include "util.h"
 
 extern int UiReady;
 FILE * ErrLog = NULL;
+static pthread_mutex_t LogLock = PTHREAD_MUTEX_INITIALIZER; //programs are compiled in parallel
 
 void plc_log(const char * msg, ...) {
    va_list arg;
-   time_t now;
-   time(&now);
+   struct timeval tv;
+   get_clock(&tv);
+   time_t now = tv.tv_sec;
    char msgstr[MAXSTR];
+   char timestr[32]; //at least 26 for ctime_r
    memset(msgstr,0,MAXSTR);
    va_start(arg, msg);
-   vsprintf(msgstr,msg,arg);
+   vsnprintf(msgstr,MAXSTR,msg,arg);
    va_end(arg);
+   pthread_mutex_lock(&LogLock);
    if(!ErrLog)
       ErrLog = fopen(LOG,"w+");
    if(ErrLog){
       fprintf(ErrLog, "%s", msgstr);
-      fprintf(ErrLog, ":%s", ctime(&now));
+      fprintf(ErrLog, ":%s", ctime_r(&now, timestr));
       fflush(ErrLog);
    }
    //if(UiReady)
        ui_display_message(msgstr);
    //else
    //    printf("%s\n",msgstr);
+   pthread_mutex_unlock(&LogLock);
 }
 
 void close_log() {
@@ -65,4 +77,34 @@ unsigned long get_loop() {
     return Loop;
 }
 
+/*******************clock***************/
 
+unsigned char Virtual = 0;
+struct timeval Clock;
+
+void set_virtual_clock(unsigned char enable) {
+    if(enable && !Virtual){//virtual time starts from now
+        gettimeofday(&Clock, NULL);
+    }
+    Virtual = enable;
+}
+
+unsigned char is_virtual_clock() {
+    return Virtual;
+}
+
+void tick_clock(long usec) {
+    if(Virtual){
+        Clock.tv_usec += usec;
+        Clock.tv_sec += Clock.tv_usec / 1000000;
+        Clock.tv_usec %= 1000000;
+    }
+}
+
+void get_clock(struct timeval * tv) {
+    if(Virtual){
+        *tv = Clock;
+    } else {
+        gettimeofday(tv, NULL);
+    }
+}
@@ -1,14 +1,35 @@
 #ifndef _UTIL_H_
 #define _UTIL_H_
 /**logging, metrics, debugging stuff */
+#include <sys/time.h>
 
 #define LOG "plcemu.log"
 void plc_log(const char * msg, ...);
 void close_log();
-//char * strdup_r(char * dest, const char * src);
 /*******************debugging tools****************/
 void dump_label( char * label, char * dump);
 void compute_variance( double x);
 void get_variance( double * mean, double * var);
 unsigned long get_loop();
+/*******************clock**************************/
+/**
+ * @brief select time source. In virtual mode time stands still
+ * unless explicitly advanced, so the scan loop never waits
+ * @param true for virtual time, false for wall clock
+ */
+void set_virtual_clock(unsigned char enable);
+/**
+ * @return true if the clock is virtual
+ */
+unsigned char is_virtual_clock();
+/**
+ * @brief advance the virtual clock, no effect on wall clock
+ * @param time lapse in usec
+ */
+void tick_clock(long usec);
+/**
+ * @brief current time of the selected time source
+ * @param where to store it
+ */
+void get_clock(struct timeval * tv);
 #endif //_UTIL_H
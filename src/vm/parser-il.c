@@ -132,46 +132,49 @@ int extract_arguments(const char* buf,
     return PLC_OK;
 }
 
+/*operands are single letters, case insensitive, looked up directly*/
+static const BYTE OperandLetters[26] = {
+    ['i' - 'a'] = OP_INPUT,
+    ['f' - 'a'] = OP_FALLING,
+    ['r' - 'a'] = OP_RISING,
+    ['m' - 'a'] = OP_MEMORY,
+    ['t' - 'a'] = OP_TIMEOUT,
+    ['c' - 'a'] = OP_COMMAND,
+    ['b' - 'a'] = OP_BLINKOUT,
+    ['q' - 'a'] = OP_OUTPUT,
+};
+
+static BYTE operand_of(char c)
+{
+    BYTE r = 0;
+    c = tolower(c);
+    if(c >= 'a' && c <= 'z')
+        r = OperandLetters[c - 'a'];
+    return r ? r : (BYTE)ERR_BADCHAR;
+}
+
+static BYTE real_operand(BYTE operand)
+{
+    switch(operand){
+        case OP_INPUT:
+            return OP_REAL_INPUT; 
+        case OP_MEMORY:
+            return OP_REAL_MEMORY;
+        case OP_OUTPUT:
+            return OP_REAL_OUTPUT;
+        default:
+            return (BYTE)PLC_ERR;
+    }
+}
+
 BYTE read_operand(const char *line, unsigned int index)
 { //read ONE character from line[idx]
 //parse grammatically:
-	int r = PLC_OK;
     if (line == NULL
     ||  index > strlen(line))
 		return PLC_ERR;
-    
-    char c = tolower(line[index]);
-    
-    switch (c){
-    case 'i': //input
-        r = OP_INPUT;
-		break;
-	case 'f': //falling edge
-        r = OP_FALLING;
-		break;
-	case 'r': //rising Edge
-        r = OP_RISING;
-		break;
-	case 'm': //pulse of counter
-        r = OP_MEMORY;
-		break;
-	case 't': //timer.q
-        r = OP_TIMEOUT;
-		break;
-	case 'c': //read command
-        r = OP_COMMAND;
-		break;
-	case 'b': //blinker
-        r = OP_BLINKOUT;
-        break;
-    case 'q': //output value
-        r = OP_OUTPUT;
-		break;
-	default:
-		r = (BYTE)ERR_BADCHAR; //error
-	}
 //return value or error
-	return r;
+	return operand_of(line[index]);
 }
 
 BYTE read_type(const char *line, 
@@ -185,21 +188,11 @@ BYTE read_type(const char *line,
 		return PLC_ERR;
 		
     if(tolower(line[index])=='f'){
-        switch(*operand)
-        {
-            case OP_INPUT:
-                *operand = OP_REAL_INPUT; 
-                break;
-            case OP_MEMORY:
-                *operand = OP_REAL_MEMORY;
-                break;
-            case OP_OUTPUT:
-                *operand = OP_REAL_OUTPUT;
-                break;
-            default:
-                r = PLC_ERR;
-                break;
-        }
+        BYTE real = real_operand(*operand);
+        if(real == (BYTE)PLC_ERR)
+            r = PLC_ERR;
+        else
+            *operand = real;
     }    
 //return ok or error
 	return r;
@@ -215,7 +208,7 @@ void read_line_trunk_comments(char* line)
          && line[idx] != ';')
         idx++;
 
-    for(i = idx; line != NULL && i < MAXSTR; i++)
+    for(i = idx; line != NULL && line[i] != 0; i++)
         line[i] = 0; //trunc comments
 }
 
@@ -306,39 +299,55 @@ BYTE read_modifier(const char* buf, char** pos)
     return modifier;
 }
 
-BYTE read_operator(const char* buf, const char* stop)
+/*perfect hash of the operators on their first two characters, 
+no two of them share a slot. Empty slots are IL_NOP, whose name is empty*/
+#define IL_HASH(a, b) (((unsigned char)(a) + 11 * (unsigned char)(b)) & 63)
+
+static const BYTE IlHash[64] = {
+    [IL_HASH(')', 0)] = IL_POP,
+    [IL_HASH('R', 'E')] = IL_RET,
+    [IL_HASH('J', 'M')] = IL_JMP,
+    [IL_HASH('C', 'A')] = IL_CAL,
+    [IL_HASH('S', 0)] = IL_SET,
+    [IL_HASH('R', 0)] = IL_RESET,
+    [IL_HASH('L', 'D')] = IL_LD,
+    [IL_HASH('S', 'T')] = IL_ST,
+    [IL_HASH('A', 'N')] = IL_AND,
+    [IL_HASH('O', 'R')] = IL_OR,
+    [IL_HASH('X', 'O')] = IL_XOR,
+    [IL_HASH('A', 'D')] = IL_ADD,
+    [IL_HASH('S', 'U')] = IL_SUB,
+    [IL_HASH('M', 'U')] = IL_MUL,
+    [IL_HASH('D', 'I')] = IL_DIV,
+    [IL_HASH('G', 'T')] = IL_GT,
+    [IL_HASH('G', 'E')] = IL_GE,
+    [IL_HASH('E', 'Q')] = IL_EQ,
+    [IL_HASH('N', 'E')] = IL_NE,
+    [IL_HASH('L', 'T')] = IL_LT,
+    [IL_HASH('L', 'E')] = IL_LE,
+};
+
+static BYTE operator_of(const char * at, unsigned int len)
 {
-    BYTE op = 0;
-    int i = 0;
-    char * cursor = 0;
-    char op_buf[LABELLEN];
-    memset(op_buf, 0, LABELLEN);
-    if(buf == NULL)
-        return PLC_ERR;
-    if (stop){
-        cursor = (char *)buf;
-        i = 0;
-        memset(op_buf, 0, LABELLEN);
-        while (cursor + i != stop && i < LABELLEN){
-            op_buf[i] = cursor[i];
-            i++;
-        }
-    }
-    else{
-        if (strlen(buf) < LABELLEN)
-            strcpy(op_buf, buf);
-        else
-           return N_IL_INSN;
-    }
-//printf("operator:%s\n",op_buf);
-    op = N_IL_INSN;
-    for (i = 0; i < N_IL_INSN; ++i){
-        if (!strcmp(op_buf, IlCommands[i]))
-            op = i;
+    BYTE op = IL_NOP;
+    if(len > 0){
+        op = IlHash[IL_HASH(at[0], len > 1 ? at[1] : 0)];
+        if(op == IL_NOP
+        || len >= LABELLEN
+        || IlCommands[op][len] != 0
+        || memcmp(at, IlCommands[op], len) != 0)
+            op = N_IL_INSN;
     }
     return op;
 }
 
+BYTE read_operator(const char* buf, const char* stop)
+{
+    if(buf == NULL)
+        return PLC_ERR;
+    
+    return operator_of(buf, stop ? stop - buf : strlen(buf));
+}
 
 int find_arguments(const char* buf,   
                    BYTE* operand, 
@@ -384,102 +393,244 @@ int find_arguments(const char* buf,
     return ret;
 }
 
+/***LEX IN ONE PASS**/
+
+/**
+ * @brief read the operand and its indexes after '%', 
+ * the same way find_arguments does, but not past the end
+ * @param the '%'
+ * @param the first '/' after it, if any
+ * @param the end of the statement
+ * @param the instruction to fill in
+ */
+static void lex_arguments(const char * arg, 
+                          const char * slash,
+                          const char * end,
+                          instruction_t op)
+{
+    const char * p = arg + 1;
+    const char * digits = NULL;
+    unsigned int n = 0;
+    if(p >= end || !isalpha(*p))
+        return;
+    
+    op->operand = operand_of(*p++);
+    if(op->operand == (BYTE)ERR_BADCHAR)
+        return;
+    
+    if(p < end && isalpha(*p)){
+        if(tolower(*p) == 'f'){
+            BYTE real = real_operand(op->operand);
+            if(real == (BYTE)PLC_ERR)
+                return;
+            op->operand = real;
+        }
+        p++;
+    }
+    for(digits = p; p < end && isdigit(*p); p++)
+        n = 10 * n + (*p - '0');
+    op->byte = p > digits ? (BYTE)n : (BYTE)PLC_ERR;
+    if(op->byte == (BYTE)PLC_ERR)
+        return;
+    
+    op->bit = BYTESIZE;
+    if(slash 
+    && slash + 1 < end
+    && isdigit(slash[1]) 
+    && slash[1] <= '7')
+        op->bit = slash[1] - '0';
+}
+
+/**
+ * @brief lex a statement in one pass, without copying it.
+ * The result is the same as that of read_line_trunk_comments, 
+ * trunk_label, read_modifier, read_operator and find_arguments in turn.
+ * @param the statement, without surrounding whitespace
+ * @param its end
+ * @param the instruction to fill in
+ * @return OK or error
+ */
+static int lex_il_line(const char * at, const char * end, instruction_t op)
+{
+    static const BYTE precedence[] = {IL_PUSH, IL_NEG, IL_COND, IL_NORM};
+    const char * found[N_IL_MODIFIERS];//first of each modifier
+    const char * label = NULL;//the last ':'
+    const char * code = NULL;//what follows the label
+    const char * arg = NULL;//the first '%' 
+    const char * slash = NULL;//the first '/' after it
+    const char * pos = NULL;
+    const char * p = at;
+    unsigned int i = 0;
+    
+    memset(found, 0, sizeof(found));
+    for(; p < end && *p != ';' && *p != '\n'; p++){
+        switch(*p){
+            case ':'://whatever came before was the label
+                label = p;
+                code = arg = slash = NULL;
+                memset(found, 0, sizeof(found));
+                continue;
+            case '(':
+                found[IL_PUSH] = found[IL_PUSH] ? found[IL_PUSH] : p;
+                break;
+            case '!':
+                found[IL_NEG] = found[IL_NEG] ? found[IL_NEG] : p;
+                break;
+            case '?':
+                found[IL_COND] = found[IL_COND] ? found[IL_COND] : p;
+                break;
+            case ' ':
+                if(code != NULL && found[IL_NORM] == NULL)
+                    found[IL_NORM] = p;
+                break;
+            case '%':
+                arg = arg ? arg : p;
+                break;
+            case '/':
+                slash = (arg && !slash) ? p : slash;
+                break;
+            default: break;
+        }
+        if(code == NULL && !IS_WHITESPACE(*p))
+            code = p;
+    }
+    end = p;//comments are dropped
+    while(end > at && IS_WHITESPACE(end[-1]))
+        end--;
+    if(code == NULL || code > end)
+        code = end;
+    if(found[IL_NORM] >= end)//trailing, so not a modifier
+        found[IL_NORM] = NULL;
+    
+    if(label){
+        const char * l = at;
+        while(l < label && IS_WHITESPACE(label[-1]))
+            label--;
+        i = label - l < MAX_LABEL ? label - l : MAX_LABEL - 1;
+        memcpy(op->label, l, i);
+    }
+    op->modifier = NOP;
+    for(i = 0; i < sizeof(precedence) && pos == NULL; i++){
+        pos = found[precedence[i]];
+        op->modifier = pos ? precedence[i] : NOP;
+    }
+    op->operation = operator_of(code, (pos ? pos : end) - code);
+    
+    if (op->operation == N_IL_INSN)
+        return ERR_BADOPERATOR;
+    else if (op->operation > IL_CAL && arg)
+        lex_arguments(arg, slash, end, op);
+    else if (op->operation == IL_JMP){
+        if(pos == NULL)//nowhere to jump to
+            return ERR_BADOPERAND;
+        i = end - pos - 1 < MAX_LABEL ? end - pos - 1 : MAX_LABEL - 1;
+        memcpy(op->lookup, pos + 1, i);
+    }
+    return PLC_OK;
+}
+
+/**
+ * @brief keep a line in the listing, after the last line known, 
+ * so that a long listing is walked once
+ * @param the line
+ * @param its length
+ * @param the rung
+ * @param the last line, if known
+ */
+static void add_code(const char * at, 
+                     unsigned int len, 
+                     rung_t r, 
+                     codeline_t * last)
+{
+    codeline_t l = (codeline_t)calloc(1, sizeof(struct codeline));
+    l->line = strndup(at, len);
+    if(*last == NULL){
+        *last = r->code;
+        while(*last != NULL && (*last)->next != NULL)
+            *last = (*last)->next;
+    }
+    if(*last != NULL)
+        (*last)->next = l;
+    else
+        r->code = l;
+    *last = l;
+}
+
 /***PARSE & GENERATE CODE**/
-int parse_il_line(const char * line, rung_t r)
-{ //    line format:[label:]<operator>[<modifier>[%<operand><byte>[/<bit>]]|<label>][;comment]
-	char tmp[MAXSTR];
-	char buf[MAXSTR];
-	char label_buf[MAXSTR];
-    char * pos = NULL;
-    BYTE byte=0;
-    BYTE bit=0;
-    BYTE modifier=0;
-    BYTE operand=0;
-    BYTE oper=0;
+static int parse_il_text(const char * line, 
+                         unsigned int len, 
+                         rung_t r,
+                         codeline_t * last)
+{
+    const char * end = line + len;
+    int rv = PLC_OK;
     struct instruction op;
     
     memset(&op, 0, sizeof(struct instruction));
-	memset(label_buf, 0, MAXBUF);
-	memset(tmp, 0, MAXSTR);
-	memset(buf, 0, MAXSTR);
-	
-	if(line == NULL
-	|| r == NULL)
-        return PLC_ERR;
-	
-	sprintf(tmp, "%s", line);
-	
-	r->code = append_line(trunk_whitespace(tmp), r->code);
-	
-	read_line_trunk_comments(tmp);
-    trunk_label(tmp, buf, label_buf);
-    trunk_whitespace(label_buf);
-    trunk_whitespace(buf);
-   
-    sprintf(op.label, "%s", label_buf);
+    while(line < end && IS_WHITESPACE(*line))
+        line++;
+    while(end > line && IS_WHITESPACE(end[-1]))
+        end--;
+    add_code(line, end - line, r, last);
     
-    modifier = read_modifier(buf, &pos);
-    oper = read_operator(buf, pos);
-
-    if (oper == N_IL_INSN)
-		return ERR_BADOPERATOR;
-
-    if (oper > IL_CAL)
-	    find_arguments(buf, &operand, &byte, &bit);
-    else if (oper == IL_JMP)
-        strcpy(op.lookup, pos + 1); 
-	
-    op.operation = oper;
-	op.modifier = modifier;
-	op.operand = operand;
-	op.byte = byte;
-	op.bit = bit;
-	
-	if(check_modifier(&op)<0){
-        return ERR_BADOPERATOR;
+    rv = lex_il_line(line, end, &op);
+    if(rv == PLC_OK && check_modifier(&op)<0){
+        rv = ERR_BADOPERATOR;
     }
-    if(check_operand(&op)<0){
-        return ERR_BADOPERAND;
+    if(rv == PLC_OK && check_operand(&op)<0){
+        rv = ERR_BADOPERAND;
 	}
-	if(op.operation != IL_NOP){
+	if(rv == PLC_OK && op.operation != IL_NOP){
 	    append(&op, r);
 	}
-	return PLC_OK ;
+	return rv;
+}
+
+int parse_il_line(const char * line, rung_t r)
+{ //    line format:[label:]<operator>[<modifier>[%<operand><byte>[/<bit>]]|<label>][;comment]
+    codeline_t last = NULL;
+	if(line == NULL
+	|| r == NULL)
+        return PLC_ERR;
+	
+	return parse_il_text(line, strlen(line), r, &last);
 }
 /****************entry point**************************/
 plc_t parse_il_program(const char * name, 
-                       const char lines[][MAXSTR], 
+                       const struct line_view lines[], 
+                       unsigned int n,
                        plc_t p)
 {
     int rv = PLC_OK;
     unsigned int i = 0;
+    codeline_t last = NULL;
     rung_t r = mk_rung(name, p);
     while(rv == PLC_OK 
-    && i < MAXBUF
-    && lines[i][0] != 0){
-        const char * line = lines[i++];
-        rv = parse_il_line(line, r);
+    && i < n){
+        const char * line = lines[i].at;
+        int len = lines[i++].len;
+        rv = parse_il_text(line, len, r, &last);
         switch(rv){
             case PLC_ERR:
-                plc_log("Line %d :%s %s", i, IlErrors[IE_PLC], line);
+                plc_log("Line %d :%s %.*s", i, IlErrors[IE_PLC], len, line);
                 break;
             case ERR_BADOPERATOR:
-                plc_log("Line %d :%s %s", i, IlErrors[IE_BADOPERATOR], line);
+                plc_log("Line %d :%s %.*s", i, IlErrors[IE_BADOPERATOR], len, line);
                 break;
             case ERR_BADCOIL:
-                plc_log("Line %d :%s %s", i, IlErrors[IE_BADCOIL], line);
+                plc_log("Line %d :%s %.*s", i, IlErrors[IE_BADCOIL], len, line);
                 break;
             case ERR_BADINDEX:
-                plc_log("Line %d :%s %s", i, IlErrors[IE_BADINDEX], line);
+                plc_log("Line %d :%s %.*s", i, IlErrors[IE_BADINDEX], len, line);
                 break;
             case ERR_BADOPERAND:
-                plc_log("Line %d :%s %s", i, IlErrors[IE_BADOPERAND], line);
+                plc_log("Line %d :%s %.*s", i, IlErrors[IE_BADOPERAND], len, line);
                 break;
             case ERR_BADFILE:
-                plc_log("Line %d :%s %s", i, IlErrors[IE_BADFILE], line);
+                plc_log("Line %d :%s %.*s", i, IlErrors[IE_BADFILE], len, line);
                 break;
             case ERR_BADCHAR:
-                plc_log("Line %d :%s %s", i, IlErrors[IE_BADCHAR], line);
+                plc_log("Line %d :%s %.*s", i, IlErrors[IE_BADCHAR], len, line);
                 break;    
             default: break;
         }
@@ -1,4 +1,5 @@
 #include <ctype.h>
+#include <limits.h>
 
 #include "util.h"
 #include "config.h"
@@ -58,7 +59,7 @@ int minmin(const int * arr, int min, int max) {
 //for an array arr of integers ,return the smallest of indices i so that 
 //arr[i] =  min(arr) >= min 
 	int i;
-	int v = MAXSTR;		//cant be more than length  of line
+	int v = INT_MAX;		//cant be more than length  of line
 	int r = PLC_ERR;
 	for (i = max - 1; i >= 0; i--){
 		if (arr[i] <= v && arr[i] >= min){
@@ -353,19 +354,7 @@ int vertical_parse(unsigned int start,
     return rv;
 }                   
 
-static unsigned int program_length(const char lines[][MAXSTR], 
-                            unsigned int max) {
-    int i = 0; 
-    for(; i < max; i++){
-        if(lines == NULL
-        || lines[i] == NULL
-        || lines[i][0] == 0)
-            break;       
-    }
-    return i;
-}
-
-ld_line_t * construct_program(const char lines[][MAXSTR], 
+ld_line_t * construct_program(const struct line_view lines[], 
                               unsigned int length) {
     ld_line_t * program = (ld_line_t *)malloc(length*sizeof(ld_line_t));
     memset(program, 0, length*sizeof(ld_line_t));
@@ -376,7 +365,7 @@ ld_line_t * construct_program(const char lines[][MAXSTR],
             ld_line_t line  = (ld_line_t)malloc(sizeof(struct ld_line)); 
             line->cursor = 0;
             line->status = STATUS_UNRESOLVED;
-            line->buf = strdup(lines[i]);
+            line->buf = strndup(lines[i].at, lines[i].len);
             line->stmt = NULL;
             program[i] = line;
         }
@@ -418,14 +407,14 @@ plc_t generate_code(unsigned int length,
 
 /***************************entry point*******************************/
 plc_t parse_ld_program(const char * name, 
-                       const char lines[][MAXSTR], 
+                       const struct line_view lines[], 
+                       unsigned int len,
                        plc_t p) {
     int rv = PLC_OK;
     if(p == NULL){
     
         return NULL;
     }    
-    unsigned int len = program_length(lines, MAXBUF); 
     ld_line_t * program = construct_program(lines, len);
     
     int node = 0; 
@@ -448,10 +437,11 @@ plc_t parse_ld_program(const char * name,
     
         p = generate_code(len, name, program, p);
         
-        char dump[MAXBUF];
-        memset(dump, 0, MAXBUF);
-        dump_rung(p->rungs[0], dump);
-        plc_log(dump);
+        rung_t r = p->rungs[p->rungno - 1];//generated code has no labels
+        char * dump = (char *)calloc(r->insno + 1, DUMPLEN);
+        dump_rung(r, dump);
+        plc_log("%s", dump);
+        free(dump);
     }
     destroy_program(len, program);
     return p;
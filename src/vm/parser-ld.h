@@ -66,11 +66,11 @@ int minmin(const int *arr, int min, int max);
 
 /**
   * @brief construct array of ld lines and initialize with text lines
-  * @param the pre allocated text lines
+  * @param the text lines
   * @param the number of lines
   * @return newly allocated array
   */ 
-ld_line_t * construct_program(const char lines[][MAXSTR], 
+ld_line_t * construct_program(const struct line_view lines[], 
                               unsigned int length);
 
 /**
@@ -128,7 +128,5 @@ int find_next_node(const ld_line_t * program,
 
 
 
-//ld_line_t * mk_lines(char lines[MAXBUF][MAXSTR]);
-
 #endif //_PARSER_LD_H
 
@@ -70,8 +70,8 @@ item_t clear_tree(item_t root)
         }
         //tree leaves
         if(r!=NULL){
-            free(r);
             memset(r, 0, sizeof(struct item));
+            free(r);
             r = (item_t)NULL;
         }
     }
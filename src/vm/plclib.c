@@ -1,5 +1,8 @@
 #include <fcntl.h>
+#include <pthread.h>
 #include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -30,7 +33,7 @@ int open_pipe(const char * pipe, plc_t p) {
     p->com[0].events = POLLIN | POLLPRI;
     int r = p->com[0].fd > 0? PLC_OK: PLC_ERR;
 
-    gettimeofday(&Curtime, NULL);
+    get_clock(&Curtime);
     
     return r;
 }
@@ -910,10 +913,7 @@ int instruct(plc_t p, rung_t r, unsigned int *pc)
     return error;
 }
 
-rung_t mk_rung(const char * name, plc_t p) {
-    rung_t r = (rung_t)malloc(sizeof(struct rung));
-    memset(r, 0, sizeof(struct rung));
-    r->id = strdup(name);
+static rung_t add_rung(rung_t r, plc_t p) {
     if(p->rungs == NULL){//lazy allocation
        p->rungs = (rung_t *)malloc(MAXRUNG*sizeof(rung_t));
        memset(p->rungs, 0, MAXRUNG*sizeof(rung_t));
@@ -923,6 +923,14 @@ rung_t mk_rung(const char * name, plc_t p) {
     return r;
 }
 
+rung_t mk_rung(const char * name, plc_t p) {
+    rung_t r = (rung_t)malloc(sizeof(struct rung));
+    memset(r, 0, sizeof(struct rung));
+    r->id = strdup(name);
+    
+    return add_rung(r, p);
+}
+
 rung_t get_rung(const plc_t p, const unsigned int idx) {
     if(p==NULL
     || idx >= p->rungno){ 
@@ -957,18 +965,19 @@ int timeval_subtract(struct timeval *result,
 	return x->tv_sec < y->tv_sec;
 }
 
-void read_inputs(plc_t p) {
+int read_inputs(plc_t p) {
     int i=0;
     int n=0;
     int j=0;
+    int r=PLC_OK;
     
     BYTE i_bit = 0;
     
     if(p == NULL
     || p->hw == NULL)
-        return;
+        return PLC_ERR;
     
-    p->hw->fetch();//for simulation
+    r = p->hw->fetch();//inputs that failed keep their last values
     
     for (i = 0; i < p->ni; i++){	//for each input byte
         p->inputs[i] = 0;
@@ -983,9 +992,10 @@ void read_inputs(plc_t p) {
     for (i = 0; i < p->nai; i++){	//for each input sample
         p->hw->data_read(i, &p->real_in[i]);
     }
+    return r;
 }
 
-void write_outputs(plc_t p) {
+int write_outputs(plc_t p) {
     int j=0;
     int n=0;
     int q_bit=0;
@@ -993,7 +1003,7 @@ void write_outputs(plc_t p) {
     int i=0;
     if(p == NULL
     || p->hw == NULL)
-        return;
+        return PLC_ERR;
     
     for (i = 0; i < p->nq; i++){	
         for (j = 0; j < BYTESIZE; j++){	//write n bit out
@@ -1005,12 +1015,11 @@ void write_outputs(plc_t p) {
     for (i = 0; i < p->naq; i++){	//for each output sample
         p->hw->data_write(i, p->real_out[i]);
     }
-    p->hw->flush();//for simulation
+    return p->hw->flush();
 }
 /*TODO: how is force implemented for variables and timers?*/
-plc_t force(plc_t p, int op, BYTE i, char * val){
-    if(p == NULL
-    || val == NULL){
+plc_t force_value(plc_t p, int op, unsigned int i, double val){
+    if(p == NULL){
         return NULL;
     }
     plc_t r = NULL;
@@ -1018,41 +1027,33 @@ plc_t force(plc_t p, int op, BYTE i, char * val){
         case OP_REAL_INPUT: 
             if(i < p->nai){
                 r = p;
-                double f_val =  atof(val);
-                if(f_val > r->ai[i].min
-                && f_val < r->ai[i].max){
-                    r->ai[i].mask = f_val;
+                if(val > r->ai[i].min
+                && val < r->ai[i].max){
+                    r->ai[i].mask = val;
                 }    
             }
         break;
         case OP_INPUT: 
-            if(i < p->ni){
+            if(i < p->ni * BYTESIZE){
                 r = p;
-                if(atoi(val)){
-                    r->di[i].MASK = 1;
-                 }else{
-                    r->di[i].N_MASK = 1;
-                 }    
+                r->di[i].MASK = val != 0;
+                r->di[i].N_MASK = val == 0;
             }
         break;
         case OP_REAL_OUTPUT: 
             if(i < p->naq){
                 r = p;
-                double f_val =  atof(val);
-                if(f_val > r->aq[i].min
-                && f_val < r->aq[i].max){
-                    r->aq[i].mask = f_val;
+                if(val > r->aq[i].min
+                && val < r->aq[i].max){
+                    r->aq[i].mask = val;
                 }
             }
         break;
         case OP_OUTPUT: 
-            if(i < p->nq){
+            if(i < p->nq * BYTESIZE){
                 r = p;
-                if(atoi(val)){
-                    r->dq[i].MASK = 1;                   
-                }else{
-                    r->dq[i].N_MASK = 1;
-                }    
+                r->dq[i].MASK = val != 0;
+                r->dq[i].N_MASK = val == 0;
             }
         break;
         default: break;
@@ -1060,7 +1061,19 @@ plc_t force(plc_t p, int op, BYTE i, char * val){
     return r;
 }
 
-plc_t unforce(plc_t p, int op, BYTE i){
+plc_t force(plc_t p, int op, unsigned int i, char * val){
+    if(p == NULL
+    || val == NULL){
+        return NULL;
+    }
+    if(op == OP_INPUT || op == OP_OUTPUT){
+    
+        return force_value(p, op, i, atoi(val));
+    }
+    return force_value(p, op, i, atof(val));
+}
+
+plc_t unforce(plc_t p, int op, unsigned int i){
     if(p == NULL){
         return NULL;
     }
@@ -1073,7 +1086,7 @@ plc_t unforce(plc_t p, int op, BYTE i){
             }
             break;
         case OP_INPUT: 
-            if(i < p->ni){
+            if(i < p->ni * BYTESIZE){
                 r = p;
                 r->di[i].MASK = 0;
                 r->di[i].N_MASK = 0;     
@@ -1086,7 +1099,7 @@ plc_t unforce(plc_t p, int op, BYTE i){
             }
         break;
         case OP_OUTPUT: 
-            if(i < p->nq){
+            if(i < p->nq * BYTESIZE){
                 r = p;
                 r->dq[i].MASK = 0;
                 r->dq[i].N_MASK = 0;    
@@ -1097,14 +1110,17 @@ plc_t unforce(plc_t p, int op, BYTE i){
     return r;
 }
 
-int is_forced(const plc_t p, int op, BYTE i) {
+int is_forced(const plc_t p, int op, unsigned int i) {
     int r = PLC_ERR;
+    if(p == NULL){
+        return r;
+    }
     switch(op){
-        case OP_INPUT:if(i < p->ni){
+        case OP_INPUT:if(i < p->ni * BYTESIZE){
                                 r = p->di[i].MASK || p->di[i].N_MASK;
                            }
                            break;
-        case OP_OUTPUT:if(i < p->nq){
+        case OP_OUTPUT:if(i < p->nq * BYTESIZE){
                                 r = p->dq[i].MASK || p->dq[i].N_MASK;;
                             }
                             break;                    
@@ -1132,7 +1148,7 @@ BYTE dec_inp(plc_t p) { //decode input bytes
         if (p->inputs[i] != p->old->inputs[i]){
             i_changed = TRUE;
         }
-	    for(; j < BYTESIZE; j++){
+	    for(j = 0; j < BYTESIZE; j++){
 	        unsigned int n = BYTESIZE * i + j;
 //negative mask has precedence		        
 		    p->di[n].I = (((p->inputs[i] >> j) % 2) 
@@ -1169,7 +1185,7 @@ BYTE enc_out(plc_t p) { //encode digital outputs to output bytes
 	memcpy(out, p->outputs, p->nq);
 	
 	for (; i < p->nq ; i++){//write masked outputs
-        for(; j < BYTESIZE; j++){
+        for(j = 0; j < BYTESIZE; j++){
             unsigned int n = BYTESIZE * i + j;
             
                 out[i] |= ((p->dq[n].Q 
@@ -1306,12 +1322,189 @@ BYTE manage_blinkers(plc_t p) {
     return s_changed;
 }
 
+/*compiled program images are a cache local to the host, 
+so numbers are in its byte order*/
+#define PROGRAM_MAGIC 0x50434c50 //"PLCP"
+#define PROGRAM_VERSION 2
+
+struct program_header {
+    unsigned int magic;
+    unsigned int version;
+    uint64_t key; //of the source
+    unsigned int length; //of the payload
+    unsigned int sum; //of the payload
+};
+
+static unsigned int hash_bytes(const char * buf, size_t len) {
+//FNV-1a
+    unsigned int h = 2166136261u;
+    size_t i = 0;
+    for(; i < len; i++){
+        h = (h ^ (unsigned char)buf[i]) * 16777619u;
+    }
+    return h;
+}
+
+static uint64_t hash_key(const char * buf, size_t len) {
+//64 bit FNV-1a, wide enough not to run stale rungs for an edited program
+    uint64_t h = 14695981039346656037ull;
+    size_t i = 0;
+    for(; i < len; i++){
+        h = (h ^ (unsigned char)buf[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+/**
+ * @brief map a program source to memory
+ * @param the path
+ * @param where to store its size
+ * @return the source, "" for an empty one, or NULL
+ */
+static const char * map_source(const char * path, size_t * size) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+    
+        return NULL;
+    }
+    if(fstat(fd, &st) < 0){
+        close(fd);
+        
+        return NULL;
+    }
+    *size = st.st_size;
+    if(*size == 0){
+        close(fd);
+        
+        return "";
+    }
+    void * src = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    
+    return src == MAP_FAILED ? NULL : (const char *)src;
+}
+
+unsigned int split_lines(const char * src, size_t size, line_view_t * lines) {
+    unsigned int n = 0;
+    unsigned int cap = MAXBUF;
+    const char * end = src + size;
+    const char * at = src;
+    *lines = (line_view_t)malloc(cap * sizeof(struct line_view));
+    while(at < end){
+        const char * eol = (const char *)memchr(at, '\n', end - at);
+        if(eol == NULL){//the last line has no newline
+            eol = end;
+        }
+        if(n == cap){
+            cap *= 2;
+            *lines = (line_view_t)realloc(*lines, 
+                                          cap * sizeof(struct line_view));
+        }
+        (*lines)[n].at = at;
+        (*lines)[n++].len = eol - at;
+        at = eol + 1;
+    }
+    return n;
+}
+
+static int save_program_image(const char * path, 
+                              uint64_t key, 
+                              const rung_t r) {
+    struct program_header head;
+    char tmp[MAXSTR];
+    int rv = PLC_ERR;
+    FILE * f = NULL;
+    unsigned int len = 0;
+    char * buf = NULL;
+    //written aside and renamed, so that a reader never sees half of it
+    if(snprintf(tmp, MAXSTR, "%s.tmp", path) >= MAXSTR){
+    
+        return PLC_ERR;
+    }
+    len = pack_rung(r, NULL);
+    buf = (char *)malloc(len);
+    pack_rung(r, buf);
+    head.magic = PROGRAM_MAGIC;
+    head.version = PROGRAM_VERSION;
+    head.key = key;
+    head.length = len;
+    head.sum = hash_bytes(buf, len);
+    if((f = fopen(tmp, "wb"))){
+        if(fwrite(&head, sizeof(head), 1, f) == 1
+        && fwrite(buf, 1, len, f) == len){
+            rv = PLC_OK;
+        }
+        if(fclose(f) != 0){
+            rv = PLC_ERR;
+        }
+        if(rv == PLC_OK && rename(tmp, path) != 0){
+            rv = PLC_ERR;
+        }
+        if(rv < PLC_OK){
+            unlink(tmp);
+        }
+    }
+    free(buf);
+    
+    return rv;
+}
+
+static int load_program_image(const char * path, 
+                              uint64_t key, 
+                              const char * name, 
+                              plc_t p) {
+    struct program_header head;
+    struct stat st;
+    int rv = PLC_ERR;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+    
+        return PLC_ERR;
+    }
+    if(fstat(fd, &st) < 0
+    || st.st_size < (off_t)sizeof(head)
+    || p->rungno >= MAXRUNG){
+        close(fd);
+        
+        return PLC_ERR;
+    }
+    const char * map = (const char *)mmap(
+        NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+    
+        return PLC_ERR;
+    }
+    memcpy(&head, map, sizeof(head));
+    unsigned int len = st.st_size - sizeof(head);
+    if(head.magic == PROGRAM_MAGIC
+    && head.version == PROGRAM_VERSION
+    && head.key == key
+    && head.length == len
+    && head.sum == hash_bytes(map + sizeof(head), len)){
+        rung_t r = mk_rung(name, p);
+        rv = unpack_rung(map + sizeof(head), len, r);
+        if(rv < PLC_OK){//a bad image leaves no rung behind
+            p->rungs[--p->rungno] = NULL;
+            free(r->id);
+            free(r);
+        }
+    }
+    munmap((void *)map, st.st_size);
+    
+    return rv;
+}
+
 plc_t plc_load_program_file(const char * path, plc_t plc) {
-    FILE * f;
     int r = ERR_BADFILE;
-    char program_lines[MAXBUF][MAXSTR];///program lines
-    char line[MAXSTR];
-    int i=0;
+    const char * src = NULL;
+    size_t size = 0;
+    line_view_t lines = NULL;
+    unsigned int n = 0;
+    char image[MAXSTR];
+    int cached = FALSE;
+    uint64_t key = 0;
     
     if(path == NULL){
     
@@ -1326,28 +1519,112 @@ plc_t plc_load_program_file(const char * path, plc_t plc) {
         }else if(strcmp(ext, ".ld") == 0) {
             lang = LANG_LD;
         }
-    }          
-    if (lang > PLC_ERR && (f = fopen(path, "r"))) {
-        memset(line, 0, MAXSTR);
-       
-        while (fgets(line, MAXSTR, f)) {
-            memset(program_lines[i], 0, MAXSTR);
-            sprintf(program_lines[i++], "%s\n", line);
-        }
+    }
+    //the parsers read the lines where they are mapped
+    if(lang > PLC_ERR && (src = map_source(path, &size))){
         r = PLC_OK;
-    } 
-    if(r > PLC_ERR){
+        key = hash_key(src, size);
+        //a name too long for its image is not cached
+        cached = snprintf(image, MAXSTR, "%s%s", path, PROGRAM_IMAGE) 
+            < MAXSTR;
+    }
+    //an unchanged program is not parsed again, its image is mapped instead
+    if(r == PLC_OK 
+    && cached
+    && load_program_image(image, key, path, plc) == PLC_OK){
+        plc_log("Loaded program image %s", image);
+        plc->status = PLC_OK;
+    } else if(r == PLC_OK){
+        n = split_lines(src, size, &lines);
         if(lang == LANG_IL){
             plc_log("Loading IL code from %s...", path);
-            plc = parse_il_program(path, program_lines, plc);
+            plc = parse_il_program(path, lines, n, plc);
         }else{ 
             plc_log("Loading LD code from %s...", path);
-            plc = parse_ld_program(path, program_lines, plc);   
+            plc = parse_ld_program(path, lines, n, plc);   
+        }
+        if(plc->status == PLC_OK 
+        && cached
+        && save_program_image(image, key, plc->rungs[plc->rungno - 1]) 
+            < PLC_OK){
+            plc_log("Could not save program image %s", image);
         }
+        free(lines);
     } else {
         plc_log("Could not open program file %s...", path);
         plc->status = r;
     }
+    if(size > 0){
+        munmap((void *)src, size);
+    }
+    return plc;
+}
+
+/*each program is compiled on a plc of its own, 
+that only holds its rungs and status*/
+typedef struct compile_job {
+    const char * path;
+    struct PLC_regs plc;
+} * compile_job_t;
+
+typedef struct compile_queue {
+    compile_job_t jobs;
+    unsigned int n;
+    unsigned int next; //taken by the workers
+} * compile_queue_t;
+
+static void * compile_programs(void * arg) {
+    compile_queue_t q = (compile_queue_t)arg;
+    unsigned int i = 0;
+    while((i = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED)) < q->n){
+        plc_load_program_file(q->jobs[i].path, &(q->jobs[i].plc));
+    }
+    return NULL;
+}
+
+plc_t plc_load_program_files(const char * paths[], 
+                             unsigned int n, 
+                             plc_t plc) {
+    struct compile_queue q;
+    pthread_t workers[MAXCOMPILERS];
+    unsigned int started = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if(plc == NULL || n == 0){
+    
+        return plc;
+    }
+    q.jobs = (compile_job_t)calloc(n, sizeof(struct compile_job));
+    q.n = n;
+    q.next = 0;
+    for(; i < n; i++){
+        q.jobs[i].path = paths[i];
+    }
+    //the calling thread compiles too
+    for(; started + 1 < n 
+        && started + 1 < cores 
+        && started < MAXCOMPILERS; started++){
+        if(pthread_create(&workers[started], NULL, 
+                          compile_programs, &q) != 0){
+            break;
+        }
+    }
+    compile_programs(&q);
+    for(i = 0; i < started; i++){
+        pthread_join(workers[i], NULL);
+    }
+    //in declaration order, as if they were loaded one after the other
+    for(i = 0; i < n; i++){
+        plc_t p = &(q.jobs[i].plc);
+        for(j = 0; j < p->rungno; j++){
+            add_rung(p->rungs[j], plc);
+        }
+        free(p->rungs);
+        plc->status = p->status;
+    }
+    free(q.jobs);
+    
     return plc;
 }
 
@@ -1358,6 +1635,10 @@ plc_t plc_start(plc_t p){
         return NULL;
     }
     
+    if(p->status == ERR_HARDWARE){//halted by its i/o, which starts over
+        p->hw->disable();
+        p->status = ST_STOPPED;
+    }
     if(p->hw->status != PLC_OK
     || p->hw->enable() != PLC_OK
     ){
@@ -1390,15 +1671,13 @@ plc_t plc_stop(plc_t p){
 }
 
 plc_t plc_func(plc_t p) {
-	struct timeval tp; //time for poll
-	struct timeval tn; //time since beginning of last output
+	struct timeval tn; //time at the start of the cycle
+	struct timeval tp; //time after input
 	struct timeval dt;
-    long timeout = p->step * THOUSAND; //timeout in usec
-    long poll_time = 0;
     long io_time = 0;
-	static long run_time = 0;
-	int written=FALSE;
+	long run_time = 0;
     int r = PLC_OK;
+    int io = PLC_OK;
     BYTE change_mask = p->update;
 	BYTE i_changed = FALSE;
 	BYTE o_changed = FALSE;
@@ -1409,56 +1688,45 @@ plc_t plc_func(plc_t p) {
     dt.tv_sec = 0;
     dt.tv_usec = 0;
 	if ((p->status) == ST_RUNNING){//run
-//remaining time = step 
-        read_inputs(p);
+        if(p->hw 
+        && p->hw->sync 
+        && p->hw->sync() != PLC_OK){
+//lock-step: the simulator has not handed over the next cycle yet
+        
+            return p;
+        }
+        get_clock(&tn);
+        io = read_inputs(p);
         t_changed = manage_timers(p);
         s_changed = manage_blinkers(p);
         read_mvars(p);
         
-        gettimeofday(&tn,NULL);
-//dt = time for input + output	
-//how much time passed since previous cycle?
-        timeval_subtract(&dt, &tn, &Curtime);
-        dt.tv_usec = dt.tv_usec % (THOUSAND * p->step);
-        io_time = dt.tv_usec;// / THOUSAND;
-        timeout -= io_time;
-        timeout -= run_time;
-//plc_log("I/O time approx:%d microseconds",dt.tv_usec);
-//poll on plcpipe for command, for max STEP msecs
-        written = poll(p->com, 0, timeout / THOUSAND);
-//TODO: when a truly asunchronous UI is available, 
-//replace poll() with sleep() for better accuracy
-        gettimeofday(&tp, NULL);	//how much time did poll wait?
+        get_clock(&tp);
         timeval_subtract(&dt, &tp, &tn);
-        poll_time =  dt.tv_usec;
-//plc_log("Poll time approx:%d microseconds",dt.tv_usec);
-//dt = time(input) + time(poll)
-        
-        if (written<0){
-		    r = PLC_ERR;
-            plc_log("PIPE ERROR\n");
-			p->command = 0;
-		}
+        io_time = dt.tv_usec;
+//plc_log("I/O time approx:%d microseconds",dt.tv_usec);
         i_changed = dec_inp(p); //decode inputs
 //TODO: a better user plugin system when function blocks are implemented
 		project_task(p); //plugin code
 
-        if(r >= PLC_OK)
-            r = all_tasks(p->step * THOUSAND, p);
+        r = all_tasks(p->step * THOUSAND, p);
                 
-        gettimeofday(&Curtime, NULL);	//start timing next cycle
+        tick_clock(p->step * THOUSAND); //a virtual cycle lasts exactly 1 step
+        get_clock(&Curtime);
         timeval_subtract(&dt, &Curtime, &tp);
         run_time =  dt.tv_usec;
-        compute_variance((double)(run_time + poll_time + io_time));
+        compute_variance((double)(run_time + io_time));
         
         if(r == ERR_TIMEOUT){    
-            plc_log("timeout! i/o: %d us, poll: %d us, run: %d us",
-                    io_time, poll_time, run_time);
+            plc_log("timeout! i/o: %d us, run: %d us",
+                    io_time, run_time);
         }
         o_changed = enc_out(p);
 		p->command = 0;
 
-        write_outputs(p);
+        if(write_outputs(p) == ERR_HARDWARE){
+            io = ERR_HARDWARE;
+        }
 
         m_changed = check_pulses(p);
         write_mvars(p);
@@ -1468,17 +1736,26 @@ plc_t plc_func(plc_t p) {
         change_mask |= CHANGED_T * t_changed;
         change_mask |= CHANGED_S * s_changed;
         p = save_state(change_mask, p);
+//a failed device halts the plc like a timeout does;
+//lesser errors, like a torn shared memory read, are retried next cycle
+        if(r == PLC_OK && io == ERR_HARDWARE){
+            plc_log("hardware failure, stopping");
+            r = ERR_HARDWARE;
+        }
 	}
-    else{
-        usleep(p->step * THOUSAND);
-        timeout = 0;
-    }
     if(r < PLC_OK){
         p->status = r;
     }
     return p;
 }
 
+BYTE plc_free_run(const plc_t p) {
+    
+    return p != NULL 
+        && p->status == ST_RUNNING
+        && (is_virtual_clock() || (p->hw && p->hw->sync));
+}
+
 static plc_t allocate(plc_t plc) {
 /*******************initialize***************/    
 
@@ -1685,9 +1962,7 @@ plc_t declare_variable(const plc_t p,
         
         r->status = ERR_BADINDEX;
     } else {        
-        //*nick = strdup_r(*nick, val);
-        *nick = strdup(val);
-        //snprintf(nick, NICKLEN, "%s", val);
+        *nick = (char *)intern_str(val);
     }
     return r;
 }
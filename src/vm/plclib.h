@@ -14,6 +14,8 @@
 #define THOUSAND 1000
 
 #define MAXRUNG 256 
+#define PROGRAM_IMAGE ".img" //suffix of the compiled image of a program file
+#define MAXCOMPILERS 16 //threads that compile programs, besides the caller
 
 #define FLOAT_PRECISION 0.000001
 
@@ -236,35 +238,72 @@ plc_t plc_start(plc_t p);
  */
 plc_t plc_stop(plc_t p);
 
+/**
+ * @brief a line of program source, read where it is and not terminated
+ */
+typedef struct line_view {
+    const char * at;
+    unsigned int len; ///without the newline
+} * line_view_t;
+
+/**
+  * @brief split a program source into lines, in place
+  * @param the source
+  * @param its size
+  * @param where to store the newly allocated lines
+  * @return the number of lines
+  */
+unsigned int split_lines(const char * src, size_t size, line_view_t * lines);
+
 /**
   * @brief parse IL program
   * @param a unique program identifier
-  * @param the program as an allocated buffer of allocated strings
+  * @param the program lines
+  * @param the number of lines
   * @param the plc to store the generated microcode to
   * @return plc with updated status  
   */
 plc_t parse_il_program(const char* name, 
-                       const char lines[][MAXSTR], 
+                       const struct line_view lines[], 
+                       unsigned int n,
                        plc_t p);
                        
 /**
   * @brief parse LD program
-  * @param the program as an allocated buffer of allocated strings
+  * @param a unique program identifier
+  * @param the program lines
+  * @param the number of lines
   * @param the plc to store the generated microcode to
   * @return plc with updated status
   */
 plc_t parse_ld_program(const char * name, 
-                       const char lines[][MAXSTR], 
+                       const struct line_view lines[], 
+                       unsigned int n,
                        plc_t p);                       
 
 /**
- * @brief load a PLC program
+ * @brief load a PLC program. 
+ * Its compiled image is saved next to it, and loaded instead 
+ * of parsing it again as long as the program does not change
  * @param the local filename (path relative to config file) 
  * @param the plc
  * @return plc with updated status
  */
 plc_t plc_load_program_file(const char * path, plc_t plc);
 
+/**
+ * @brief load PLC programs, compiled in parallel, one per core.
+ * Their rungs are appended in the order of the files
+ * @param the local filenames
+ * @param how many
+ * @param the plc
+ * @return plc with the status of the last program, as if they were
+ * loaded one by one
+ */
+plc_t plc_load_program_files(const char * paths[], 
+                             unsigned int n, 
+                             plc_t plc);
+
 /**
  * @brief execute JMP instruction
  * @param the rung
@@ -538,20 +577,27 @@ int plc_task( plc_t p);
 int open_pipe(const char * pipe, plc_t p);
 
 /**
- * @brief PLC realtime loop
+ * @brief one PLC realtime cycle, it never waits: 
+ * the caller's event loop runs it once per timer period
  * Anything in this function normally (ie. when not in error)
  * satisfies the realtime @conditions:
  * 1. No disk I/O
  * 2. No mallocs
  * This way the time it takes to execute is predictable
  * Heavy parts can timeout
- * The timing is based on poll.h
- * which is also realtime when using a preempt scheduler
  * @param the PLC
  * @return PLC with updated state
  */
 plc_t plc_func( plc_t p);
 
+/**
+ * @brief whether cycles run back to back instead of on the timer:
+ * in virtual time, or when lock-step hardware hands them over
+ * @param the PLC
+ * @return TRUE if the scan loop must not wait between cycles
+ */
+BYTE plc_free_run(const plc_t p);
+
 /**
  * @brief force operand with value
  * @param the plc
@@ -560,7 +606,17 @@ plc_t plc_func( plc_t p);
  * @param the value
  * @return new plc state, or NULL in error
  */
-plc_t force(plc_t p, int op, BYTE i, char * val);
+plc_t force(plc_t p, int op, unsigned int i, char * val);
+
+/**
+ * @brief force operand with a numeric value
+ * @param the plc
+ * @param the operand type
+ * @param the operand index
+ * @param the value, digital operands are forced to 1 unless it is 0
+ * @return new plc state, or NULL in error
+ */
+plc_t force_value(plc_t p, int op, unsigned int i, double val);
 
 /**
  * @brief unforce operand
@@ -569,7 +625,7 @@ plc_t force(plc_t p, int op, BYTE i, char * val);
  * @param the operand index
  * @param new plc state, or null in error
  */
-plc_t unforce(plc_t p, int op, BYTE i);
+plc_t unforce(plc_t p, int op, unsigned int i);
 
 /**
  * @brief is an operand forced
@@ -578,7 +634,7 @@ plc_t unforce(plc_t p, int op, BYTE i);
  * @param input index
  * @return true if forced, false if not, error if out of bounds
  */
-int is_forced(plc_t p, int op, BYTE i);
+int is_forced(const plc_t p, int op, unsigned int i);
 
 /**
  * @brief decode inputs
@@ -170,7 +170,7 @@ void dump_rung(rung_t r, char * dump) {
         return;
     instruction_t ins;
     unsigned int pc = 0;
-    char buf[4] = "";
+    char buf[8] = "";
     for(;pc<r->insno;pc++){
         if(get(r, pc, &ins) < PLC_OK)
             return;
@@ -181,3 +181,128 @@ void dump_rung(rung_t r, char * dump) {
     //printf("%s", dump);
 }
 
+/*****************************rung image*****************************/
+
+static unsigned int pack(char * buf, 
+                         unsigned int at, 
+                         const void * data, 
+                         unsigned int len) {
+    if(buf != NULL)
+        memcpy(buf + at, data, len);
+    return at + len;
+}
+
+static unsigned int pack_str(char * buf, unsigned int at, const char * str) {
+//the terminator is kept
+    unsigned int len = strlen(str) + 1;
+    at = pack(buf, at, &len, sizeof(len));
+    return pack(buf, at, str, len);
+}
+
+static const char * unpack_str(const char * buf, 
+                               unsigned int len, 
+                               unsigned int * at,
+                               unsigned int max) {
+    unsigned int n = 0;
+    const char * r = NULL;
+    if(len - *at < sizeof(n))
+        return NULL;
+    memcpy(&n, buf + *at, sizeof(n));
+    *at += sizeof(n);
+    if(n == 0 
+    || n > max
+    || n > len - *at
+    || buf[*at + n - 1] != 0)
+        return NULL;
+    r = buf + *at;
+    *at += n;
+    return r;
+}
+
+unsigned int pack_rung(const rung_t r, char * buf) {
+    unsigned int at = 0;
+    unsigned int n = 0;
+    unsigned int i = 0;
+    codeline_t l = r->code;
+    for(; l != NULL; l = l->next, n++);
+    at = pack(buf, at, &n, sizeof(n));
+    for(l = r->code; l != NULL; l = l->next)
+        at = pack_str(buf, at, l->line);
+    at = pack(buf, at, &(r->insno), sizeof(r->insno));
+    for(; i < r->insno; i++){
+        instruction_t ins = r->instructions[i];
+        at = pack(buf, at, &(ins->operation), 1);
+        at = pack(buf, at, &(ins->operand), 1);
+        at = pack(buf, at, &(ins->modifier), 1);
+        at = pack(buf, at, &(ins->byte), 1);
+        at = pack(buf, at, &(ins->bit), 1);
+        at = pack_str(buf, at, ins->label);
+        at = pack_str(buf, at, ins->lookup);
+    }
+    return at;
+}
+
+int unpack_rung(const char * buf, unsigned int len, rung_t r) {
+    int rv = PLC_OK;
+    unsigned int at = 0;
+    unsigned int n = 0;
+    unsigned int i = 0;
+    const char * label = NULL;
+    const char * lookup = NULL;
+    struct instruction ins;
+    if(r == NULL 
+    || len < sizeof(n))
+        return PLC_ERR;
+    memcpy(&n, buf, sizeof(n));
+    at += sizeof(n);
+    for(; i < n && rv == PLC_OK; i++){
+        const char * line = unpack_str(buf, len, &at, len);//lines are as wide as in the source
+        if(line == NULL)
+            rv = PLC_ERR;
+        else
+            r->code = append_line(line, r->code);
+    }
+    if(rv == PLC_OK
+    && len - at >= sizeof(n)){
+        memcpy(&n, buf + at, sizeof(n));
+        at += sizeof(n);
+    } else 
+        rv = PLC_ERR;
+    for(i = 0; i < n && rv == PLC_OK; i++){
+        memset(&ins, 0, sizeof(struct instruction));
+        if(len - at < 5){
+            rv = PLC_ERR;
+            break;
+        }
+        ins.operation = buf[at++];
+        ins.operand = buf[at++];
+        ins.modifier = buf[at++];
+        ins.byte = buf[at++];
+        ins.bit = buf[at++];
+        label = unpack_str(buf, len, &at, MAX_LABEL);
+        lookup = label ? unpack_str(buf, len, &at, MAX_LABEL) : NULL;
+        if(lookup == NULL){
+            rv = PLC_ERR;
+            break;
+        }
+        strcpy(ins.label, label);
+        strcpy(ins.lookup, lookup);
+        //the same checks as when it was first built
+        rv = append(&ins, r);
+    }
+    if(rv == PLC_OK
+    && (at != len || intern(r) < PLC_OK))
+        rv = PLC_ERR;
+    if(rv < PLC_OK){
+        codeline_t l = r->code;
+        while(l != NULL){
+            codeline_t next = l->next;
+            free(l->line);
+            free(l);
+            l = next;
+        }
+        r->code = NULL;
+        clear_rung(r);
+    }
+    return rv;
+}
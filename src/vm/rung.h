@@ -2,6 +2,7 @@
 #define _RUNG_H_
 
 #define MAXSTACK 256
+#define DUMPLEN 32 //longest dump of an instruction and its number, without its label
 #define PLC_OK 0
 #define PLC_ERR -1
 
@@ -123,6 +124,30 @@ int lookup( const char * label, rung_t r);
  */
 int intern( rung_t r);
 
+/**
+ * @brief dump the instructions of a rung as text
+ * @param r a rung AKA instructions list
+ * @param where to append the dump, with room for DUMPLEN 
+ * and the label of each instruction
+ */
 void dump_rung( rung_t ins, char * dump);
 
+/**
+ * @brief serialize the code and the instructions of a rung
+ * @param r a rung AKA instructions list
+ * @param the buffer to write to, or NULL to only get the size
+ * @return the size of the serialized rung
+ */
+unsigned int pack_rung( const rung_t r, char * buf);
+
+/**
+ * @brief deserialize a rung, checking it as it is appended
+ * @param the buffer, as written by pack_rung
+ * @param its size
+ * @param r an empty rung
+ * @return OK, or error if the buffer does not hold a valid rung,
+ * which is then left empty
+ */
+int unpack_rung( const char * buf, unsigned int len, rung_t r);
+
 #endif //_RUNG_H_
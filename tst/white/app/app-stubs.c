@@ -30,6 +30,8 @@ void ui_display_message(char *msgstr){
     printf("%s\n", msgstr);
 }
 
+void set_virtual_clock(unsigned char enable){}
+
 plc_t declare_variable(const plc_t p, 
                         int var,
                         BYTE idx,                          
@@ -99,14 +101,21 @@ plc_t plc_stop(plc_t p){
     return p;
 }
 
-plc_t force(plc_t p, int op, BYTE i, char * val){
+plc_t force(plc_t p, int op, unsigned int i, char * val){
     Mock_val = val;
     Mock_op = op;
     Mock_idx = i;
     return p;
 }
 
-plc_t unforce(plc_t p, int op, BYTE i){
+plc_t force_value(plc_t p, int op, unsigned int i, double val){
+    Mock_val = val ? "1" : "0";
+    Mock_op = op;
+    Mock_idx = i;
+    return p;
+}
+
+plc_t unforce(plc_t p, int op, unsigned int i){
     Mock_val = NULL;
     if(Mock_op == op){
         Mock_op = 0xff;
@@ -207,6 +216,10 @@ hardware_t get_hardware( int type){
     return &Hw_stub;    
 }                        
 
+int get_hardware_type(const char * name){
+    return HW_SIM;
+}
+
 
 /**
  * @brief entry point: load text file into configuration
@@ -4,9 +4,11 @@ UTEST = ut-app
 SRCS = app-stubs.c \
 ut-app.c \
 config.c \
+config-bin.c \
 schema.c \
 app.c \
-cli.c
+cli.c \
+wire.c
 
 IFLAGS+=-I. -I.. -Imock/ -I../../../src/  -I../../../src/vm -I../../../src/ui -I../../../src/hw   -I../../../src/cfg 
 
@@ -15,12 +15,15 @@
 #include "instruction.h"
 #include "rung.h"
 #include "plclib.h"
+#include "snapshot.h"
+#include "wire.h"
 #include "ui.h"
 #include "app.h"
 
 #include "ut-conf.h"
 #include "ut-cli.h"
 #include "ut-app.h"
+#include "ut-wire.h"
 
 #define TRUE 1
 #define FALSE 0
@@ -87,6 +90,11 @@ int main ()
   || ADD_TEST(suite_conf, ut_get)
   || ADD_TEST(suite_conf, ut_set)
   || ADD_TEST(suite_conf, ut_copy)
+  || ADD_TEST(suite_conf, ut_index)
+  || ADD_TEST(suite_conf, ut_intern)
+  || ADD_TEST(suite_conf, ut_share)
+  || ADD_TEST(suite_conf, ut_grow)
+  || ADD_TEST(suite_conf, ut_image)
   ){
 	CU_cleanup_registry ();
         return CU_get_error ();
@@ -94,6 +102,9 @@ int main ()
 
   //cli
   if(ADD_TEST(suite_cli, ut_cli)
+  || ADD_TEST(suite_cli, ut_wire)
+  || ADD_TEST(suite_cli, ut_wire_watch)
+  || ADD_TEST(suite_cli, ut_wire_batch)
   ){
 	CU_cleanup_registry ();
         return CU_get_error ();
@@ -101,6 +112,8 @@ int main ()
   
   //app
   if(ADD_TEST(suite_app, ut_apply_command)
+  || ADD_TEST(suite_app, ut_apply_batch)
+  || ADD_TEST(suite_app, ut_get_state)
   ){
 	CU_cleanup_registry ();
         return CU_get_error ();
@@ -72,7 +72,143 @@ void ut_apply_command()
     CU_ASSERT_STRING_EQUAL(Mock_val, "X");
     CU_ASSERT(Mock_op == OP_INPUT);
     CU_ASSERT(Mock_idx == 1);
+//what did not change is not configured again
+    Mock_val = NULL;
+    r = apply_command(com, a);
+    CU_ASSERT_PTR_NULL(Mock_val);
+//edits that carry only what changed apply in place
+    com = store_value(CLI_EDIT, "DI 0 ID Y AQ 1 MAX 10", com);
+    r = apply_command(com, a);
+    CU_ASSERT_STRING_EQUAL(Mock_val, "Y");
+    CU_ASSERT(Mock_op == OP_INPUT);
+    CU_ASSERT(Mock_idx == 0);
+    sequence_t s = get_sequence_entry(CONFIG_DI, r->conf);
+    CU_ASSERT_STRING_EQUAL(s->vars[0].name, "Y");
+    s = get_sequence_entry(CONFIG_AQ, r->conf);
+    CU_ASSERT_STRING_EQUAL(get_param_val("MAX", s->vars[1].params), "10");
+    
+    com = store_value(CLI_EDIT, "DI 2 ID Z", com);
+    r = apply_command(com, a);
+    CU_ASSERT_STRING_EQUAL(MsgStr, "Invalid edit command\n");
+    com = store_value(CLI_EDIT, "DI 3 ID", com);
+    r = apply_command(com, a);
+    CU_ASSERT_STRING_EQUAL(MsgStr, "Invalid edit command\n");
+//all edits or none
+    MsgStr[0] = 0;
+    com = store_value(CLI_EDIT, "DI 0 ID A DI 9 ID B", com);
+    r = apply_command(com, a);
+    CU_ASSERT_STRING_EQUAL(MsgStr, "Invalid edit command\n");
+    s = get_sequence_entry(CONFIG_DI, r->conf);
+    CU_ASSERT_STRING_EQUAL(s->vars[0].name, "Y");
+//programs are loaded, not edited
+    MsgStr[0] = 0;
+    com = store_value(CLI_EDIT, "PROGRAM 0 ID x.il", com);
+    r = apply_command(com, a);
+    CU_ASSERT_STRING_EQUAL(MsgStr, "Invalid edit command\n");
+    s = get_sequence_entry(CONFIG_PROGRAM, r->conf);
+    CU_ASSERT(s->size == 0 || s->vars[0].name == NULL
+           || strcmp(s->vars[0].name, "x.il"));
+}
+void ut_apply_batch()
+{
+    extern char MsgStr[];
+    extern char * Mock_val;
+    extern unsigned char Mock_op;
+    extern int Mock_idx;
+    struct PLC_regs plc;
+    struct mvar m[2];
+    struct app a;
+    struct wire_batch b;
+    memset(&plc, 0, sizeof(plc));
+    memset(m, 0, sizeof(m));
+    plc.ni = 1;
+    plc.nm = 2;
+    plc.m = m;
+    m[1].RO = TRUE;
+    a.plc = &plc;
+    a.conf = NULL;
+//degenerates
+    CU_ASSERT_PTR_NULL(apply_batch(NULL, NULL));
+    CU_ASSERT(apply_batch(NULL, &a) == &a);
+//forces go through the library
+    CU_ASSERT(wire_batch("FORCE DI 7 1", &b) == PLC_OK);
+    CU_ASSERT(apply_batch(&b, &a) == &a);
+    CU_ASSERT_STRING_EQUAL(Mock_val, "1");
+    CU_ASSERT(Mock_op == OP_INPUT);
+    CU_ASSERT(Mock_idx == 7);
+//out of range
+    Mock_val = NULL;
+    CU_ASSERT(wire_batch("FORCE DI 8 1", &b) == PLC_OK);
+    apply_batch(&b, &a);
+    CU_ASSERT_STRING_EQUAL(MsgStr, "Invalid batch command, record 0\n");
+    CU_ASSERT_PTR_NULL(Mock_val);
+//all or nothing
+    CU_ASSERT(wire_batch("WRITE MREG 0 7 MREG 1 9", &b) == PLC_OK);
+    apply_batch(&b, &a);
+    CU_ASSERT_STRING_EQUAL(MsgStr, "Invalid batch command, record 1\n");
+    CU_ASSERT(m[0].V == 0);
+    CU_ASSERT(m[1].V == 0);
+    
+    CU_ASSERT(wire_batch("WRITE MREG 0 7", &b) == PLC_OK);
+    apply_batch(&b, &a);
+    CU_ASSERT(m[0].V == 7);
+    CU_ASSERT(plc.update & CHANGED_M);
+//forces are not writes
+    CU_ASSERT(wire_batch("FORCE MREG 0 1", &b) == PLC_OK);
+    apply_batch(&b, &a);
+    CU_ASSERT_STRING_EQUAL(MsgStr, "Invalid batch command, record 0\n");
+}
+
+void ut_get_state()
+{
+    config_t conf = init_config(ConfigSchema, N_CONFIG_VARIABLES);
+    BYTE inputs[1] = {0x02};
+    BYTE outputs[1] = {0x01};
+    uint64_t m[2] = {42, 0};
+    double mr[2] = {0.5, 0};
+    double ai[2] = {0, 1.5};
+    double aq[2] = {0, 0};
+    long t[2] = {7, 0};
+    BYTE t_out[2] = {1, 0};
+    BYTE s_out[2] = {0, 1};
+    struct snapshot snap;
+    memset(&snap, 0, sizeof(struct snapshot));
+//degenerates
+    CU_ASSERT_PTR_EQUAL(get_state(NULL, conf), conf);
+
+    snap.status = ST_RUNNING;
+    snap.ni = snap.nq = 1;
+    snap.nai = snap.naq = snap.nm = snap.nmr = snap.nt = snap.ns = 2;
+    snap.inputs = inputs;
+    snap.outputs = outputs;
+    snap.m = m;
+    snap.mr = mr;
+    snap.ai = ai;
+    snap.aq = aq;
+    snap.t = t;
+    snap.t_out = t_out;
+    snap.s_out = s_out;
+    config_t r = get_state(&snap, conf);
+    CU_ASSERT_PTR_EQUAL(r, conf);
+    CU_ASSERT(get_numeric_entry(0, r) == ST_RUNNING);
 
+    sequence_t seq = get_sequence_entry(CONFIG_DI, r);
+    CU_ASSERT_STRING_EQUAL(get_param_val("STATE", seq->vars[0].params), "FALSE");
+    CU_ASSERT_STRING_EQUAL(get_param_val("STATE", seq->vars[1].params), "TRUE");
+    seq = get_sequence_entry(CONFIG_DQ, r);
+    CU_ASSERT_STRING_EQUAL(get_param_val("STATE", seq->vars[0].params), "TRUE");
+    seq = get_sequence_entry(CONFIG_AI, r);
+    CU_ASSERT_STRING_EQUAL(get_param_val("VALUE", seq->vars[1].params), "1.500000");
+    seq = get_sequence_entry(CONFIG_MREG, r);
+    CU_ASSERT_STRING_EQUAL(get_param_val("VALUE", seq->vars[0].params), "42");
+    seq = get_sequence_entry(CONFIG_MVAR, r);
+    CU_ASSERT_STRING_EQUAL(get_param_val("VALUE", seq->vars[0].params), "0.500000");
+    seq = get_sequence_entry(CONFIG_TIMER, r);
+    CU_ASSERT_STRING_EQUAL(get_param_val("VALUE", seq->vars[0].params), "7");
+    CU_ASSERT_STRING_EQUAL(get_param_val("OUT", seq->vars[0].params), "TRUE");
+    seq = get_sequence_entry(CONFIG_PULSE, r);
+    CU_ASSERT_STRING_EQUAL(get_param_val("OUT", seq->vars[0].params), "FALSE");
+    CU_ASSERT_STRING_EQUAL(get_param_val("OUT", seq->vars[1].params), "TRUE");
 }
     
 #endif//_UT_APP_H_
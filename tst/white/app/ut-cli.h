@@ -135,7 +135,27 @@ void ut_cli()
     k = get_key("AQ", arg);
     s = get_sequence_entry(k, arg);
     CU_ASSERT_STRING_EQUAL(get_param_val("NAME", s->vars[1].params), "LOL");
+    CU_ASSERT_STRING_EQUAL(get_string_entry(CLI_EDIT, result), 
+                           "AQ 1 NAME LOL");
     CU_ASSERT(c==COM_EDIT);  
+    //WATCH
+    sprintf(input, "%s\n", "WATCH");
+    result = cli_parse(input, command);
+    c = get_numeric_entry(CLI_COM, result);
+    CU_ASSERT(c==COM_NONE);
+
+    sprintf(input, "%s\n", "WATCH hmi 0 DI 3 MREG 1");
+    result = cli_parse(input, command);
+    c = get_numeric_entry(CLI_COM, result);
+    CU_ASSERT(c==COM_WATCH);
+    CU_ASSERT_STRING_EQUAL(get_string_entry(CLI_WATCH, result), 
+                           "hmi 0 DI 3 MREG 1");
+
+    sprintf(input, "%s\n", "UNWATCH hmi");
+    result = cli_parse(input, command);
+    c = get_numeric_entry(CLI_COM, result);
+    CU_ASSERT(c==COM_UNWATCH);
+    CU_ASSERT_STRING_EQUAL(get_string_entry(CLI_WATCH, result), "hmi");
 }
     
 #endif//_UT_CLI_H_
@@ -32,6 +32,36 @@ void ut_conf()
     
     got_key = get_key("HW", conf);
     CU_ASSERT(got_key == CONFIG_HW);
+    
+    //nested hardware interfaces
+    config_t ifc = get_recursive_entry(HW_IFACE, 
+                        get_recursive_entry(CONFIG_HW, conf));
+    CU_ASSERT_PTR_NOT_NULL(ifc);
+    config_t shm = get_recursive_entry(IFACE_SHM, ifc);
+    CU_ASSERT_STRING_EQUAL(get_string_entry(SHM_NAME, shm), "/plcemu");
+    config_t sim = get_recursive_entry(IFACE_SIM, ifc);
+    CU_ASSERT_STRING_EQUAL(get_string_entry(SIM_INPUT, sim), "");
+    config_t dry = get_recursive_entry(IFACE_DRY, ifc);
+    CU_ASSERT_STRING_EQUAL(get_string_entry(DRY_PATTERN, dry), "CONSTANT");
+    config_t mbc = get_recursive_entry(IFACE_MODBUS, ifc);
+    CU_ASSERT(get_numeric_entry(MBC_TIMEOUT, mbc) == 50);
+    CU_ASSERT(get_sequence_entry(MBC_DEVICES, mbc)->size == 1);
+    config_t can = get_recursive_entry(IFACE_CAN, ifc);
+    CU_ASSERT_STRING_EQUAL(get_string_entry(CAN_BUS, can), "can0");
+    CU_ASSERT(get_numeric_entry(CAN_TIMEOUT, can) == 100);
+    CU_ASSERT(get_sequence_entry(CAN_FRAMES, can)->size == 1);
+    CU_ASSERT_STRING_EQUAL(
+        get_string_entry(HW_TYPE, get_recursive_entry(CONFIG_HW, conf)), "");
+    //modbus server is off unless a port is given
+    config_t mb = get_recursive_entry(CONFIG_MODBUS, conf);
+    CU_ASSERT(get_numeric_entry(MODBUS_PORT, mb) == 0);
+    CU_ASSERT(get_numeric_entry(MODBUS_UNIT, mb) == 255);
+    //so is peer exchange
+    config_t peer = get_recursive_entry(CONFIG_PEER, conf);
+    CU_ASSERT(get_numeric_entry(PEER_PORT, peer) == 0);
+    CU_ASSERT(get_numeric_entry(PEER_RATE, peer) == 100);
+    CU_ASSERT_STRING_EQUAL(get_string_entry(PEER_PUBLISH, peer), "");
+    CU_ASSERT(get_sequence_entry(PEER_SUBSCRIBE, peer)->size == 1);
     clear_config(conf);
 }
 
@@ -304,5 +334,251 @@ void ut_copy(){
     clear_config(conf);    
 }
 
+void ut_index(){
+
+    char key[CONF_NUM] = "";
+    char val[CONF_NUM] = "";
+    param_t params = NULL;
+    int i = 0;
+    for(; i < 100; i++){
+        sprintf(key, "LINE %d", i);
+        sprintf(val, "%d", i);
+        params = append_param(params, key, val);
+    }
+    params = append_param(params, "LINE 5", "again");
+    CU_ASSERT_PTR_NOT_NULL(params->table);
+    CU_ASSERT_STRING_EQUAL(get_param_val("LINE 5", params), "5");
+    CU_ASSERT_STRING_EQUAL(get_param_val("LINE 99", params), "99");
+    CU_ASSERT_PTR_NULL(get_param_val("LINE 100", params));
+    
+    params = update_param(params, "LINE 100", "100");
+    params = update_param(params, "LINE 0", "zero");
+    CU_ASSERT_STRING_EQUAL(get_param_val("LINE 100", params), "100");
+    CU_ASSERT_STRING_EQUAL(get_param_val("LINE 0", params), "zero");
+    
+    param_t copy = copy_params(params);
+    CU_ASSERT_STRING_EQUAL(get_param_val("LINE 50", copy), "50");
+    CU_ASSERT_STRING_EQUAL(get_param_val("LINE 5", copy), "5");
+    for(i = 0; copy; copy = copy->next, i++);
+    CU_ASSERT(i == 102);
+    
+    config_t conf = init_config(ConfigSchema, N_CONFIG_VARIABLES);
+    conf = resize_sequence(conf, CONFIG_MVAR, 32);
+    sequence_t seq = get_sequence_entry(CONFIG_MVAR, conf);
+    for(i = 0; i < 32; i++){
+        sprintf(val, "var%d", i);
+        conf = store_seq_value(seq, i, "ID", val, conf);
+    }
+    CU_ASSERT(get_variable("var17", seq) == &(seq->vars[17]));
+    CU_ASSERT_PTR_NOT_NULL(seq->table);
+    
+    conf = store_seq_value(seq, 17, "ID", "renamed", conf);
+    CU_ASSERT_PTR_NULL(get_variable("var17", seq));
+    CU_ASSERT(get_variable("renamed", seq) == &(seq->vars[17]));
+    CU_ASSERT_PTR_NULL(get_variable("var32", seq));
+    
+    CU_ASSERT(get_key("MVAR", conf) == CONFIG_MVAR);
+    CU_ASSERT(get_key("STEP", conf) == CONFIG_STEP);
+    CU_ASSERT(get_key("LOL", conf) == CONF_ERR);
+    clear_config(conf);
+}
+void ut_intern(){
+
+    char buf[CONF_NUM] = "interned";
+    const char * a = intern_str(buf);
+    buf[0] = 'I';
+    CU_ASSERT_STRING_EQUAL(a, "interned");
+    CU_ASSERT(intern_str("interned") == a);
+    CU_ASSERT(intern_str(buf) != a);
+    CU_ASSERT_PTR_NULL(intern_str(NULL));
+    
+    config_t conf = init_config(ConfigSchema, N_CONFIG_VARIABLES);
+    sequence_t seq = get_sequence_entry(CONFIG_AI, conf);
+    conf = store_seq_value(seq, 0, "ID", "var0", conf);
+    conf = store_seq_value(seq, 0, "MAX", "1.0", conf);
+    config_t hw = store_value(HW_LABEL, "SIM", 
+                              get_recursive_entry(CONFIG_HW, conf));
+    
+    config_t copy = copy_config(conf);
+    config_t other_hw = get_recursive_entry(CONFIG_HW, copy);
+    sequence_t other = get_sequence_entry(CONFIG_AI, copy);
+    CU_ASSERT(other->vars[0].name == seq->vars[0].name);
+    CU_ASSERT_STRING_EQUAL(get_param_val("MAX", other->vars[0].params), 
+                           "1.0");
+    CU_ASSERT_STRING_EQUAL(get_string_entry(HW_LABEL, other_hw), "SIM");
+    
+    //a store replaces the string of the copy, not the shared one
+    other = edit_sequence_entry(CONFIG_AI, copy);
+    copy = store_seq_value(other, 0, "MAX", "2.0", copy);
+    other_hw = store_value(HW_LABEL, "DRY", 
+                           edit_recursive_entry(CONFIG_HW, copy));
+    CU_ASSERT_STRING_EQUAL(get_param_val("MAX", seq->vars[0].params), "1.0");
+    CU_ASSERT_STRING_EQUAL(get_string_entry(HW_LABEL, hw), "SIM");
+    CU_ASSERT_STRING_EQUAL(get_string_entry(HW_LABEL, other_hw), "DRY");
+    //values are not pooled, they change at runtime
+    CU_ASSERT(get_param_val("MAX", other->vars[0].params)
+           != intern_str("2.0"));
+    CU_ASSERT(get_string_entry(HW_LABEL, other_hw) != intern_str("DRY"));
+    clear_config(copy);
+    clear_config(conf);
+}
+void ut_share(){
+
+    config_t conf = init_config(ConfigSchema, N_CONFIG_VARIABLES);
+    sequence_t seq = edit_sequence_entry(CONFIG_AI, conf);
+    conf = store_seq_value(seq, 0, "MAX", "1.0", conf);
+    config_t hw = get_recursive_entry(CONFIG_HW, conf);
+    
+    config_t copy = copy_config(conf);
+    CU_ASSERT(copy != conf);
+    CU_ASSERT(get_sequence_entry(CONFIG_AI, copy) == seq);
+    CU_ASSERT(get_recursive_entry(CONFIG_HW, copy) == hw);
+    CU_ASSERT(seq->refs == 1);
+    
+    //writes copy what is shared, once
+    sequence_t other = edit_sequence_entry(CONFIG_AI, copy);
+    CU_ASSERT(other != seq);
+    CU_ASSERT(edit_sequence_entry(CONFIG_AI, copy) == other);
+    CU_ASSERT(seq->refs == 0);
+    copy = store_seq_value(other, 0, "MAX", "2.0", copy);
+    CU_ASSERT_STRING_EQUAL(get_param_val("MAX", seq->vars[0].params), "1.0");
+    CU_ASSERT_STRING_EQUAL(get_param_val("MAX", other->vars[0].params), "2.0");
+    
+    config_t other_hw = edit_recursive_entry(CONFIG_HW, copy);
+    CU_ASSERT(other_hw != hw);
+    other_hw = store_value(HW_LABEL, "SIM", other_hw);
+    CU_ASSERT_STRING_EQUAL(get_string_entry(HW_LABEL, hw), "DRY");
+    CU_ASSERT_STRING_EQUAL(get_string_entry(HW_LABEL, other_hw), "SIM");
+    
+    //not shared any more, written in place
+    CU_ASSERT(edit_sequence_entry(CONFIG_AI, conf) == seq);
+    CU_ASSERT(edit_recursive_entry(CONFIG_HW, conf) == hw);
+    
+    //the last owner frees
+    config_t third = copy_config(copy);
+    clear_config(copy);
+    CU_ASSERT(get_sequence_entry(CONFIG_AI, third) == other);
+    CU_ASSERT(other->refs == 0);
+    CU_ASSERT_STRING_EQUAL(get_param_val("MAX", other->vars[0].params), "2.0");
+    clear_config(third);
+    clear_config(conf);
+}
+void ut_grow(){
+
+    char name[CONF_NUM] = "";
+    int n = 20000;
+    int i = 0;
+    config_t conf = init_config(ConfigSchema, N_CONFIG_VARIABLES);
+    sequence_t seq = get_sequence_entry(CONFIG_MVAR, conf);
+    conf = store_seq_value(seq, 1, "ID", "first", conf);
+    //grown one by one like the loader does, past what a byte indexes
+    for(; i < n; i++){
+        conf = grow_sequence(conf, CONFIG_MVAR, i + 1);
+        seq = edit_sequence_entry(CONFIG_MVAR, conf);
+        if(i > 1){
+            sprintf(name, "var%d", i);
+            conf = store_seq_value(seq, i, "ID", name, conf);
+        }
+    }
+    CU_ASSERT(conf->err == CONF_OK);
+    CU_ASSERT(seq->size == n);
+    CU_ASSERT(seq->cap >= n);
+    CU_ASSERT_STRING_EQUAL(seq->vars[1].name, "first");
+    CU_ASSERT(seq->vars[n - 1].index == n - 1);
+    CU_ASSERT(get_variable("var12345", seq) == &(seq->vars[12345]));
+    CU_ASSERT_PTR_NULL(seq->vars[0].name);
+    
+    //never shrinks
+    conf = grow_sequence(conf, CONFIG_MVAR, 3);
+    CU_ASSERT(seq->size == n);
+    
+    //a shared sequence is copied before it grows
+    config_t copy = copy_config(conf);
+    copy = grow_sequence(copy, CONFIG_MVAR, n + 1);
+    CU_ASSERT(get_sequence_entry(CONFIG_MVAR, copy)->size == n + 1);
+    CU_ASSERT(seq->size == n);
+    CU_ASSERT_STRING_EQUAL(
+        get_sequence_entry(CONFIG_MVAR, copy)->vars[n - 1].name, "var19999");
+    
+    conf = resize_sequence(conf, CONFIG_MVAR, 1000);
+    CU_ASSERT(conf->err == CONF_OK);
+    CU_ASSERT(get_sequence_entry(CONFIG_MVAR, conf)->size == 1000);
+    
+    conf = grow_sequence(conf, N_CONFIG_VARIABLES, 1);
+    CU_ASSERT(conf->err == CONF_ERR);
+    
+    //sizes read from a file are bounded, and fail without harm
+    conf->err = CONF_OK;
+    conf = grow_sequence(conf, CONFIG_MVAR, CONF_SEQ_MAX + 1);
+    CU_ASSERT(conf->err == CONF_ERR);
+    CU_ASSERT(get_sequence_entry(CONFIG_MVAR, conf)->size == 1000);
+    conf->err = CONF_OK;
+    conf = grow_sequence(conf, CONFIG_MVAR, CONF_SEQ_MAX * 1024);
+    CU_ASSERT(conf->err == CONF_ERR);
+    conf->err = CONF_OK;
+    conf = resize_sequence(conf, CONFIG_MVAR, CONF_SEQ_MAX + 1);
+    CU_ASSERT(conf->err == CONF_ERR);
+    CU_ASSERT(get_sequence_entry(CONFIG_MVAR, conf)->size == 1000);
+    CU_ASSERT_PTR_NULL(new_sequence(CONF_SEQ_MAX + 1));
+    CU_ASSERT_PTR_NULL(new_sequence(-1));
+    clear_config(copy);
+    clear_config(conf);
+}
+void ut_image(){
+
+    const char * path = "ut-conf.img";
+    const char * text = "STEP: 50";
+    config_t base = init_config(ConfigSchema, N_CONFIG_VARIABLES);
+    uint64_t key = image_key(text, strlen(text), base);
+    //the key covers the defaults the text is loaded into
+    CU_ASSERT(image_key(text, strlen(text), base) == key);
+    CU_ASSERT(image_key("STEP: 51", strlen(text), base) != key);
+    config_t conf = set_numeric_entry(CONFIG_STEP, 50, copy_config(base));
+    CU_ASSERT(image_key(text, strlen(text), conf) != key);
+    
+    conf = resize_sequence(conf, CONFIG_MVAR, 300);
+    sequence_t seq = edit_sequence_entry(CONFIG_MVAR, conf);
+    conf = store_seq_value(seq, 299, "ID", "last", conf);
+    conf = store_seq_value(seq, 299, "MAX", "1.0", conf);
+    conf = store_seq_value(seq, 299, "FORMAT", "REAL", conf);
+    store_value(HW_LABEL, "SIM", edit_recursive_entry(CONFIG_HW, conf));
+    CU_ASSERT(save_config_image(path, key, conf) == CONF_OK);
+    
+    config_t loaded = init_config(ConfigSchema, N_CONFIG_VARIABLES);
+    CU_ASSERT(load_config_image(path, key, loaded) == CONF_OK);
+    CU_ASSERT(loaded->err == CONF_OK);
+    CU_ASSERT(get_numeric_entry(CONFIG_STEP, loaded) == 50);
+    CU_ASSERT_STRING_EQUAL(get_string_entry(HW_LABEL, 
+        get_recursive_entry(CONFIG_HW, loaded)), "SIM");
+    seq = get_sequence_entry(CONFIG_MVAR, loaded);
+    CU_ASSERT(seq->size == 300);
+    CU_ASSERT(seq->vars[299].index == 299);
+    CU_ASSERT(get_variable("last", seq) == &(seq->vars[299]));
+    CU_ASSERT_STRING_EQUAL(get_param_val("FORMAT", seq->vars[299].params), 
+                           "REAL");
+    CU_ASSERT_PTR_NULL(seq->vars[0].name);
+    //the defaults that were not loaded are kept
+    CU_ASSERT(get_sequence_entry(CONFIG_DI, loaded)->size 
+           == get_sequence_entry(CONFIG_DI, base)->size);
+    clear_config(loaded);
+    
+    //a stale key, a damaged or a missing image leave it as it was
+    loaded = init_config(ConfigSchema, N_CONFIG_VARIABLES);
+    CU_ASSERT(load_config_image(path, key + 1, loaded) == CONF_ERR);
+    FILE * f = fopen(path, "r+b");
+    fseek(f, -1, SEEK_END);
+    fputc('!', f);
+    fclose(f);
+    CU_ASSERT(load_config_image(path, key, loaded) == CONF_ERR);
+    remove(path);
+    CU_ASSERT(load_config_image(path, key, loaded) == CONF_ERR);
+    CU_ASSERT(get_numeric_entry(CONFIG_STEP, loaded) == 100);
+    CU_ASSERT(get_sequence_entry(CONFIG_MVAR, loaded)->size 
+           == get_sequence_entry(CONFIG_MVAR, base)->size);
+    CU_ASSERT(loaded->err == CONF_OK);
+    clear_config(loaded);
+    clear_config(conf);
+    clear_config(base);
+}
     
 #endif//_UT_CONF_H_
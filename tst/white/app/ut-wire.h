@@ -0,0 +1,193 @@
+#ifndef _UT_WIRE_H_ 
+#define _UT_WIRE_H_
+
+struct wire_capture{
+    unsigned int n;
+    BYTE block[16];
+    unsigned int index[16];
+    uint64_t value[16];
+};
+
+void capture_record(BYTE block, unsigned int index, uint64_t value, void * arg)
+{
+    struct wire_capture * c = (struct wire_capture *)arg;
+    if(c->n < 16){
+        c->block[c->n] = block;
+        c->index[c->n] = index;
+        c->value[c->n] = value;
+        c->n++;
+    }
+}
+
+void ut_wire()
+{
+    BYTE in[2][1] = {{0x05}, {0x05}};
+    BYTE out[2][1] = {{0}, {0}};
+    uint64_t m[2][1] = {{42}, {42}};
+    double mr[2][1] = {{0.5}, {0.5}};
+    long t[2][1] = {{3}, {3}};
+    BYTE t_out[2][1] = {{1}, {1}};
+    struct snapshot s[2];
+    struct wire_header h;
+    struct wire_capture c;
+    BYTE buf[256];
+    int i = 0;
+    for(; i < 2; i++){
+        memset(&s[i], 0, sizeof(struct snapshot));
+        s[i].ni = s[i].nq = s[i].nm = s[i].nmr = s[i].nt = 1;
+        s[i].inputs = in[i];
+        s[i].outputs = out[i];
+        s[i].m = m[i];
+        s[i].mr = mr[i];
+        s[i].t = t[i];
+        s[i].t_out = t_out[i];
+        s[i].status = ST_RUNNING;
+        s[i].cycle = 10;
+    }
+    CU_ASSERT(wire_max(&s[0]) <= sizeof(buf));
+//keyframe carries everything
+    unsigned int len = wire_encode(&s[0], NULL, 7, buf);
+    CU_ASSERT(len == WIRE_HEADER + WIRE_SIZES + 6 * WIRE_RECORD);
+    memset(&c, 0, sizeof(c));
+    CU_ASSERT(wire_decode(buf, len, &h, capture_record, &c) == PLC_OK);
+    CU_ASSERT(h.kind == WIRE_KEY);
+    CU_ASSERT(h.seq == 7);
+    CU_ASSERT(h.cycle == 10);
+    CU_ASSERT(h.status == ST_RUNNING);
+    CU_ASSERT(h.records == 6);
+    CU_ASSERT(h.sizes[0] == 1);
+    CU_ASSERT(c.n == 6);
+    CU_ASSERT(c.block[0] == WIRE_I && c.value[0] == 0x05);
+    CU_ASSERT(c.block[2] == WIRE_M && c.value[2] == 42);
+    CU_ASSERT(c.block[3] == WIRE_MR && wire_real(c.value[3]) == 0.5);
+    CU_ASSERT(c.block[4] == WIRE_T && c.value[4] == 3);
+    CU_ASSERT(c.block[5] == WIRE_TQ && c.value[5] == 1);
+//nothing changed, no delta
+    CU_ASSERT(wire_encode(&s[1], &s[0], 8, buf) == 0);
+//delta carries only changes
+    in[1][0] = 0x04;
+    mr[1][0] = -1.25;
+    len = wire_encode(&s[1], &s[0], 8, buf);
+    CU_ASSERT(len == WIRE_HEADER + 2 * WIRE_RECORD);
+    memset(&c, 0, sizeof(c));
+    CU_ASSERT(wire_decode(buf, len, &h, capture_record, &c) == PLC_OK);
+    CU_ASSERT(h.kind == WIRE_DELTA);
+    CU_ASSERT(h.seq == 8);
+    CU_ASSERT(c.n == 2);
+    CU_ASSERT(c.block[0] == WIRE_I && c.index[0] == 0 && c.value[0] == 0x04);
+    CU_ASSERT(c.block[1] == WIRE_MR && wire_real(c.value[1]) == -1.25);
+//malformed
+    CU_ASSERT(wire_decode(buf, len - 1, &h, NULL, NULL) == PLC_ERR);
+    CU_ASSERT(wire_decode(buf, WIRE_HEADER - 1, &h, NULL, NULL) == PLC_ERR);
+    buf[0] = '-';
+    CU_ASSERT(wire_decode(buf, len, &h, NULL, NULL) == PLC_ERR);
+}
+
+void ut_wire_watch()
+{
+    BYTE in[2] = {0x05, 0x80};
+    BYTE out[1] = {0};
+    uint64_t m[4] = {1, 2, 3, 4};
+    long t[1] = {9};
+    BYTE t_out[1] = {1};
+    struct snapshot s;
+    struct wire_watch w;
+    struct wire_header h;
+    struct wire_capture c;
+    BYTE buf[WIRE_WATCH_MAX];
+    memset(&s, 0, sizeof(struct snapshot));
+    s.ni = 2;
+    s.nq = 1;
+    s.nm = 4;
+    s.nt = 1;
+    s.inputs = in;
+    s.outputs = out;
+    s.m = m;
+    s.t = t;
+    s.t_out = t_out;
+//malformed
+    CU_ASSERT(wire_watch(NULL, &w) == PLC_ERR);
+    CU_ASSERT(wire_watch("hmi", &w) == PLC_ERR);
+    CU_ASSERT(wire_watch("hmi 100", &w) == PLC_ERR);
+    CU_ASSERT(wire_watch("hmi 100 DI", &w) == PLC_ERR);
+    CU_ASSERT(wire_watch("hmi 100 XX 1", &w) == PLC_ERR);
+    CU_ASSERT(wire_watch("a_name_too_long_for_a_topic 0 DI 1", &w) == PLC_ERR);
+    CU_ASSERT(wire_watch("hmi 100 MREG -1", &w) == PLC_ERR);
+    CU_ASSERT(wire_watch("hmi 100 MREG 65536", &w) == PLC_ERR);
+    CU_ASSERT(wire_watch("hmi 100 DI 524288", &w) == PLC_ERR);
+    CU_ASSERT(wire_watch("hmi 100 DI 524287 MREG 65535", &w) == PLC_OK);
+    CU_ASSERT(w.index[0] == 65535 && w.index[1] == 65535);
+//bits of the same byte are one record, timers come with their output
+    CU_ASSERT(wire_watch("hmi 100 DI 9 DI 10 MREG 2 TIMERS 0 MREG 7", &w)
+              == PLC_OK);
+    CU_ASSERT_STRING_EQUAL(w.topic, WIRE_WATCH "hmi");
+    CU_ASSERT(w.period == 100);
+    CU_ASSERT(w.n == 5);
+    CU_ASSERT(w.block[0] == WIRE_I && w.index[0] == 1);
+    CU_ASSERT(w.block[1] == WIRE_M && w.index[1] == 2);
+    CU_ASSERT(w.block[2] == WIRE_T && w.index[2] == 0);
+    CU_ASSERT(w.block[3] == WIRE_TQ && w.index[3] == 0);
+//keyframe carries what is watched and exists
+    unsigned int len = wire_encode_watch(&s, &w, TRUE, 1, buf);
+    CU_ASSERT(len == WIRE_HEADER + WIRE_SIZES + 4 * WIRE_RECORD);
+    memset(&c, 0, sizeof(c));
+    CU_ASSERT(wire_decode(buf, len, &h, capture_record, &c) == PLC_OK);
+    CU_ASSERT(h.kind == WIRE_KEY);
+    CU_ASSERT(c.n == 4);
+    CU_ASSERT(c.block[0] == WIRE_I && c.index[0] == 1 && c.value[0] == 0x80);
+    CU_ASSERT(c.block[1] == WIRE_M && c.index[1] == 2 && c.value[1] == 3);
+//deltas only what is watched and changed
+    CU_ASSERT(wire_encode_watch(&s, &w, FALSE, 2, buf) == 0);
+    in[0] = 0;
+    m[0] = 10;
+    CU_ASSERT(wire_encode_watch(&s, &w, FALSE, 2, buf) == 0);
+    m[2] = 30;
+    len = wire_encode_watch(&s, &w, FALSE, 2, buf);
+    CU_ASSERT(len == WIRE_HEADER + WIRE_RECORD);
+    memset(&c, 0, sizeof(c));
+    CU_ASSERT(wire_decode(buf, len, &h, capture_record, &c) == PLC_OK);
+    CU_ASSERT(h.kind == WIRE_DELTA && h.seq == 2);
+    CU_ASSERT(c.n == 1 && c.block[0] == WIRE_M && c.value[0] == 30);
+}
+
+void ut_wire_batch()
+{
+    struct wire_batch b;
+    struct wire_batch d;
+    BYTE buf[WIRE_BATCH_MAX];
+//malformed
+    CU_ASSERT(wire_batch(NULL, &b) == PLC_ERR);
+    CU_ASSERT(wire_batch("FORCE", &b) == PLC_ERR);
+    CU_ASSERT(wire_batch("PUSH DI 1 1", &b) == PLC_ERR);
+    CU_ASSERT(wire_batch("FORCE DI 1", &b) == PLC_ERR);
+    CU_ASSERT(wire_batch("FORCE TIMERS 1 1", &b) == PLC_ERR);
+    CU_ASSERT(wire_batch("FORCE DI -1 1", &b) == PLC_ERR);
+    CU_ASSERT(wire_batch("FORCE DI 1x 1", &b) == PLC_ERR);
+    CU_ASSERT(wire_batch("FORCE MREG 65536 1", &b) == PLC_ERR);
+    CU_ASSERT(wire_batch("FORCE MREG 4294967297 1", &b) == PLC_ERR);
+    CU_ASSERT(wire_batch("FORCE MREG 65535 1", &b) == PLC_OK);
+    CU_ASSERT(b.index[0] == 65535);
+//unforce takes no values
+    CU_ASSERT(wire_batch("UNFORCE DI 1 DQ 9", &b) == PLC_OK);
+    CU_ASSERT(b.op == WIRE_UNFORCE && b.n == 2);
+    CU_ASSERT(b.block[1] == WIRE_Q && b.index[1] == 9);
+    
+    CU_ASSERT(wire_batch("force di 300 1 AI 2 1.5 dq 0 0", &b) == PLC_OK);
+    CU_ASSERT(b.op == WIRE_FORCE && b.n == 3);
+    CU_ASSERT(b.block[0] == WIRE_I && b.index[0] == 300 && b.value[0] == 1);
+    CU_ASSERT(b.block[1] == WIRE_AI && wire_real(b.value[1]) == 1.5);
+//round trip
+    unsigned int len = wire_encode_batch(&b, buf);
+    CU_ASSERT(len == WIRE_BATCH_HEADER + 3 * WIRE_RECORD);
+    CU_ASSERT(wire_decode_batch(buf, len, &d) == PLC_OK);
+    CU_ASSERT(d.op == WIRE_FORCE && d.n == 3);
+    CU_ASSERT(d.index[0] == 300 && d.value[0] == 1);
+    CU_ASSERT(d.block[2] == WIRE_Q && d.value[2] == 0);
+    CU_ASSERT(wire_decode_batch(buf, len - 1, &d) == PLC_ERR);
+    buf[WIRE_BATCH_HEADER] = WIRE_T;
+    CU_ASSERT(wire_decode_batch(buf, len, &d) == PLC_ERR);
+    buf[3] = N_WIRE_OPS;
+    CU_ASSERT(wire_decode_batch(buf, len, &d) == PLC_ERR);
+}
+
+#endif//_UT_WIRE_H_
@@ -34,12 +34,18 @@ link ../../src/ui/cli.c ./app/cli.c
 unlink ./app/config.c
 link ../../src/cfg/config.c ./app/config.c
 
+unlink ./app/config-bin.c
+link ../../src/cfg/config-bin.c ./app/config-bin.c
+
 unlink ./app/schema.c
 link ../../src/cfg/schema.c ./app/schema.c
 
 unlink ./app/app.c
 link ../../src/app.c ./app/app.c
 
+unlink ./app/wire.c
+link ../../src/ui/wire.c ./app/wire.c
+
 export OBJFORMAT=elf
 export CC=gcc
 date
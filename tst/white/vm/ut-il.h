@@ -1,6 +1,19 @@
 #ifndef _UT_IL_H_ 
 #define _UT_IL_H_
 
+extern const char IlCommands[N_IL_INSN][LABELLEN];
+
+//views over lines as the tests write them, up to the first empty one
+unsigned int view_lines(const char lines[][MAXSTR], struct line_view views[])
+{
+    unsigned int n = 0;
+    for(; n < MAXBUF && lines[n][0] != 0; n++){
+        views[n].at = lines[n];
+        views[n].len = strcspn(lines[n], "\n");
+    }
+    return n;
+}
+
 void ut_char()
 {
     int result = read_char(NULL, -1);
@@ -138,6 +151,20 @@ void ut_operator()
     result = read_operator(line, line + 3);
     CU_ASSERT(result == N_IL_INSN);
     
+    //every operator has a slot of its own
+    int i = IL_POP;
+    for(; i < N_IL_INSN; i++){
+        result = read_operator(IlCommands[i], NULL);
+        CU_ASSERT(result == i);
+    }
+    result = read_operator("", NULL);
+    CU_ASSERT(result == IL_NOP);
+    
+    const char * near[] = {"ld", "LDX", "L", "AD", "ANDN", "XORR", "))", "RE"};
+    for(i = 0; i < sizeof(near) / sizeof(near[0]); i++){
+        result = read_operator(near[i], NULL);
+        CU_ASSERT(result == N_IL_INSN);
+    }
 }
 
 
@@ -568,7 +595,9 @@ Knuth's online variance:
    struct PLC_regs p;
    init_mock_plc(&p);
    
-   result = parse_il_program("knuth.il", lines, &p)->status;
+   struct line_view views[MAXBUF];
+   unsigned int n = view_lines(lines, views);
+   result = parse_il_program("knuth.il", views, n, &p)->status;
    
    CU_ASSERT(result == PLC_OK);
    
@@ -847,7 +876,9 @@ function gcd(a, b)
    struct PLC_regs p;
    init_mock_plc(&p);
    
-   result = parse_il_program("gcd.il", lines, &p)->status;
+   struct line_view views[MAXBUF];
+   unsigned int n = view_lines(lines, views);
+   result = parse_il_program("gcd.il", views, n, &p)->status;
    
    CU_ASSERT(result == PLC_OK);
    
@@ -874,4 +905,54 @@ function gcd(a, b)
 13.ST Q0/8\n"; 
    CU_ASSERT_STRING_EQUAL(dump, expected);
 }
+void ut_parse_long()
+{
+   //wider than a line used to be and longer than a program used to be
+   unsigned int size = 4 * MAXSTR + 8 * MAXBUF;
+   char * src = (char *)calloc(1, size);
+   unsigned int i = 0;
+   char * at = src + sprintf(src, "start:LD %%I0/1 ;");
+   memset(at, 'x', 3 * MAXSTR);
+   at += 3 * MAXSTR;
+   *at++ = '\n';
+   for(; i < MAXBUF + 44; i++){
+       at += sprintf(at, "; %d\n", i);
+   }
+   at += sprintf(at, "\nST %%Q0/1");//no newline at the end
+   
+   line_view_t lines = NULL;
+   unsigned int n = split_lines(src, at - src, &lines);
+   CU_ASSERT(n == MAXBUF + 47);
+   CU_ASSERT(lines[0].len == strlen("start:LD %I0/1 ;") + 3 * MAXSTR);
+   CU_ASSERT(lines[1].len == 3);
+   CU_ASSERT(strncmp(lines[1].at, "; 0", 3) == 0);
+   CU_ASSERT(lines[n - 2].len == 0);
+   CU_ASSERT(lines[n - 1].len == strlen("ST %Q0/1"));
+   
+   struct PLC_regs p;
+   init_mock_plc(&p);
+   int result = parse_il_program("long.il", lines, n, &p)->status;
+   CU_ASSERT(result == PLC_OK);
+   CU_ASSERT(p.rungs[0]->insno == 2);
+   CU_ASSERT_STRING_EQUAL(p.rungs[0]->instructions[0]->label, "start");
+   CU_ASSERT(p.rungs[0]->instructions[1]->operation == IL_ST);
+   
+   free(lines);
+   free(src);
+   
+   struct rung r;
+   memset(&r, 0, sizeof(struct rung));
+   //a jump needs somewhere to go
+   result = parse_il_line("JMP", &r);
+   CU_ASSERT(result == ERR_BADOPERAND);
+   CU_ASSERT(r.insno == 0);
+   //trailing whitespace is not a modifier
+   result = parse_il_line(" a : b:)  \t; pop", &r);
+   CU_ASSERT(result == PLC_OK);
+   CU_ASSERT(r.insno == 1);
+   CU_ASSERT(r.instructions[0]->operation == IL_POP);
+   CU_ASSERT_STRING_EQUAL(r.instructions[0]->label, "a : b");
+   CU_ASSERT_STRING_EQUAL(r.code->next->line, "a : b:)  \t; pop");
+   clear_rung(&r);
+}
 #endif //_UT_IL_H_
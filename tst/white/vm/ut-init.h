@@ -262,5 +262,50 @@ void ut_start_stop()
       
      clear_plc(plc);
 }
+void ut_compile()
+{
+    const char * paths[] = {"ut-a.il", "ut-none.il", "ut-b.ld", "ut-c.il"};
+    char image[MAXSTR];
+    int i = 0;
+    FILE * f = fopen(paths[0], "w");
+    fprintf(f, "LD %%i0/0\nST %%q0/0\n");
+    fclose(f);
+    f = fopen(paths[2], "w");
+    fprintf(f, "i0/1---(Q0/1\n");
+    fclose(f);
+    f = fopen(paths[3], "w");
+    fprintf(f, "here:LD %%i0/2\nJMP?here\nST %%q0/2\n");
+    fclose(f);
+    
+    plc_t plc = new_plc(8,8,4,4,4,4,4,4,100,NULL);
+    plc = plc_load_program_files(paths, 4, plc);
+    //in the order of the files, the missing one leaves no rung
+    CU_ASSERT(plc->rungno == 3);
+    CU_ASSERT_STRING_EQUAL(plc->rungs[0]->id, "ut-a.il");
+    CU_ASSERT_STRING_EQUAL(plc->rungs[1]->id, "ut-b.ld");
+    CU_ASSERT_STRING_EQUAL(plc->rungs[2]->id, "ut-c.il");
+    CU_ASSERT(plc->rungs[0]->insno == 2);
+    CU_ASSERT(plc->rungs[2]->insno == 3);
+    CU_ASSERT(plc->rungs[2]->instructions[1]->operation == IL_JMP);
+    CU_ASSERT(plc->rungs[2]->instructions[1]->operand == 0);
+    CU_ASSERT(plc->status == PLC_OK);
+    
+    //the same as one by one
+    plc_t one = new_plc(8,8,4,4,4,4,4,4,100,NULL);
+    for(i = 0; i < 4; i++){
+        one = plc_load_program_file(paths[i], one);
+    }
+    CU_ASSERT(one->rungno == plc->rungno);
+    for(i = 0; i < one->rungno && i < plc->rungno; i++){
+        CU_ASSERT(one->rungs[i]->insno == plc->rungs[i]->insno);
+    }
+    for(i = 0; i < 4; i++){
+        remove(paths[i]);
+        snprintf(image, MAXSTR, "%s%s", paths[i], PROGRAM_IMAGE);
+        remove(image);
+    }
+    clear_plc(one);
+    clear_plc(plc);
+}
 #endif //_UT_INIT_H_
 
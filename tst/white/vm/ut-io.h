@@ -47,4 +47,64 @@ void ut_write(){
     CU_ASSERT(Mock_flush_count == 0);
 }
 
+void ut_sync(){
+    extern int Mock_flush_count;
+    extern int stub_sync_fails();
+    struct PLC_regs p;
+    memset(&p,0,sizeof(struct PLC_regs));
+    init_mock_plc(&p);
+    p.status = ST_RUNNING;
+    Mock_flush_count = 0;
+    //lock-step hardware that has not handed over the cycle skips it
+    Hw_stub.sync = stub_sync_fails;
+    plc_func(&p);
+    Hw_stub.sync = NULL;
+    CU_ASSERT(Mock_flush_count == 0);
+    CU_ASSERT(p.status == ST_RUNNING);
+}
+
+void ut_virtual_clock(){
+    extern unsigned char Mock_virtual;
+    extern struct timeval Mock_clock;
+    struct PLC_regs p;
+    struct timeval start;
+    struct timeval now;
+    struct timeval wall;
+    int i = 0;
+    memset(&p,0,sizeof(struct PLC_regs));
+    init_mock_plc(&p);
+    p.old = (plc_t)malloc(sizeof(struct PLC_regs));
+    init_mock_plc(p.old);
+    p.status = ST_RUNNING;
+    p.step = 500; //msecs, a timed loop would take seconds
+    //wall clock cycles wait for the timer
+    CU_ASSERT(plc_free_run(&p) == FALSE);
+    
+    Mock_virtual = TRUE;
+    Mock_clock.tv_sec = 1000;
+    Mock_clock.tv_usec = 999999;
+    gettimeofday(&start, NULL);
+    for(; i < 4; i++){
+        struct timeval before;
+        get_clock(&before);
+        CU_ASSERT(plc_free_run(&p) == TRUE);
+        plc_func(&p);
+        get_clock(&now);
+        //exactly one step per cycle, carried into seconds
+        CU_ASSERT((now.tv_sec - before.tv_sec) * 1000000 
+                + now.tv_usec - before.tv_usec == p.step * 1000);
+    }
+    CU_ASSERT(now.tv_sec == 1002 && now.tv_usec == 999999);
+    //and no cycle waited: 2 virtual seconds went by in a fraction of one
+    gettimeofday(&wall, NULL);
+    CU_ASSERT((wall.tv_sec - start.tv_sec) * 1000000 
+            + wall.tv_usec - start.tv_usec < p.step * 1000);
+    CU_ASSERT(p.status == ST_RUNNING);
+    //a stopped plc waits for commands even in virtual time
+    p.status = ST_STOPPED;
+    CU_ASSERT(plc_free_run(&p) == FALSE);
+    CU_ASSERT(plc_free_run(NULL) == FALSE);
+    Mock_virtual = FALSE;
+}
+
 #endif //_UT_IO_
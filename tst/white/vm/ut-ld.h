@@ -180,7 +180,9 @@ void ut_find_next_node()
     sprintf(lines[1], "%s\n", " i0/2--+");
     sprintf(lines[2], "%s\n", " i0/3--+--(Q0/1");
     
-    ld_line_t * program = construct_program(lines, 3);
+    struct line_view views[MAXBUF];
+    view_lines(lines, views);
+    ld_line_t * program = construct_program(views, 3);
     int result = horizontal_parse(3, program);
     CU_ASSERT(result == PLC_OK);
     result = find_next_node(program, 0, 3);
@@ -193,7 +195,8 @@ void ut_find_next_node()
     sprintf(lines[1], "%s\n", " i0/2--");
     sprintf(lines[2], "%s\n", " i0/3----(Q0/1");
     
-    program = construct_program(lines, 3);
+    view_lines(lines, views);
+    program = construct_program(views, 3);
     result = horizontal_parse(3, program);
     CU_ASSERT(result == PLC_OK);
     result = find_next_node(program, 0, 3);
@@ -211,7 +214,8 @@ void ut_find_next_node()
     sprintf(lines[4], "%s\n", " i0/4--+ ");
     sprintf(lines[5], "%s\n", " i0/5--+--(Q0/1           ");
     
-    program = construct_program(lines, 6);
+    view_lines(lines, views);
+    program = construct_program(views, 6);
     result = horizontal_parse(6, program);
     CU_ASSERT(result == PLC_OK);
     result = find_next_node(program, 0, 3);
@@ -229,7 +233,8 @@ void ut_parse_ld_program()
     
     char lines[MAXBUF][MAXSTR];
     memset(lines, 0, MAXBUF * MAXSTR); 
-    plc_t r = parse_ld_program("", lines, NULL);
+    struct line_view views[MAXBUF];
+    plc_t r = parse_ld_program("", views, 0, NULL);
     
     CU_ASSERT_PTR_NULL(r);
     
@@ -240,7 +245,8 @@ void ut_parse_ld_program()
     sprintf(lines[1], "%s\n", "       |     ");
     sprintf(lines[2], "%s\n", " i0/3--+       ");
     
-    ld_line_t * program = construct_program(lines, 3);
+    unsigned int n = view_lines(lines, views);
+    ld_line_t * program = construct_program(views, n);
     
     result = horizontal_parse(3, program);
     CU_ASSERT(program[0]->cursor == 7);
@@ -263,7 +269,7 @@ void ut_parse_ld_program()
     
     destroy_program(3, program);
 
-    r = parse_ld_program("1or3.ld", lines, &p);
+    r = parse_ld_program("1or3.ld", views, n, &p);
     CU_ASSERT(p.status == PLC_OK);
     CU_ASSERT_STRING_EQUAL(p.rungs[0]->id, "1or3.ld");
     char code[3*MAXBUF];
@@ -289,7 +295,8 @@ void ut_parse_ld_program()
     sprintf(lines[3], "%s\n", "  ");
     sprintf(lines[4], "%s\n", " i0/4--+   ");
     sprintf(lines[5], "%s\n", " i0/5--+-(Q0/1            ");
-    result = parse_ld_program("many_ors.ld", lines, &p)->status;
+    n = view_lines(lines, views);
+    result = parse_ld_program("many_ors.ld", views, n, &p)->status;
     
     CU_ASSERT(result == PLC_OK);
     
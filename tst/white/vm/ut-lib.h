@@ -2713,6 +2713,66 @@ void ut_codeline(){
     
 }
 
+void ut_rung_image(){
+
+    struct rung r;
+    memset(&r, 0, sizeof(struct rung));
+    struct instruction ins;
+    memset(&ins, 0, sizeof(struct instruction));
+    ins.operation = IL_LD;
+    ins.operand = OP_INPUT;
+    ins.modifier = IL_NEG;
+    ins.byte = 1;
+    ins.bit = 2;
+    strcpy(ins.label, "here");
+    append(&ins, &r);
+    memset(&ins, 0, sizeof(struct instruction));
+    ins.operation = IL_JMP;
+    ins.modifier = IL_COND;
+    strcpy(ins.lookup, "here");
+    append(&ins, &r);
+    intern(&r);
+    r.code = append_line("here:LD! %IX1/2", r.code);
+    r.code = append_line("JMP? here", r.code);
+    
+    unsigned int len = pack_rung(&r, NULL);
+    char * buf = (char *)malloc(len);
+    CU_ASSERT(pack_rung(&r, buf) == len);
+    
+    struct rung u;
+    memset(&u, 0, sizeof(struct rung));
+    int result = unpack_rung(buf, len, &u);
+    CU_ASSERT(result == PLC_OK);
+    CU_ASSERT(u.insno == 2);
+    CU_ASSERT(memcmp(u.instructions[0], r.instructions[0], 
+                     sizeof(struct instruction)) == 0);
+    CU_ASSERT(memcmp(u.instructions[1], r.instructions[1], 
+                     sizeof(struct instruction)) == 0);
+    CU_ASSERT(u.instructions[1]->operand == 0);
+    CU_ASSERT_STRING_EQUAL(u.code->line, "here:LD! %IX1/2");
+    CU_ASSERT_STRING_EQUAL(u.code->next->line, "JMP? here");
+    CU_ASSERT_PTR_NULL(u.code->next->next);
+    
+    //a truncated image leaves the rung empty
+    struct rung t;
+    memset(&t, 0, sizeof(struct rung));
+    result = unpack_rung(buf, len - 1, &t);
+    CU_ASSERT(result == PLC_ERR);
+    CU_ASSERT(t.insno == 0);
+    CU_ASSERT_PTR_NULL(t.instructions);
+    CU_ASSERT_PTR_NULL(t.code);
+    
+    //so does one that jumps nowhere
+    buf[len - 2] = 'X';
+    result = unpack_rung(buf, len, &t);
+    CU_ASSERT(result == PLC_ERR);
+    CU_ASSERT(t.insno == 0);
+    
+    free(buf);
+    clear_rung(&u);
+    clear_rung(&r);
+}
+
 void ut_stack(){
 
     struct rung r;
@@ -2907,6 +2967,17 @@ void ut_force(){
     
     CU_ASSERT(is_forced(r, OP_OUTPUT, 1)==0);
     CU_ASSERT(r->aq[1].mask <= r->aq[1].min);
+//digital operands index bits, a later force replaces an earlier one
+    CU_ASSERT_PTR_NULL(force_value(&plc, OP_INPUT, 8 * BYTESIZE, 1));
+    r = force_value(&plc, OP_INPUT, 8 * BYTESIZE - 1, 0);
+    CU_ASSERT_PTR_NOT_NULL(r);
+    CU_ASSERT(r->di[63].N_MASK == 1);
+    r = force_value(&plc, OP_INPUT, 63, 1);
+    CU_ASSERT(r->di[63].MASK == 1);
+    CU_ASSERT(r->di[63].N_MASK == 0);
+    CU_ASSERT(is_forced(r, OP_INPUT, 63) == 1);
+    r = unforce(&plc, OP_INPUT, 63);
+    CU_ASSERT(is_forced(r, OP_INPUT, 63) == 0);
 }
 
 #endif //_UT_LIB_H_
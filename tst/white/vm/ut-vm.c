@@ -119,6 +119,7 @@ int main ()
   || ADD_TEST(suite_lib, ut_jmp) 
   || ADD_TEST(suite_lib, ut_rung)
   || ADD_TEST(suite_lib, ut_codeline) 
+  || ADD_TEST(suite_lib, ut_rung_image)
   || ADD_TEST(suite_lib, ut_set_reset) 
   || ADD_TEST(suite_lib, ut_st) 
   || ADD_TEST(suite_lib, ut_st_discrete) 
@@ -144,6 +145,8 @@ int main ()
 //I/O
   if(ADD_TEST(suite_io, ut_read)
   || ADD_TEST(suite_io, ut_write) 
+  || ADD_TEST(suite_io, ut_sync) 
+  || ADD_TEST(suite_io, ut_virtual_clock)
     )
   {
 	CU_cleanup_registry ();
@@ -161,6 +164,7 @@ int main ()
   || ADD_TEST(suite_il, ut_arguments)
   || ADD_TEST(suite_il, ut_parse)
   || ADD_TEST(suite_il, ut_parse_real)
+  || ADD_TEST(suite_il, ut_parse_long)
      )
   {
 	CU_cleanup_registry ();
@@ -201,6 +205,7 @@ int main ()
  if(ADD_TEST(suite_init, ut_config) 
  || ADD_TEST(suite_init, ut_construct)
  || ADD_TEST(suite_init, ut_start_stop)
+ || ADD_TEST(suite_init, ut_compile)
      )
   {
 	CU_cleanup_registry ();
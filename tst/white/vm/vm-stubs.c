@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <sys/time.h>
 
 #include "config.h"
 #include "hardware.h"
@@ -10,10 +11,9 @@
 #include "rung.h"
 #include "plclib.h"
 
-char * strdup_r(char * dest, const char * src) {
-    char * r =  strdup(src);
-    dest = r;
-    return r;
+const char * intern_str(const char * str) {
+    
+    return strdup(str);
 }
 
 void plc_log(const char * msg, ...)
@@ -38,6 +38,33 @@ int project_init()
 }
 
 void compute_variance( double x){}
+
+//virtual clock, like util.c's
+unsigned char Mock_virtual = FALSE;
+struct timeval Mock_clock;
+
+void get_clock(struct timeval * tv)
+{
+    if(Mock_virtual){
+        *tv = Mock_clock;
+    } else {
+        gettimeofday(tv, NULL);
+    }
+}
+
+void tick_clock(long usec)
+{
+    if(Mock_virtual){
+        Mock_clock.tv_usec += usec;
+        Mock_clock.tv_sec += Mock_clock.tv_usec / 1000000;
+        Mock_clock.tv_usec %= 1000000;
+    }
+}
+
+unsigned char is_virtual_clock()
+{
+    return Mock_virtual;
+}
 /********************stubbed hardware****************/
 
 unsigned char Mock_din = 0;
@@ -93,6 +120,11 @@ int stub_flush()
     return PLC_OK;
 }
 
+int stub_sync_fails()
+{
+    return PLC_ERR;
+}
+
 void stub_dio_read(unsigned int n, BYTE* bit)
 {	
     *bit = Mock_din;